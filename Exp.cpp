@@ -6,13 +6,17 @@
 #include <string>
 #include <boost/algorithm/string.hpp>
 #include "utils/FileReader.h"
-// #include "indices/ZM.h"
+#include "indices/ZM.h"
+#include "indices/RTree.h"
 #include "indices/RSMI.h"
+#include "indices/RSMIND.h"
 #include "utils/ExpRecorder.h"
 #include "utils/Constants.h"
 #include "utils/FileWriter.h"
 #include "utils/util.h"
+#ifdef use_torch
 #include <torch/torch.h>
+#endif
 
 #include <xmmintrin.h>
 #include <stdlib.h>
@@ -43,6 +47,9 @@ long long inserted_num = cardinality / 10;
 string distribution = Constants::DEFAULT_DISTRIBUTION;
 int inserted_partition = 5;
 int skewness = 1;
+int dimension = 2;
+// build RSMI with RSMI::tune's choice of page size, threshold and max width
+bool is_tuned = false;
 
 double knn_diff(vector<Point> acc, vector<Point> pred)
 {
@@ -65,14 +72,27 @@ void exp_RSMI(FileWriter file_writer, ExpRecorder exp_recorder, vector<Point> po
     exp_recorder.clean();
     exp_recorder.structure_name = "RSMI";
     RSMI::model_path_root = model_path;
-    RSMI *partition = new RSMI(0,  Constants::MAX_WIDTH);
+    RSMI *partition = new RSMI(0, exp_recorder.config);
     auto start = chrono::high_resolution_clock::now();
-    partition->model_path = model_path;
     partition->build(exp_recorder, points);
     auto finish = chrono::high_resolution_clock::now();
     exp_recorder.time = chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
     cout << "build time: " << exp_recorder.time << endl;
-    exp_recorder.size = (2 * Constants::HIDDEN_LAYER_WIDTH + Constants::HIDDEN_LAYER_WIDTH * 1 + Constants::HIDDEN_LAYER_WIDTH * 1 + 1) * Constants::EACH_DIM_LENGTH * exp_recorder.non_leaf_node_num + (Constants::DIM * Constants::PAGESIZE + Constants::PAGESIZE + Constants::DIM * Constants::DIM) * Constants::EACH_DIM_LENGTH * exp_recorder.leaf_node_num;
+    cout << "trained " << exp_recorder.trained_leaf_model_num << " last-level models with " << thread_utils::default_thread_num() << " threads: " << exp_recorder.get_models_per_second() << " models/second" << endl;
+    partition->print_index_info(exp_recorder);
+    file_utils::check_dir(Constants::RECORDS + Constants::STATS);
+    partition->dump_stats(Constants::RECORDS + Constants::STATS + "RSMI_" + exp_recorder.distribution + "_" + to_string(exp_recorder.dataset_cardinality) + "_" + to_string(exp_recorder.skewness) + ".json", "json");
+    exp_recorder.memory_usage = partition->get_memory_usage();
+    exp_recorder.size = exp_recorder.memory_usage.total();
+    cout << exp_recorder.memory_usage.get_self();
+    if (partition->get_page_source() != NULL)
+    {
+        cout << partition->get_page_source()->get_self();
+    }
+    if (partition->get_buffer_pool() != NULL)
+    {
+        cout << partition->get_buffer_pool()->get_self();
+    }
     file_writer.write_build(exp_recorder);
     exp_recorder.clean();
     partition->point_query(exp_recorder, points);
@@ -110,14 +130,206 @@ void exp_RSMI(FileWriter file_writer, ExpRecorder exp_recorder, vector<Point> po
 
     partition->insert(exp_recorder, insert_points);
     cout << "exp_recorder.insert_time: " << exp_recorder.insert_time << endl;
+    file_writer.write_insert(exp_recorder);
+    exp_recorder.clean();
+    partition->point_query(exp_recorder, points);
+    cout << "finish point_query: pageaccess:" << exp_recorder.page_access << endl;
+    cout << "finish point_query time: " << exp_recorder.time << endl;
+    file_writer.write_insert_point_query(exp_recorder);
+    exp_recorder.clean();
+
+    exp_recorder.delete_num = 0;
+    exp_recorder.delete_time = 0;
+    partition->remove(exp_recorder, insert_points);
+    cout << "exp_recorder.delete_time: " << exp_recorder.delete_time << endl;
+    file_writer.write_delete(exp_recorder);
     exp_recorder.clean();
     partition->point_query(exp_recorder, points);
     cout << "finish point_query: pageaccess:" << exp_recorder.page_access << endl;
     cout << "finish point_query time: " << exp_recorder.time << endl;
+    file_writer.write_delete_point_query(exp_recorder);
     exp_recorder.clean();
 }
 
+void exp_ZM(FileWriter file_writer, ExpRecorder exp_recorder, vector<Point> points, map<string, vector<Mbr>> mbrs_map, vector<Point> query_poitns, string model_path)
+{
+    exp_recorder.clean();
+    exp_recorder.structure_name = "ZM";
+    ZM::model_path_root = model_path;
+    ZM *zm = new ZM();
+    auto start = chrono::high_resolution_clock::now();
+    zm->build(exp_recorder, points);
+    auto finish = chrono::high_resolution_clock::now();
+    exp_recorder.time = chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
+    cout << "build time: " << exp_recorder.time << endl;
+    zm->print_index_info(exp_recorder);
+    exp_recorder.size = (exp_recorder.config.hidden_layer_width + exp_recorder.config.hidden_layer_width * 1 + exp_recorder.config.hidden_layer_width * 1 + 1) * Constants::EACH_DIM_LENGTH * exp_recorder.non_leaf_node_num + (Constants::DIM * exp_recorder.config.page_size + exp_recorder.config.page_size + Constants::DIM * Constants::DIM) * Constants::EACH_DIM_LENGTH * exp_recorder.leaf_node_num;
+    file_writer.write_build(exp_recorder);
+    exp_recorder.clean();
+    zm->point_query(exp_recorder, points);
+    cout << "finish point_query: pageaccess:" << exp_recorder.page_access << endl;
+    cout << "finish point_query time: " << exp_recorder.time << endl;
+    file_writer.write_point_query(exp_recorder);
+    exp_recorder.clean();
+
+    exp_recorder.window_size = areas[2];
+    exp_recorder.window_ratio = ratios[2];
+    zm->acc_window_query(exp_recorder, mbrs_map[to_string(areas[2]) + to_string(ratios[2])]);
+    cout << "ZM::acc_window_query time: " << exp_recorder.time << endl;
+    cout << "ZM::acc_window_query page_access: " << exp_recorder.page_access << endl;
+    file_writer.write_acc_window_query(exp_recorder);
+    zm->window_query(exp_recorder, mbrs_map[to_string(areas[2]) + to_string(ratios[2])]);
+    exp_recorder.accuracy = ((double)exp_recorder.window_query_result_size) / exp_recorder.acc_window_query_qesult_size;
+    cout << "window_query time: " << exp_recorder.time << endl;
+    cout << "window_query page_access: " << exp_recorder.page_access << endl;
+    cout << "exp_recorder.accuracy: " << exp_recorder.accuracy << endl;
+    file_writer.write_window_query(exp_recorder);
+
+    exp_recorder.clean();
+    exp_recorder.k_num = ks[2];
+    zm->acc_kNN_query(exp_recorder, query_poitns, ks[2]);
+    cout << "exp_recorder.time: " << exp_recorder.time << endl;
+    cout << "exp_recorder.page_access: " << exp_recorder.page_access << endl;
+    file_writer.write_acc_kNN_query(exp_recorder);
+    zm->kNN_query(exp_recorder, query_poitns, ks[2]);
+    cout << "exp_recorder.time: " << exp_recorder.time << endl;
+    cout << "exp_recorder.page_access: " << exp_recorder.page_access << endl;
+    exp_recorder.accuracy = knn_diff(exp_recorder.acc_knn_query_results, exp_recorder.knn_query_results);
+    cout << "exp_recorder.accuracy: " << exp_recorder.accuracy << endl;
+    file_writer.write_kNN_query(exp_recorder);
+    exp_recorder.clean();
+}
+
+void exp_RTree(FileWriter file_writer, ExpRecorder exp_recorder, vector<Point> points, map<string, vector<Mbr>> mbrs_map, vector<Point> query_poitns, vector<Point> insert_points)
+{
+    exp_recorder.clean();
+    exp_recorder.structure_name = "RTree";
+    RTree *rtree = new RTree();
+    auto start = chrono::high_resolution_clock::now();
+    rtree->build(exp_recorder, points);
+    auto finish = chrono::high_resolution_clock::now();
+    exp_recorder.time = chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
+    cout << "build time: " << exp_recorder.time << endl;
+    rtree->print_index_info(exp_recorder);
+    exp_recorder.memory_usage = rtree->get_memory_usage();
+    exp_recorder.size = exp_recorder.memory_usage.total();
+    cout << exp_recorder.memory_usage.get_self();
+    file_writer.write_build(exp_recorder);
+    exp_recorder.clean();
+    rtree->point_query(exp_recorder, points);
+    cout << "finish point_query: pageaccess:" << exp_recorder.page_access << endl;
+    cout << "finish point_query time: " << exp_recorder.time << endl;
+    file_writer.write_point_query(exp_recorder);
+    exp_recorder.clean();
+
+    exp_recorder.window_size = areas[2];
+    exp_recorder.window_ratio = ratios[2];
+    rtree->window_query(exp_recorder, mbrs_map[to_string(areas[2]) + to_string(ratios[2])]);
+    exp_recorder.accuracy = 1;
+    cout << "window_query time: " << exp_recorder.time << endl;
+    cout << "window_query page_access: " << exp_recorder.page_access << endl;
+    file_writer.write_window_query(exp_recorder);
+
+    exp_recorder.clean();
+    exp_recorder.k_num = ks[2];
+    rtree->kNN_query(exp_recorder, query_poitns, ks[2]);
+    exp_recorder.accuracy = 1;
+    cout << "exp_recorder.time: " << exp_recorder.time << endl;
+    cout << "exp_recorder.page_access: " << exp_recorder.page_access << endl;
+    file_writer.write_kNN_query(exp_recorder);
+    exp_recorder.clean();
+
+    rtree->insert(exp_recorder, insert_points);
+    cout << "exp_recorder.insert_time: " << exp_recorder.insert_time << endl;
+    file_writer.write_insert(exp_recorder);
+    exp_recorder.clean();
+    rtree->point_query(exp_recorder, points);
+    cout << "finish point_query: pageaccess:" << exp_recorder.page_access << endl;
+    cout << "finish point_query time: " << exp_recorder.time << endl;
+    file_writer.write_insert_point_query(exp_recorder);
+    exp_recorder.clean();
+}
+
+template <int D>
+double knn_diff(const vector<PointND<D>> &acc, const vector<PointND<D>> &pred)
+{
+    int num = 0;
+    for (const PointND<D> &point : pred)
+    {
+        num += find(acc.begin(), acc.end(), point) != acc.end();
+    }
+    return num * 1.0 / pred.size();
+}
+
+template <int D>
+void exp_RSMIND(FileWriter file_writer, ExpRecorder exp_recorder, vector<PointND<D>> points, string model_path)
+{
+    exp_recorder.clean();
+    exp_recorder.structure_name = "RSMI" + to_string(D) + "D";
+    RSMIND<D>::model_path_root = model_path;
+    RSMIND<D> *partition = new RSMIND<D>(0, 0, RSMIND<D>::default_fanout());
+    auto start = chrono::high_resolution_clock::now();
+    partition->build(exp_recorder, points);
+    auto finish = chrono::high_resolution_clock::now();
+    exp_recorder.time = chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
+    cout << "build time: " << exp_recorder.time << endl;
+    partition->print_index_info(exp_recorder);
+    exp_recorder.size = (D * exp_recorder.config.hidden_layer_width + exp_recorder.config.hidden_layer_width * 1 + exp_recorder.config.hidden_layer_width * 1 + 1) * Constants::EACH_DIM_LENGTH * exp_recorder.non_leaf_node_num + (D * exp_recorder.config.page_size + exp_recorder.config.page_size + D * D) * Constants::EACH_DIM_LENGTH * exp_recorder.leaf_node_num;
+    file_writer.write_build(exp_recorder);
+    exp_recorder.clean();
+    partition->point_query(exp_recorder, points);
+    cout << "finish point_query: pageaccess:" << exp_recorder.page_access << endl;
+    cout << "finish point_query time: " << exp_recorder.time << endl;
+    file_writer.write_point_query(exp_recorder);
+    exp_recorder.clean();
+
+    exp_recorder.window_size = areas[2];
+    exp_recorder.window_ratio = ratios[2];
+    vector<MbrND<D>> windows = MbrND<D>::get_mbrs(points, areas[2], query_window_num);
+    partition->acc_window_query(exp_recorder, windows);
+    cout << "RSMIND::acc_window_query time: " << exp_recorder.time << endl;
+    cout << "RSMIND::acc_window_query page_access: " << exp_recorder.page_access << endl;
+    file_writer.write_acc_window_query(exp_recorder);
+    partition->window_query(exp_recorder, windows);
+    exp_recorder.accuracy = ((double)exp_recorder.window_query_result_size) / exp_recorder.acc_window_query_qesult_size;
+    cout << "window_query time: " << exp_recorder.time << endl;
+    cout << "window_query page_access: " << exp_recorder.page_access << endl;
+    cout << "exp_recorder.accuracy: " << exp_recorder.accuracy << endl;
+    file_writer.write_window_query(exp_recorder);
+
+    exp_recorder.clean();
+    exp_recorder.k_num = ks[2];
+    vector<PointND<D>> query_points = PointND<D>::get_points(points, query_k_num);
+    vector<PointND<D>> acc_knn_results = partition->acc_kNN_query(exp_recorder, query_points, ks[2]);
+    cout << "exp_recorder.time: " << exp_recorder.time << endl;
+    cout << "exp_recorder.page_access: " << exp_recorder.page_access << endl;
+    file_writer.write_acc_kNN_query(exp_recorder);
+    exp_recorder.time = 0;
+    exp_recorder.page_access = 0;
+    vector<PointND<D>> knn_results = partition->kNN_query(exp_recorder, query_points, ks[2]);
+    cout << "exp_recorder.time: " << exp_recorder.time << endl;
+    cout << "exp_recorder.page_access: " << exp_recorder.page_access << endl;
+    exp_recorder.accuracy = knn_diff(acc_knn_results, knn_results);
+    cout << "exp_recorder.accuracy: " << exp_recorder.accuracy << endl;
+    file_writer.write_kNN_query(exp_recorder);
+    exp_recorder.clean();
+}
+
+// d-dimensional datasets (-m 3 or -m 4): the first dimension columns of every line
+template <int D>
+void exp_RSMIND(FileWriter file_writer, ExpRecorder exp_recorder, string dataset_filename, string model_path)
+{
+    FileReader filereader;
+    vector<PointND<D>> points;
+    for (vector<float> &coordinate : filereader.get_coordinates(dataset_filename, ",", D))
+    {
+        points.push_back(PointND<D>(coordinate.data()));
+    }
+    exp_RSMIND<D>(file_writer, exp_recorder, points, model_path);
+}
+
 string RSMI::model_path_root = "";
+string ZM::model_path_root = "";
 int main(int argc, char **argv)
 {
     int c;
@@ -125,13 +337,27 @@ int main(int argc, char **argv)
     {
         {"cardinality", required_argument,NULL,'c'},
         {"distribution",required_argument,      NULL,'d'},
-        {"skewness", required_argument,      NULL,'s'}
+        {"skewness", required_argument,      NULL,'s'},
+        {"dimension", required_argument,      NULL,'m'},
+        {"page_size", required_argument,      NULL,'p'},
+        {"threshold", required_argument,      NULL,'t'},
+        {"max_width", required_argument,      NULL,'w'},
+        {"tune", no_argument,      NULL,'a'},
+        {"fixed", no_argument,      NULL,'f'},
+        {"huge_pages", required_argument,      NULL,'g'},
+        {"compressed", no_argument,      NULL,'z'},
+        {"page_file", required_argument,      NULL,'F'},
+        {"buffer_pool_pages", required_argument,      NULL,'b'},
+        {"buffer_pool_policy", required_argument,      NULL,'r'},
+        {"read_mode", required_argument,      NULL,'i'},
+        {0, 0, 0, 0}
     };
+    RSMIConfig config;
 
     while(1)
     {
         int opt_index = 0;
-        c = getopt_long(argc, argv,"c:d:s:", long_options,&opt_index);
+        c = getopt_long(argc, argv,"c:d:s:m:p:t:w:afg:zF:b:r:i:", long_options,&opt_index);
         
         if(-1 == c)
         {
@@ -148,15 +374,88 @@ int main(int argc, char **argv)
             case 's':
                 skewness = atoi(optarg);
                 break;
+            case 'm':
+                dimension = atoi(optarg);
+                break;
+            case 'p':
+                config.page_size = atoi(optarg);
+                break;
+            case 't':
+                config.threshold = atoi(optarg);
+                break;
+            case 'w':
+                config.max_width = atoi(optarg);
+                break;
+            case 'a':
+                is_tuned = true;
+                break;
+            case 'f':
+                config.adaptive = false;
+                break;
+            case 'g':
+                config.huge_pages = huge_pages::parse_mode(optarg);
+                if (config.huge_pages < 0)
+                {
+                    cerr << "unknown huge page mode " << optarg << ", use off, transparent or explicit" << endl;
+                    return 1;
+                }
+                break;
+            case 'z':
+                config.compressed_pages = true;
+                break;
+            case 'F':
+                config.page_file = optarg;
+                break;
+            case 'b':
+                config.buffer_pool_pages = atoll(optarg);
+                break;
+            case 'r':
+                config.buffer_pool_policy = buffer_pool::parse_policy(optarg);
+                if (config.buffer_pool_policy < 0)
+                {
+                    cerr << "unknown buffer pool policy " << optarg << ", use lru or clock" << endl;
+                    return 1;
+                }
+                break;
+            case 'i':
+                config.read_mode = buffer_pool::parse_read_mode(optarg);
+                if (config.read_mode < 0)
+                {
+                    cerr << "unknown read mode " << optarg << ", use sync, uring or pread" << endl;
+                    return 1;
+                }
+                break;
         }
     }
+    if (!config.validate())
+    {
+        return 1;
+    }
 
     ExpRecorder exp_recorder;
     exp_recorder.dataset_cardinality = cardinality;
     exp_recorder.distribution = distribution;
     exp_recorder.skewness = skewness;
+    exp_recorder.config = config;
     inserted_num = cardinality / 2;
 
+    if (dimension == 3 || dimension == 4)
+    {
+        string dataset_filename = Constants::DATASETS + exp_recorder.distribution + "_" + to_string(exp_recorder.dataset_cardinality) + "_" + to_string(exp_recorder.skewness) + "_" + to_string(dimension) + "_.csv";
+        string model_root_path = Constants::TORCH_MODELS + distribution + "_" + to_string(cardinality) + "_" + to_string(dimension);
+        file_utils::check_dir(model_root_path);
+        FileWriter file_writer(Constants::RECORDS);
+        if (dimension == 3)
+        {
+            exp_RSMIND<3>(file_writer, exp_recorder, dataset_filename, model_root_path + "/");
+        }
+        else
+        {
+            exp_RSMIND<4>(file_writer, exp_recorder, dataset_filename, model_root_path + "/");
+        }
+        return 0;
+    }
+
     // TODO change filename
     string dataset_filename = Constants::DATASETS + exp_recorder.distribution + "_" + to_string(exp_recorder.dataset_cardinality) + "_" + to_string(exp_recorder.skewness) + "_2_.csv";
     FileReader filereader(dataset_filename, ",");
@@ -203,7 +502,14 @@ int main(int argc, char **argv)
     file_utils::check_dir(model_root_path);
     string model_path = model_root_path + "/";
     FileWriter file_writer(Constants::RECORDS);
+    if (is_tuned)
+    {
+        RSMI::model_path_root = model_path;
+        exp_recorder.config = RSMI::tune(points, query_poitns, mbrs_map[to_string(areas[2]) + to_string(ratios[2])], exp_recorder.config, RSMITuneOptions());
+    }
     exp_RSMI(file_writer, exp_recorder, points, mbrs_map, query_poitns, insert_points, model_path);
+    exp_ZM(file_writer, exp_recorder, points, mbrs_map, query_poitns, model_path);
+    exp_RTree(file_writer, exp_recorder, points, mbrs_map, query_poitns, insert_points);
 }
 
 #endif  // use_gpu
\ No newline at end of file
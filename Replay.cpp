@@ -0,0 +1,257 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <queue>
+#include <getopt.h>
+#include "utils/FileReader.h"
+#include "indices/RSMI.h"
+#include "utils/ExpRecorder.h"
+#include "utils/Constants.h"
+#include "utils/Histogram.h"
+#include "utils/QueryLog.h"
+#include "utils/util.h"
+
+using namespace std;
+using namespace query_log;
+
+// Replays a query log (utils/QueryLog.h, written through RSMI::query_log) against an RSMI built
+// from a dataset, open-loop: query i is due at its logged time divided by the speed-up -x, and
+// -t workers take the queries in time order. Queueing delay is the time a due query waits for
+// a worker, service time the query itself, latency their sum; percentiles of each per query
+// type are printed and written under RECORDS/replay/. The index is built with the RSMIConfig
+// given by the long options, named as in Exp, so a replay can rebuild a tuned index.
+// usage: Replay -l <log> -f <dataset csv> | -c <cardinality> -d <distribution> -s <skewness>
+//               -x <speed-up> -t <threads> [--page_size <n>] [--threshold <n>]
+//               [--max_width <n>] [--fixed] [--huge_pages <mode>] [--compressed]
+//               [--page_file <file>] [--buffer_pool_pages <n>] [--buffer_pool_policy <policy>]
+//               [--read_mode <mode>]
+
+struct ReplayStats
+{
+    Histogram latencies[QUERY_TYPE_NUM];
+    Histogram queueing_delays[QUERY_TYPE_NUM];
+    Histogram service_times[QUERY_TYPE_NUM];
+};
+
+const int SPIN_US = 200;
+
+string RSMI::model_path_root = "";
+int main(int argc, char **argv)
+{
+    string log_file;
+    string dataset;
+    long long cardinality = 10000;
+    string distribution = Constants::DEFAULT_DISTRIBUTION;
+    int skewness = 1;
+    double speed_up = 1;
+    int thread_num = 1;
+    RSMIConfig config;
+    // long-only options set the RSMIConfig
+    enum
+    {
+        PAGE_SIZE = 256,
+        THRESHOLD,
+        MAX_WIDTH,
+        FIXED,
+        HUGE_PAGES,
+        COMPRESSED,
+        PAGE_FILE,
+        BUFFER_POOL_PAGES,
+        BUFFER_POOL_POLICY,
+        READ_MODE
+    };
+    static struct option long_options[] =
+    {
+        {"page_size", required_argument, NULL, PAGE_SIZE},
+        {"threshold", required_argument, NULL, THRESHOLD},
+        {"max_width", required_argument, NULL, MAX_WIDTH},
+        {"fixed", no_argument, NULL, FIXED},
+        {"huge_pages", required_argument, NULL, HUGE_PAGES},
+        {"compressed", no_argument, NULL, COMPRESSED},
+        {"page_file", required_argument, NULL, PAGE_FILE},
+        {"buffer_pool_pages", required_argument, NULL, BUFFER_POOL_PAGES},
+        {"buffer_pool_policy", required_argument, NULL, BUFFER_POOL_POLICY},
+        {"read_mode", required_argument, NULL, READ_MODE},
+        {0, 0, 0, 0}
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "l:f:c:d:s:x:t:", long_options, NULL)) != -1)
+    {
+        switch (c)
+        {
+        case 'l':
+            log_file = optarg;
+            break;
+        case 'f':
+            dataset = optarg;
+            break;
+        case 'c':
+            cardinality = atoll(optarg);
+            break;
+        case 'd':
+            distribution = optarg;
+            break;
+        case 's':
+            skewness = atoi(optarg);
+            break;
+        case 'x':
+            speed_up = atof(optarg);
+            break;
+        case 't':
+            thread_num = atoi(optarg);
+            break;
+        case PAGE_SIZE:
+            config.page_size = atoi(optarg);
+            break;
+        case THRESHOLD:
+            config.threshold = atoi(optarg);
+            break;
+        case MAX_WIDTH:
+            config.max_width = atoi(optarg);
+            break;
+        case FIXED:
+            config.adaptive = false;
+            break;
+        case HUGE_PAGES:
+            config.huge_pages = huge_pages::parse_mode(optarg);
+            break;
+        case COMPRESSED:
+            config.compressed_pages = true;
+            break;
+        case PAGE_FILE:
+            config.page_file = optarg;
+            break;
+        case BUFFER_POOL_PAGES:
+            config.buffer_pool_pages = atoll(optarg);
+            break;
+        case BUFFER_POOL_POLICY:
+            config.buffer_pool_policy = buffer_pool::parse_policy(optarg);
+            break;
+        case READ_MODE:
+            config.read_mode = buffer_pool::parse_read_mode(optarg);
+            break;
+        }
+    }
+    if (log_file.empty() || speed_up <= 0 || thread_num < 1)
+    {
+        cerr << "usage: Replay -l <log> [-f <dataset csv> | -c <cardinality> -d <distribution> -s <skewness>] [-x <speed-up>] [-t <threads>] [RSMIConfig options, as in Exp]" << endl;
+        return 1;
+    }
+    if (!config.validate())
+    {
+        return 1;
+    }
+    if (dataset.empty())
+    {
+        dataset = Constants::DATASETS + distribution + "_" + to_string(cardinality) + "_" + to_string(skewness) + "_2_.csv";
+    }
+
+    vector<QueryRecord> records = query_log::read(log_file);
+    FileReader filereader;
+    vector<Point> points = filereader.get_points(dataset, ",");
+    if (records.empty() || points.empty())
+    {
+        cerr << "replay: nothing to replay (" << records.size() << " queries, " << points.size() << " points)" << endl;
+        return 1;
+    }
+    cout << "log: " << log_file << " queries: " << records.size() << " dataset: " << dataset << " points: " << points.size() << endl;
+
+    ExpRecorder exp_recorder;
+    exp_recorder.clean();
+    string model_root_path = Constants::TORCH_MODELS + distribution + "_" + to_string(points.size());
+    file_utils::check_dir(model_root_path);
+    RSMI::model_path_root = model_root_path + "/";
+    RSMI *partition = new RSMI(0, config);
+    partition->build(exp_recorder, points);
+    cout << config.get_self();
+
+    vector<ReplayStats> stats(thread_num);
+    atomic<long long> next_query(0);
+    long long query_num = records.size();
+    auto start = chrono::steady_clock::now();
+    vector<thread> threads;
+    for (int thread_id = 0; thread_id < thread_num; thread_id++)
+    {
+        threads.push_back(thread([&, thread_id]() {
+            ReplayStats &thread_stats = stats[thread_id];
+            ExpRecorder exp_recorder;
+            exp_recorder.clean();
+            while (true)
+            {
+                long long i = next_query++;
+                if (i >= query_num)
+                {
+                    break;
+                }
+                QueryRecord &record = records[i];
+                auto due = start + chrono::nanoseconds((long long)(record.timestamp / speed_up));
+                // sleep wake-ups run tens of us late, so spin for the last stretch to keep them
+                // out of the queueing delay
+                this_thread::sleep_until(due - chrono::microseconds(SPIN_US));
+                while (chrono::steady_clock::now() < due)
+                {
+                }
+                auto begin = chrono::steady_clock::now();
+                if (record.type == POINT)
+                {
+                    partition->point_query(exp_recorder, record.get_point());
+                }
+                else if (record.type == WINDOW)
+                {
+                    Mbr window = record.get_window();
+                    partition->window_query(exp_recorder, window.get_corner_points(), window);
+                    exp_recorder.window_query_results.clear();
+                }
+                else
+                {
+                    priority_queue<Point, vector<Point>, sortForKNN2> temp_pq;
+                    exp_recorder.pq = temp_pq;
+                    partition->kNN_query(exp_recorder, record.get_point(), record.k);
+                }
+                auto finish = chrono::steady_clock::now();
+                long long queueing_delay = chrono::duration_cast<chrono::nanoseconds>(begin - due).count();
+                queueing_delay = queueing_delay < 0 ? 0 : queueing_delay;
+                long long service_time = chrono::duration_cast<chrono::nanoseconds>(finish - begin).count();
+                thread_stats.latencies[record.type].record(queueing_delay + service_time);
+                thread_stats.queueing_delays[record.type].record(queueing_delay);
+                thread_stats.service_times[record.type].record(service_time);
+            }
+        }));
+    }
+    for (thread &t : threads)
+    {
+        t.join();
+    }
+    double elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count() / 1e9;
+    double logged = records.back().timestamp / 1e9 / speed_up;
+
+    string folder = Constants::RECORDS + Constants::REPLAY;
+    file_utils::check_dir(folder);
+    string log_name = log_file.substr(log_file.find_last_of('/') + 1);
+    ofstream write(folder + log_name + "_" + to_string(speed_up) + "_" + to_string(thread_num) + ".txt", ios::app);
+    string result = "queries:" + to_string(query_num) + "\n" + "offered_rate:" + to_string(logged > 0 ? query_num / logged : 0) + "\n" + "throughput:" + to_string(query_num / elapsed) + "\n";
+    for (int type = 0; type < QUERY_TYPE_NUM; type++)
+    {
+        Histogram latencies, queueing_delays, service_times;
+        for (ReplayStats &thread_stats : stats)
+        {
+            latencies.merge(thread_stats.latencies[type]);
+            queueing_delays.merge(thread_stats.queueing_delays[type]);
+            service_times.merge(thread_stats.service_times[type]);
+        }
+        if (latencies.count == 0)
+        {
+            continue;
+        }
+        string name = QUERY_TYPE_NAMES[type];
+        result += name + "_num:" + to_string(latencies.count) + "\n" + name + "_time:" + to_string(latencies.mean()) + "\n" + name + "_queueing:" + to_string(queueing_delays.mean()) + "\n" + latencies.get_percentiles(name + "_time") + queueing_delays.get_percentiles(name + "_queueing") + service_times.get_percentiles(name + "_service");
+    }
+    write << result;
+    write.close();
+    cout << result;
+    return 0;
+}
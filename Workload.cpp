@@ -0,0 +1,295 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <queue>
+#include <mutex>
+#include <shared_mutex>
+#include <getopt.h>
+#include "utils/FileReader.h"
+#include "indices/RSMI.h"
+#include "indices/RTree.h"
+#include "utils/ExpRecorder.h"
+#include "utils/Constants.h"
+#include "utils/Histogram.h"
+#include "utils/Workload.h"
+#include "utils/util.h"
+
+using namespace std;
+using namespace workload;
+
+// Drives an index with the workload of a config file (see utils/Workload.h and workloads/):
+// a mix of point, window and kNN queries, inserts and deletes issued by closed-loop threads
+// or at an open-loop arrival rate for a fixed duration. Queries share a reader lock and
+// updates take the writer lock. Throughput and latency are reported per report interval and
+// per operation type, on stdout and under RECORDS/workload/.
+// usage: Workload -w <config file>
+
+// operation results of one thread; latencies are in ns, interval slots by completion time
+struct ThreadStats
+{
+    vector<Histogram> interval_latencies;
+    Histogram latencies[OPERATION_NUM];
+    double page_access[OPERATION_NUM] = {0, 0, 0, 0, 0};
+};
+
+bool point_query(RSMI *index, ExpRecorder &exp_recorder, Point point)
+{
+    return index->point_query(exp_recorder, point);
+}
+
+bool point_query(RTree *index, ExpRecorder &exp_recorder, Point point)
+{
+    return index->point_query(exp_recorder, point);
+}
+
+long long window_query(RSMI *index, ExpRecorder &exp_recorder, Mbr window)
+{
+    vector<Point> vertexes = window.get_corner_points();
+    index->window_query(exp_recorder, vertexes, window);
+    long long size = exp_recorder.window_query_results.size();
+    exp_recorder.window_query_results.clear();
+    return size;
+}
+
+long long window_query(RTree *index, ExpRecorder &exp_recorder, Mbr window)
+{
+    return index->window_query(exp_recorder, window).size();
+}
+
+long long kNN_query(RSMI *index, ExpRecorder &exp_recorder, Point point, int k)
+{
+    priority_queue<Point, vector<Point>, sortForKNN2> temp_pq;
+    exp_recorder.pq = temp_pq;
+    return index->kNN_query(exp_recorder, point, k).size();
+}
+
+long long kNN_query(RTree *index, ExpRecorder &exp_recorder, Point point, int k)
+{
+    return index->kNN_query(exp_recorder, point, k).size();
+}
+
+void remove(RSMI *index, ExpRecorder &exp_recorder, Point point)
+{
+    index->remove(exp_recorder, point);
+}
+
+// WorkloadConfig::validate rejects deletes for RTree
+void remove(RTree *index, ExpRecorder &exp_recorder, Point point)
+{
+}
+
+template <typename T>
+void run_workload(T *index, WorkloadConfig &config, vector<Point> &points, string record_name)
+{
+    int interval_num = (int)ceil(config.duration / config.report_interval);
+    vector<ThreadStats> stats(config.threads);
+    for (ThreadStats &thread_stats : stats)
+    {
+        thread_stats.interval_latencies.resize(interval_num);
+    }
+    KeyGenerator keys(config, points.size());
+    shared_timed_mutex index_mutex;
+    float window_x = sqrt(config.window_area * config.window_ratio);
+    float window_y = sqrt(config.window_area / config.window_ratio);
+    double cumulative_mix[OPERATION_NUM];
+    double total = 0;
+    for (int operation = 0; operation < OPERATION_NUM; operation++)
+    {
+        total += config.mix[operation];
+        cumulative_mix[operation] = total / 100;
+    }
+
+    auto start = chrono::steady_clock::now();
+    auto end = start + chrono::nanoseconds((long long)(config.duration * 1e9));
+    long long interval_ns = (long long)(config.report_interval * 1e9);
+    vector<thread> threads;
+    for (int thread_id = 0; thread_id < config.threads; thread_id++)
+    {
+        threads.push_back(thread([&, thread_id]() {
+            ThreadStats &thread_stats = stats[thread_id];
+            ExpRecorder exp_recorder;
+            exp_recorder.clean();
+            mt19937_64 gen(config.seed + thread_id);
+            uniform_real_distribution<double> unit(0, 1);
+            exponential_distribution<double> interarrival(config.rate > 0 ? config.rate / config.threads : 1);
+            auto arrival = start;
+            while (true)
+            {
+                double u = unit(gen);
+                int operation = 0;
+                while (operation < OPERATION_NUM - 1 && u >= cumulative_mix[operation])
+                {
+                    operation++;
+                }
+                Point point = operation == INSERT ? Point(unit(gen), unit(gen)) : points[keys.next(gen)];
+                float x1 = point.x + window_x > 1 ? 1 - window_x : point.x;
+                float y1 = point.y + window_y > 1 ? 1 - window_y : point.y;
+                Mbr window(x1, y1, x1 + window_x, y1 + window_y);
+
+                if (config.rate > 0)
+                {
+                    arrival += chrono::nanoseconds((long long)(interarrival(gen) * 1e9));
+                    if (arrival >= end)
+                    {
+                        break;
+                    }
+                    this_thread::sleep_until(arrival);
+                }
+                else
+                {
+                    arrival = chrono::steady_clock::now();
+                    if (arrival >= end)
+                    {
+                        break;
+                    }
+                }
+                double page_access = exp_recorder.page_access;
+                if (operation == INSERT || operation == DELETE)
+                {
+                    unique_lock<shared_timed_mutex> lock(index_mutex);
+                    if (operation == INSERT)
+                    {
+                        index->insert(exp_recorder, point);
+                    }
+                    else
+                    {
+                        remove(index, exp_recorder, point);
+                    }
+                }
+                else
+                {
+                    shared_lock<shared_timed_mutex> lock(index_mutex);
+                    if (operation == POINT)
+                    {
+                        point_query(index, exp_recorder, point);
+                    }
+                    else if (operation == WINDOW)
+                    {
+                        window_query(index, exp_recorder, window);
+                    }
+                    else
+                    {
+                        kNN_query(index, exp_recorder, point, config.k);
+                    }
+                }
+                auto finish = chrono::steady_clock::now();
+                long long latency = chrono::duration_cast<chrono::nanoseconds>(finish - arrival).count();
+                int interval = chrono::duration_cast<chrono::nanoseconds>(finish - start).count() / interval_ns;
+                interval = interval >= interval_num ? interval_num - 1 : interval;
+                thread_stats.interval_latencies[interval].record(latency);
+                thread_stats.latencies[operation].record(latency);
+                thread_stats.page_access[operation] += exp_recorder.page_access - page_access;
+            }
+        }));
+    }
+    for (thread &t : threads)
+    {
+        t.join();
+    }
+
+    string folder = Constants::RECORDS + Constants::WORKLOAD;
+    file_utils::check_dir(folder);
+    ofstream series(folder + record_name + ".csv", ios::out);
+    series << "time,throughput,p50,p99,p999,max" << endl;
+    cout << "time(s)  throughput(op/s)  p50(ns)  p99(ns)  p999(ns)  max(ns)" << endl;
+    for (int interval = 0; interval < interval_num; interval++)
+    {
+        Histogram latencies;
+        for (ThreadStats &thread_stats : stats)
+        {
+            latencies.merge(thread_stats.interval_latencies[interval]);
+        }
+        double time = (interval + 1) * config.report_interval;
+        double throughput = latencies.count / config.report_interval;
+        series << time << "," << throughput << "," << latencies.percentile(0.5) << "," << latencies.percentile(0.99) << "," << latencies.percentile(0.999) << "," << latencies.max_value << endl;
+        cout << time << "  " << throughput << "  " << latencies.percentile(0.5) << "  " << latencies.percentile(0.99) << "  " << latencies.percentile(0.999) << "  " << latencies.max_value << endl;
+    }
+    series.close();
+
+    ofstream summary(folder + record_name + ".txt", ios::app);
+    long long total_count = 0;
+    for (int operation = 0; operation < OPERATION_NUM; operation++)
+    {
+        Histogram latencies;
+        double page_access = 0;
+        for (ThreadStats &thread_stats : stats)
+        {
+            latencies.merge(thread_stats.latencies[operation]);
+            page_access += thread_stats.page_access[operation];
+        }
+        if (latencies.count == 0)
+        {
+            continue;
+        }
+        total_count += latencies.count;
+        string name = OPERATION_NAMES[operation];
+        string result = name + "_num:" + to_string(latencies.count) + "\n" + name + "_throughput:" + to_string(latencies.count / config.duration) + "\n" + name + "_time:" + to_string(latencies.mean()) + "\n" + name + "_pageaccess:" + to_string(page_access / latencies.count) + "\n" + latencies.get_percentiles(name + "_time");
+        summary << result;
+        cout << result;
+    }
+    summary << "throughput:" << total_count / config.duration << endl;
+    cout << "throughput: " << total_count / config.duration << endl;
+    summary.close();
+}
+
+string RSMI::model_path_root = "";
+int main(int argc, char **argv)
+{
+    string config_file;
+    int c;
+    while ((c = getopt(argc, argv, "w:")) != -1)
+    {
+        if (c == 'w')
+        {
+            config_file = optarg;
+        }
+    }
+    WorkloadConfig config;
+    if (config_file.empty())
+    {
+        cerr << "usage: Workload -w <config file>" << endl;
+        return 1;
+    }
+    if (!config.load(config_file))
+    {
+        return 1;
+    }
+
+    FileReader filereader;
+    vector<Point> points = filereader.get_points(config.get_dataset(), ",");
+    if (points.empty())
+    {
+        cerr << "workload: no points in " << config.get_dataset() << endl;
+        return 1;
+    }
+    cout << "dataset: " << config.get_dataset() << " points: " << points.size() << endl;
+
+    string record_name = config.index + "_" + config.distribution + "_" + to_string(points.size()) + "_" + to_string(config.skewness) + "_" + to_string(config.threads) + "_" + to_string((long long)config.rate);
+    ExpRecorder exp_recorder;
+    exp_recorder.clean();
+    exp_recorder.structure_name = config.index;
+    exp_recorder.config = config.index_config;
+    auto start = chrono::high_resolution_clock::now();
+    if (config.index == "RSMI")
+    {
+        string model_root_path = Constants::TORCH_MODELS + config.distribution + "_" + to_string(points.size());
+        file_utils::check_dir(model_root_path);
+        RSMI::model_path_root = model_root_path + "/";
+        RSMI *index = new RSMI(0, config.index_config);
+        index->build(exp_recorder, points);
+        cout << "build time: " << chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - start).count() << endl;
+        run_workload(index, config, points, record_name);
+    }
+    else
+    {
+        RTree *index = new RTree();
+        index->build(exp_recorder, points);
+        cout << "build time: " << chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - start).count() << endl;
+        run_workload(index, config, points, record_name);
+    }
+    return 0;
+}
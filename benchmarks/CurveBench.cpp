@@ -0,0 +1,126 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <stdlib.h>
+#include <getopt.h>
+#include "../curves/hilbert.H"
+#include "../curves/hilbert4.H"
+#include "../curves/z.H"
+
+using namespace std;
+
+// Throughput of the curve encoders: the original bit loops against the batch encoders
+// (lookup-table Hilbert, BMI2 / magic-bits Z) over the same random coordinates.
+// usage: CurveBench -n <points> -b <bits per coordinate> -r <repeats>
+
+template <typename F>
+double run(const char *name, long long n, int repeats, long long &checksum, F f)
+{
+    auto start = chrono::high_resolution_clock::now();
+    for (int r = 0; r < repeats; r++)
+    {
+        checksum += f();
+    }
+    auto finish = chrono::high_resolution_clock::now();
+    double ns = chrono::duration_cast<chrono::nanoseconds>(finish - start).count() * 1.0 / (n * repeats);
+    cout << name << ": " << ns << " ns/point, " << 1000.0 / ns << " M points/s" << endl;
+    return ns;
+}
+
+int main(int argc, char **argv)
+{
+    long long n = 1000000;
+    int bits = 16;
+    int repeats = 5;
+    int c;
+    while ((c = getopt(argc, argv, "n:b:r:")) != -1)
+    {
+        switch (c)
+        {
+        case 'n':
+            n = atoll(optarg);
+            break;
+        case 'b':
+            bits = atoi(optarg);
+            break;
+        case 'r':
+            repeats = atoi(optarg);
+            break;
+        }
+    }
+    long long side = 1LL << bits;
+    mt19937_64 gen(42);
+    vector<long long> xs(n), ys(n), expected(n), result(n);
+    for (long long i = 0; i < n; i++)
+    {
+        xs[i] = gen() % side;
+        ys[i] = gen() % side;
+    }
+
+    cout << "points: " << n << " bits: " << bits << " bmi2: " << (z_uses_bmi2() ? "yes" : "no") << endl;
+    long long checksum = 0;
+
+    for (long long i = 0; i < n; i++)
+    {
+        expected[i] = compute_Hilbert_value(xs[i], ys[i], side);
+    }
+    run("hilbert loop", n, repeats, checksum, [&]() {
+        long long sum = 0;
+        for (long long i = 0; i < n; i++)
+        {
+            sum += compute_Hilbert_value(xs[i], ys[i], side);
+        }
+        return sum;
+    });
+    run("hilbert4 c2i", n, repeats, checksum, [&]() {
+        long long sum = 0;
+        bitmask_t coord[2];
+        for (long long i = 0; i < n; i++)
+        {
+            coord[0] = xs[i];
+            coord[1] = ys[i];
+            sum += (long long)hilbert_c2i(2, bits, coord);
+        }
+        return sum;
+    });
+    run("hilbert lut batch", n, repeats, checksum, [&]() {
+        compute_Hilbert_values(xs.data(), ys.data(), result.data(), n, side);
+        return result[n - 1];
+    });
+    long long mismatches = 0;
+    for (long long i = 0; i < n; i++)
+    {
+        mismatches += result[i] != expected[i];
+    }
+    cout << "hilbert mismatches: " << mismatches << endl;
+
+    for (long long i = 0; i < n; i++)
+    {
+        expected[i] = compute_Z_value(xs[i], ys[i], bits);
+    }
+    run("z loop", n, repeats, checksum, [&]() {
+        long long sum = 0;
+        for (long long i = 0; i < n; i++)
+        {
+            sum += compute_Z_value(xs[i], ys[i], bits);
+        }
+        return sum;
+    });
+    run("z portable batch", n, repeats, checksum, [&]() {
+        compute_Z_values_portable(xs.data(), ys.data(), result.data(), n);
+        return result[n - 1];
+    });
+    run("z batch", n, repeats, checksum, [&]() {
+        compute_Z_values(xs.data(), ys.data(), result.data(), n);
+        return result[n - 1];
+    });
+    mismatches = 0;
+    for (long long i = 0; i < n; i++)
+    {
+        mismatches += result[i] != expected[i];
+    }
+    cout << "z mismatches: " << mismatches << endl;
+    cout << "checksum: " << checksum << endl;
+    return 0;
+}
@@ -0,0 +1,268 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include "../entities/Point.h"
+#include "../indices/RSMI.h"
+#include "../utils/ExpRecorder.h"
+#include "../utils/BufferPool.h"
+
+using namespace std;
+
+// Point and window query latency of RSMI with its leaf pages on disk (RSMIConfig::page_file),
+// per buffer pool size, replacement policy and read mode (RSMIConfig::read_mode). Every run
+// builds the same index over the same seeded uniform points, loading the models trained by the
+// first build from -s, and answers the same point queries one at a time ("point") and -k at a
+// time through the pipelined batch API ("point_batch"), and the same square windows of -a area.
+// With -c the page file is dropped from the OS page cache before each query phase, so misses go
+// to the device. Reported per run: ns per query and buffer pool hits, misses and reads per query.
+// usage: DiskBench -n <points> -q <queries> -w <windows> -a <window area> -t <threshold>
+//                  -b <pool pages,...> -l <lru,clock> -m <sync,uring,pread> -k <batch size>
+//                  -p <page file> -c -s <model store> -f <csv|json> -o <file>
+
+struct Result
+{
+    string policy;
+    long long pool_pages;
+    string read_mode;
+    string query;
+    double ns;
+    double hits;
+    double misses;
+    double reads;
+};
+
+string RSMI::model_path_root = "";
+
+vector<string> split(string list)
+{
+    vector<string> items;
+    stringstream stream(list);
+    string item;
+    while (getline(stream, item, ','))
+    {
+        items.push_back(item);
+    }
+    return items;
+}
+
+// writes back the dirty frames and evicts the file from the page cache
+void drop_cache(RSMI *index)
+{
+    buffer_pool::BufferPool *pool = index->get_buffer_pool();
+    pool->flush();
+    int fd = pool->get_file().get_fd();
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+}
+
+Result run(string query, int policy, long long pool_pages, int read_mode, long long query_num, ExpRecorder &exp_recorder, long long ns)
+{
+    Result result = {buffer_pool::POLICY_NAMES[policy], pool_pages, buffer_pool::READ_MODE_NAMES[read_mode], query, ns * 1.0 / query_num, exp_recorder.io_stats.hits * 1.0 / query_num, exp_recorder.io_stats.misses * 1.0 / query_num, exp_recorder.io_stats.reads * 1.0 / query_num};
+    cerr << result.policy << " " << pool_pages << " pages " << result.read_mode << ", " << query << ": " << result.ns << " ns/query, " << result.hits << " hits, " << result.misses << " misses, " << result.reads << " reads per query" << endl;
+    exp_recorder.io_stats = buffer_pool::IoStats();
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    long long point_num = 1000000;
+    long long query_num = 100000;
+    long long window_num = 1000;
+    double area = 0.0001;
+    RSMIConfig config;
+    config.page_file = "./rsmi_pages.bin";
+    vector<long long> pool_sizes = {256, 4096, 65536};
+    vector<int> policies = {buffer_pool::LRU, buffer_pool::CLOCK};
+    vector<int> read_modes = {buffer_pool::SYNC, buffer_pool::URING};
+    int batch_size = 64;
+    bool is_cold = false;
+    RSMI::model_path_root = "./torch_models/diskbench/";
+    string format = "csv";
+    string output;
+    int c;
+    while ((c = getopt(argc, argv, "n:q:w:a:t:b:l:m:k:p:cs:f:o:")) != -1)
+    {
+        switch (c)
+        {
+        case 'n':
+            point_num = atoll(optarg);
+            break;
+        case 'q':
+            query_num = atoll(optarg);
+            break;
+        case 'w':
+            window_num = atoll(optarg);
+            break;
+        case 'a':
+            area = atof(optarg);
+            break;
+        case 't':
+            config.threshold = atoi(optarg);
+            break;
+        case 'b':
+            pool_sizes.clear();
+            for (string item : split(optarg))
+            {
+                pool_sizes.push_back(atoll(item.c_str()));
+            }
+            break;
+        case 'l':
+            policies.clear();
+            for (string item : split(optarg))
+            {
+                int policy = buffer_pool::parse_policy(item);
+                if (policy < 0)
+                {
+                    cerr << "unknown buffer pool policy " << item << endl;
+                    return 1;
+                }
+                policies.push_back(policy);
+            }
+            break;
+        case 'm':
+            read_modes.clear();
+            for (string item : split(optarg))
+            {
+                int read_mode = buffer_pool::parse_read_mode(item);
+                if (read_mode < 0)
+                {
+                    cerr << "unknown read mode " << item << endl;
+                    return 1;
+                }
+                read_modes.push_back(read_mode);
+            }
+            break;
+        case 'k':
+            batch_size = atoi(optarg);
+            break;
+        case 'p':
+            config.page_file = optarg;
+            break;
+        case 'c':
+            is_cold = true;
+            break;
+        case 's':
+            RSMI::model_path_root = optarg;
+            break;
+        case 'f':
+            format = optarg;
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        }
+    }
+
+    mt19937_64 gen(42);
+    uniform_real_distribution<float> unit(0, 1);
+    vector<Point> points(point_num);
+    for (long long i = 0; i < point_num; i++)
+    {
+        points[i] = Point(unit(gen), unit(gen));
+    }
+    vector<Point> queries(query_num);
+    for (long long i = 0; i < query_num; i++)
+    {
+        queries[i] = points[gen() % point_num];
+    }
+    float side = sqrt(area);
+    vector<Mbr> windows(window_num);
+    for (long long i = 0; i < window_num; i++)
+    {
+        float x = unit(gen) * (1 - side);
+        float y = unit(gen) * (1 - side);
+        windows[i] = Mbr(x, y, x + side, y + side);
+    }
+
+    vector<Result> results;
+    for (int policy : policies)
+    {
+        for (long long pool_pages : pool_sizes)
+        {
+            for (int read_mode : read_modes)
+            {
+                config.buffer_pool_policy = policy;
+                config.buffer_pool_pages = pool_pages;
+                config.read_mode = read_mode;
+                ExpRecorder exp_recorder;
+                exp_recorder.clean();
+                RSMI *index = new RSMI(0, config);
+                index->build(exp_recorder, points);
+
+                if (is_cold)
+                {
+                    drop_cache(index);
+                }
+                exp_recorder.clean();
+                long long found = 0;
+                auto start = chrono::high_resolution_clock::now();
+                for (Point &query : queries)
+                {
+                    found += index->point_query(exp_recorder, query);
+                }
+                auto finish = chrono::high_resolution_clock::now();
+                results.push_back(run("point", policy, pool_pages, read_mode, query_num, exp_recorder, chrono::duration_cast<chrono::nanoseconds>(finish - start).count()));
+
+                if (is_cold)
+                {
+                    drop_cache(index);
+                }
+                start = chrono::high_resolution_clock::now();
+                long long batch_found = index->point_query(exp_recorder, queries, batch_size);
+                finish = chrono::high_resolution_clock::now();
+                results.push_back(run("point_batch", policy, pool_pages, read_mode, query_num, exp_recorder, chrono::duration_cast<chrono::nanoseconds>(finish - start).count()));
+
+                if (is_cold)
+                {
+                    drop_cache(index);
+                }
+                long long result_num = 0;
+                start = chrono::high_resolution_clock::now();
+                for (Mbr &window : windows)
+                {
+                    index->window_query(exp_recorder, window.get_corner_points(), window);
+                    result_num += exp_recorder.window_query_results.size();
+                    exp_recorder.window_query_results.clear();
+                }
+                finish = chrono::high_resolution_clock::now();
+                results.push_back(run("window", policy, pool_pages, read_mode, window_num, exp_recorder, chrono::duration_cast<chrono::nanoseconds>(finish - start).count()));
+                cerr << "found " << found << "/" << query_num << " (batched " << batch_found << "), " << result_num * 1.0 / window_num << " points per window" << endl;
+                delete index;
+            }
+        }
+    }
+
+    ofstream file;
+    if (!output.empty())
+    {
+        file.open(output);
+    }
+    ostream &out = output.empty() ? cout : file;
+    if (format == "json")
+    {
+        out << "[" << endl;
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            Result &result = results[i];
+            out << "  {\"policy\": \"" << result.policy << "\", \"pool_pages\": " << result.pool_pages << ", \"read_mode\": \"" << result.read_mode << "\", \"query\": \"" << result.query << "\", \"ns\": " << result.ns << ", \"hits\": " << result.hits << ", \"misses\": " << result.misses << ", \"reads\": " << result.reads << "}" << (i + 1 < results.size() ? "," : "") << endl;
+        }
+        out << "]" << endl;
+    }
+    else
+    {
+        out << "policy,pool_pages,read_mode,query,ns,hits,misses,reads" << endl;
+        for (Result &result : results)
+        {
+            out << result.policy << "," << result.pool_pages << "," << result.read_mode << "," << result.query << "," << result.ns << "," << result.hits << "," << result.misses << "," << result.reads << endl;
+        }
+    }
+    return 0;
+}
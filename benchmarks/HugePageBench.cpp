@@ -0,0 +1,195 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <stdlib.h>
+#include <getopt.h>
+#include "../entities/Point.h"
+#include "../indices/RSMI.h"
+#include "../utils/ExpRecorder.h"
+#include "../utils/HugePages.h"
+#include "../utils/PerfCounters.h"
+
+using namespace std;
+
+// Point query latency of RSMI with its arenas on regular pages and on transparent or explicit
+// 2 MB pages (RSMIConfig::huge_pages). Every mode builds the same index over the same seeded
+// uniform points, loading the models trained by the first build from -s, and answers the same
+// shuffled point queries -r times. Reported per mode: the memory each page mode actually got,
+// the median and minimum ns per query and, built with make bench PERF=on, the dTLB load misses
+// and cycles per query summed over the query phases (the counter reads then inflate the time).
+// usage: HugePageBench -n <points> -q <queries> -r <repeats> -t <threshold>
+//                      -m <off,transparent,explicit> -s <model store> -f <csv|json> -o <file>
+
+struct Result
+{
+    string mode;
+    long long mapped[huge_pages::MODE_NUM];
+    double median_ns;
+    double min_ns;
+    double dtlb_misses;
+    double cycles;
+};
+
+string RSMI::model_path_root = "";
+
+vector<int> parse_modes(string list)
+{
+    vector<int> modes;
+    stringstream stream(list);
+    string item;
+    while (getline(stream, item, ','))
+    {
+        int mode = huge_pages::parse_mode(item);
+        if (mode < 0)
+        {
+            cerr << "unknown huge page mode " << item << endl;
+            exit(1);
+        }
+        modes.push_back(mode);
+    }
+    return modes;
+}
+
+// mean count of event per query over all phases, -1 without counters
+double per_query(const perf_counters::PhaseCounters &counters, int event)
+{
+    if (counters.operation_num == 0)
+    {
+        return -1;
+    }
+    long long total = 0;
+    for (int phase = 0; phase < perf_counters::PHASE_NUM; phase++)
+    {
+        total += counters.counts[phase][event];
+    }
+    return total * 1.0 / counters.operation_num;
+}
+
+int main(int argc, char **argv)
+{
+    long long point_num = 1000000;
+    long long query_num = 1000000;
+    int repeats = 3;
+    RSMIConfig config;
+    vector<int> modes = {huge_pages::OFF, huge_pages::TRANSPARENT, huge_pages::EXPLICIT};
+    RSMI::model_path_root = "./torch_models/hugepagebench/";
+    string format = "csv";
+    string output;
+    int c;
+    while ((c = getopt(argc, argv, "n:q:r:t:m:s:f:o:")) != -1)
+    {
+        switch (c)
+        {
+        case 'n':
+            point_num = atoll(optarg);
+            break;
+        case 'q':
+            query_num = atoll(optarg);
+            break;
+        case 'r':
+            repeats = atoi(optarg);
+            break;
+        case 't':
+            config.threshold = atoi(optarg);
+            break;
+        case 'm':
+            modes = parse_modes(optarg);
+            break;
+        case 's':
+            RSMI::model_path_root = optarg;
+            break;
+        case 'f':
+            format = optarg;
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        }
+    }
+
+    mt19937_64 gen(42);
+    uniform_real_distribution<float> unit(0, 1);
+    vector<Point> points(point_num);
+    for (long long i = 0; i < point_num; i++)
+    {
+        points[i] = Point(unit(gen), unit(gen));
+    }
+    vector<Point> queries(query_num);
+    for (long long i = 0; i < query_num; i++)
+    {
+        queries[i] = points[gen() % point_num];
+    }
+
+    vector<Result> results;
+    for (int mode : modes)
+    {
+        config.huge_pages = mode;
+        ExpRecorder exp_recorder;
+        exp_recorder.clean();
+        RSMI *index = new RSMI(0, config);
+        index->build(exp_recorder, points);
+
+        Result result = {huge_pages::MODE_NAMES[mode], {0, 0, 0}, 0, 0, -1, -1};
+        huge_pages::PageSource *source = index->get_page_source();
+        for (int backed = 0; backed < huge_pages::MODE_NUM; backed++)
+        {
+            result.mapped[backed] = source == NULL ? 0 : source->get_mapped_bytes((huge_pages::Mode)backed);
+        }
+
+        long long found = 0;
+        for (Point &query : queries)
+        {
+            found += index->point_query(exp_recorder, query);
+        }
+        exp_recorder.phase_counters.clean();
+        vector<double> ns(repeats);
+        for (int r = 0; r < repeats; r++)
+        {
+            auto start = chrono::high_resolution_clock::now();
+            for (Point &query : queries)
+            {
+                found += index->point_query(exp_recorder, query);
+            }
+            auto finish = chrono::high_resolution_clock::now();
+            ns[r] = chrono::duration_cast<chrono::nanoseconds>(finish - start).count() * 1.0 / query_num;
+        }
+        sort(ns.begin(), ns.end());
+        result.median_ns = ns[repeats / 2];
+        result.min_ns = ns[0];
+        result.dtlb_misses = per_query(exp_recorder.phase_counters, perf_counters::DTLB_MISSES);
+        result.cycles = per_query(exp_recorder.phase_counters, perf_counters::CYCLES);
+        results.push_back(result);
+        cerr << result.mode << ": " << result.median_ns << " ns/query, " << result.dtlb_misses << " dTLB misses/query, found " << found << "/" << query_num * (repeats + 1) << endl;
+        delete index;
+    }
+
+    ofstream file;
+    if (!output.empty())
+    {
+        file.open(output);
+    }
+    ostream &out = output.empty() ? cout : file;
+    if (format == "json")
+    {
+        out << "[" << endl;
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            Result &result = results[i];
+            out << "  {\"mode\": \"" << result.mode << "\", \"mapped_off\": " << result.mapped[huge_pages::OFF] << ", \"mapped_transparent\": " << result.mapped[huge_pages::TRANSPARENT] << ", \"mapped_explicit\": " << result.mapped[huge_pages::EXPLICIT] << ", \"median_ns\": " << result.median_ns << ", \"min_ns\": " << result.min_ns << ", \"dtlb_misses\": " << result.dtlb_misses << ", \"cycles\": " << result.cycles << "}" << (i + 1 < results.size() ? "," : "") << endl;
+        }
+        out << "]" << endl;
+    }
+    else
+    {
+        out << "mode,mapped_off,mapped_transparent,mapped_explicit,median_ns,min_ns,dtlb_misses,cycles" << endl;
+        for (Result &result : results)
+        {
+            out << result.mode << "," << result.mapped[huge_pages::OFF] << "," << result.mapped[huge_pages::TRANSPARENT] << "," << result.mapped[huge_pages::EXPLICIT] << "," << result.median_ns << "," << result.min_ns << "," << result.dtlb_misses << "," << result.cycles << endl;
+        }
+    }
+    return 0;
+}
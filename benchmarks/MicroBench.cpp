@@ -0,0 +1,398 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <queue>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <stdlib.h>
+#include <getopt.h>
+#include "../entities/Point.h"
+#include "../entities/Mbr.h"
+#include "../entities/LeafNode.h"
+#include "../curves/hilbert.H"
+#include "../curves/z.H"
+#include "../utils/ModelTools.h"
+#include "../utils/SortTools.h"
+
+using namespace std;
+
+// Isolated kernels of the RSMI query path, each timed over the same seeded inputs so runs are
+// comparable: model inference (Net::predict, predict_ZM) per hidden width, curve encoding, Mbr
+// tests, and, per page size, a leaf page scan, the point query gap search, the kNN heap and
+// window scans of Point pages and of CompressedPages.
+// Every kernel is run once to warm up and then -r times; the median and the minimum ns per
+// operation are reported as CSV or JSON so results can be diffed between commits.
+// usage: MicroBench -n <ops> -r <repeats> -w <widths> -p <page sizes> -e <error pages> -k <k>
+//                   -f <csv|json> -o <file>
+
+struct Result
+{
+    string kernel;
+    int width;
+    int page_size;
+    long long ops;
+    double median_ns;
+    double min_ns;
+};
+
+vector<Result> results;
+// folded into the output so the compiler cannot drop a kernel's work
+long long checksum = 0;
+
+template <typename F>
+void run(string kernel, int width, int page_size, long long ops, int repeats, F f)
+{
+    checksum += (long long)f();
+    vector<double> ns(repeats);
+    for (int r = 0; r < repeats; r++)
+    {
+        auto start = chrono::high_resolution_clock::now();
+        checksum += (long long)f();
+        auto finish = chrono::high_resolution_clock::now();
+        ns[r] = chrono::duration_cast<chrono::nanoseconds>(finish - start).count() * 1.0 / ops;
+    }
+    sort(ns.begin(), ns.end());
+    results.push_back({kernel, width, page_size, ops, ns[repeats / 2], ns[0]});
+    cerr << kernel << " width " << width << " page_size " << page_size << ": " << ns[repeats / 2] << " ns/op" << endl;
+}
+
+vector<int> parse_list(string list)
+{
+    vector<int> values;
+    stringstream stream(list);
+    string item;
+    while (getline(stream, item, ','))
+    {
+        values.push_back(atoi(item.c_str()));
+    }
+    return values;
+}
+
+// pages of page_size points in Z order, like the leaf level of an RSMI partition
+vector<LeafNode> build_pages(vector<Point> points, int page_size)
+{
+    const int bits = 16;
+    vector<long long> keys(points.size());
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        keys[i] = compute_Z_value((long long)(points[i].x * ((1 << bits) - 1)), (long long)(points[i].y * ((1 << bits) - 1)), bits);
+    }
+    vector<size_t> order(points.size());
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        order[i] = i;
+    }
+    sort(order.begin(), order.end(), [&](size_t a, size_t b) { return keys[a] < keys[b]; });
+    vector<LeafNode> pages;
+    for (size_t i = 0; i < order.size(); i += page_size)
+    {
+        LeafNode page;
+        for (size_t j = i; j < i + page_size && j < order.size(); j++)
+        {
+            page.add_point(points[order[j]]);
+        }
+        pages.push_back(page);
+    }
+    return pages;
+}
+
+// the leaf branch of RSMI::point_query: the predicted page, then pages at growing gaps on
+// both sides within [predicted + min_error, predicted + max_error]
+bool gap_search(vector<LeafNode> &pages, int predicted_index, int min_error, int max_error, Point query_point)
+{
+    int page_num = pages.size();
+    if (pages[predicted_index].mbr.contains(query_point))
+    {
+        PointPage::iterator iter = find(pages[predicted_index].children->begin(), pages[predicted_index].children->end(), query_point);
+        if (iter != pages[predicted_index].children->end())
+        {
+            return true;
+        }
+    }
+    int front = predicted_index + min_error;
+    front = front < 0 ? 0 : front;
+    int back = predicted_index + max_error;
+    back = back >= page_num ? page_num - 1 : back;
+    int gap = 1;
+    while (predicted_index - gap >= front || predicted_index + gap <= back)
+    {
+        int sides[2] = {predicted_index - gap, predicted_index + gap};
+        for (int side : sides)
+        {
+            if (side < front || side > back || !pages[side].mbr.contains(query_point))
+            {
+                continue;
+            }
+            for (Point point : (*pages[side].children))
+            {
+                if (query_point.x == point.x && query_point.y == point.y)
+                {
+                    return true;
+                }
+            }
+        }
+        gap++;
+    }
+    return false;
+}
+
+int main(int argc, char **argv)
+{
+    long long ops = 1000000;
+    int repeats = 5;
+    vector<int> widths = {8, 16, 32, 50};
+    vector<int> page_sizes = {50, 100, 200};
+    int error_pages = 4;
+    int k = 25;
+    string format = "csv";
+    string output;
+    int c;
+    while ((c = getopt(argc, argv, "n:r:w:p:e:k:f:o:")) != -1)
+    {
+        switch (c)
+        {
+        case 'n':
+            ops = atoll(optarg);
+            break;
+        case 'r':
+            repeats = atoi(optarg);
+            break;
+        case 'w':
+            widths = parse_list(optarg);
+            break;
+        case 'p':
+            page_sizes = parse_list(optarg);
+            break;
+        case 'e':
+            error_pages = atoi(optarg);
+            break;
+        case 'k':
+            k = atoi(optarg);
+            break;
+        case 'f':
+            format = optarg;
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        }
+    }
+
+    mt19937_64 gen(42);
+    uniform_real_distribution<float> unit(0, 1);
+    vector<Point> points(ops);
+    vector<float> keys(ops);
+    vector<long long> xs(ops), ys(ops);
+    vector<Mbr> windows(ops);
+    for (long long i = 0; i < ops; i++)
+    {
+        points[i] = Point(unit(gen), unit(gen));
+        keys[i] = unit(gen);
+        xs[i] = gen() % (1 << 16);
+        ys[i] = gen() % (1 << 16);
+        float x = unit(gen) * 0.99, y = unit(gen) * 0.99;
+        windows[i] = Mbr(x, y, x + 0.01, y + 0.01);
+    }
+
+    for (int width : widths)
+    {
+        Net net(2, width);
+        net.get_parameters();
+        run("net_predict", net.width, 0, ops, repeats, [&]() {
+            double sum = 0;
+            for (long long i = 0; i < ops; i++)
+            {
+                sum += net.predict(points[i]);
+            }
+            return sum;
+        });
+        Net net_zm(1, width);
+        net_zm.get_parameters_ZM();
+        run("net_predict_zm", net_zm.width, 0, ops, repeats, [&]() {
+            double sum = 0;
+            for (long long i = 0; i < ops; i++)
+            {
+                sum += net_zm.predict_ZM(keys[i]);
+            }
+            return sum;
+        });
+    }
+
+    run("hilbert_value", 0, 0, ops, repeats, [&]() {
+        long long sum = 0;
+        for (long long i = 0; i < ops; i++)
+        {
+            sum += compute_Hilbert_value(xs[i], ys[i], 1 << 16);
+        }
+        return sum;
+    });
+    run("z_value", 0, 0, ops, repeats, [&]() {
+        long long sum = 0;
+        for (long long i = 0; i < ops; i++)
+        {
+            sum += compute_Z_value(xs[i], ys[i], 16);
+        }
+        return sum;
+    });
+
+    run("mbr_interact", 0, 0, ops, repeats, [&]() {
+        long long sum = 0;
+        for (long long i = 0; i < ops; i++)
+        {
+            sum += windows[i].interact(windows[(i + 1) % ops]);
+        }
+        return sum;
+    });
+    run("mbr_contains", 0, 0, ops, repeats, [&]() {
+        long long sum = 0;
+        for (long long i = 0; i < ops; i++)
+        {
+            sum += windows[i].contains(points[i]);
+        }
+        return sum;
+    });
+    run("mbr_cal_dist", 0, 0, ops, repeats, [&]() {
+        double sum = 0;
+        for (long long i = 0; i < ops; i++)
+        {
+            sum += windows[i].cal_dist(points[i]);
+        }
+        return sum;
+    });
+
+    // the page kernels touch ops / page_size pages per repeat, so every size does the same work
+    for (int page_size : page_sizes)
+    {
+        vector<LeafNode> pages = build_pages(points, page_size);
+        long long page_num = pages.size();
+        long long query_num = ops / page_size;
+        query_num = query_num < 1 ? 1 : query_num;
+        vector<int> targets(query_num), predictions(query_num);
+        vector<Point> query_points(query_num);
+        for (long long i = 0; i < query_num; i++)
+        {
+            targets[i] = gen() % page_num;
+            PointPage &children = *pages[targets[i]].children;
+            query_points[i] = children[gen() % children.size()];
+            int predicted_index = targets[i] + (int)(gen() % (2 * error_pages + 1)) - error_pages;
+            predictions[i] = predicted_index < 0 ? 0 : (predicted_index >= page_num ? page_num - 1 : predicted_index);
+        }
+        // the same pages compressed, and windows around the query points covering about a
+        // quarter of their page
+        memory_accounting::Arena arena;
+        vector<LeafNode> compressed_pages;
+        for (LeafNode &page : pages)
+        {
+            LeafNode compressed_page(&arena, page_size, true);
+            compressed_page.add_points(page.children->data(), page.children->data() + page.children->size());
+            compressed_pages.push_back(compressed_page);
+        }
+        vector<Mbr> page_windows(query_num);
+        for (long long i = 0; i < query_num; i++)
+        {
+            Mbr &mbr = pages[targets[i]].mbr;
+            float half_width = (mbr.x2 - mbr.x1) / 4;
+            float half_height = (mbr.y2 - mbr.y1) / 4;
+            page_windows[i] = Mbr(query_points[i].x - half_width, query_points[i].y - half_height, query_points[i].x + half_width, query_points[i].y + half_height);
+        }
+
+        run("leaf_scan", 0, page_size, query_num, repeats, [&]() {
+            long long sum = 0;
+            for (long long i = 0; i < query_num; i++)
+            {
+                for (Point point : (*pages[targets[i]].children))
+                {
+                    if (query_points[i].x == point.x && query_points[i].y == point.y)
+                    {
+                        sum++;
+                        break;
+                    }
+                }
+            }
+            return sum;
+        });
+        run("compressed_leaf_scan", 0, page_size, query_num, repeats, [&]() {
+            long long sum = 0;
+            for (long long i = 0; i < query_num; i++)
+            {
+                sum += compressed_pages[targets[i]].has_point(query_points[i]);
+            }
+            return sum;
+        });
+        run("window_scan", 0, page_size, query_num, repeats, [&]() {
+            double sum = 0;
+            for (long long i = 0; i < query_num; i++)
+            {
+                pages[targets[i]].scan(page_windows[i], [&](Point point) { sum += point.x; });
+            }
+            return sum;
+        });
+        run("compressed_window_scan", 0, page_size, query_num, repeats, [&]() {
+            double sum = 0;
+            for (long long i = 0; i < query_num; i++)
+            {
+                compressed_pages[targets[i]].scan(page_windows[i], [&](Point point) { sum += point.x; });
+            }
+            return sum;
+        });
+        run("gap_search", 0, page_size, query_num, repeats, [&]() {
+            long long sum = 0;
+            for (long long i = 0; i < query_num; i++)
+            {
+                sum += gap_search(pages, predictions[i], -error_pages, error_pages, query_points[i]);
+            }
+            return sum;
+        });
+        run("knn_heap", 0, page_size, query_num, repeats, [&]() {
+            double sum = 0;
+            for (long long i = 0; i < query_num; i++)
+            {
+                priority_queue<Point, vector<Point>, sortForKNN2> pq;
+                for (Point point : (*pages[targets[i]].children))
+                {
+                    point.temp_dist = 0;
+                    point.cal_dist(query_points[i]);
+                    pq.push(point);
+                }
+                for (int j = 0; j < k && !pq.empty(); j++)
+                {
+                    sum += pq.top().temp_dist;
+                    pq.pop();
+                }
+            }
+            return sum;
+        });
+        for (LeafNode &page : pages)
+        {
+            delete page.children;
+        }
+    }
+
+    ofstream file;
+    if (!output.empty())
+    {
+        file.open(output);
+    }
+    ostream &out = output.empty() ? cout : file;
+    if (format == "json")
+    {
+        out << "[" << endl;
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            out << "  {\"kernel\": \"" << results[i].kernel << "\", \"width\": " << results[i].width << ", \"page_size\": " << results[i].page_size << ", \"ops\": " << results[i].ops << ", \"ns_per_op\": " << results[i].median_ns << ", \"min_ns_per_op\": " << results[i].min_ns << "}" << (i + 1 < results.size() ? "," : "") << endl;
+        }
+        out << "]" << endl;
+    }
+    else
+    {
+        out << "kernel,width,page_size,ops,ns_per_op,min_ns_per_op" << endl;
+        for (Result result : results)
+        {
+            out << result.kernel << "," << result.width << "," << result.page_size << "," << result.ops << "," << result.median_ns << "," << result.min_ns << endl;
+        }
+    }
+    cerr << "checksum: " << checksum << endl;
+    return 0;
+}
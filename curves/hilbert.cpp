@@ -26,6 +26,7 @@
 //  Workaround for a linker problem with STL and gcc-2.7.2
 
 #include "hilbert.H"
+#include "z.H"
 #include <assert.h>
 #include <cstdio>
 #include <cmath>
@@ -88,3 +89,101 @@ long long compute_Hilbert_value(long long x[], const size_t& x_len, const long l
 }
 
 //  End (Jagadish)
+
+//
+//  Lookup-table version of the loop above. The state of the loop is (rotation, sense), 8
+//  states in total; HILBERTbyte_table[state][b] holds the 4 base-4 digits produced by the
+//  8 interleaved bits b (x bits at even, y bits at odd positions, as in compute_Z_value)
+//  and the next state, packed as (digits << 3) | next_state. HILBERTbit_table does the same
+//  for a single bit of x and y and handles sides that are not a multiple of 4 bits.
+//
+
+static unsigned short HILBERTbyte_table[8][256];
+static unsigned char HILBERTbit_table[8][4];
+
+static int HILBERT_step(int state, int xbit, int ybit, int &digit)
+{
+	int rotation = state >> 1;
+	int sense = (state & 1) ? -1 : 1;
+	int quad = HILBERTquad_table[rotation][xbit][ybit];
+	digit = (sense == -1) ? 3 - quad : quad;
+	rotation += HILBERTrotation_table[quad];
+	if (rotation >= 4) rotation -= 4;
+	sense *= HILBERTsense_table[quad];
+	return (rotation << 1) | (sense == -1 ? 1 : 0);
+}
+
+static bool HILBERT_init_tables()
+{
+	for (int state = 0; state < 8; state++) {
+		for (int bits = 0; bits < 4; bits++) {
+			int digit = 0;
+			int next = HILBERT_step(state, bits & 1, (bits >> 1) & 1, digit);
+			HILBERTbit_table[state][bits] = (unsigned char)((digit << 3) | next);
+		}
+		for (int bits = 0; bits < 256; bits++) {
+			int next = state;
+			int digits = 0;
+			for (int m = 3; m >= 0; m--) {
+				int digit = 0;
+				next = HILBERT_step(next, (bits >> (2 * m)) & 1, (bits >> (2 * m + 1)) & 1, digit);
+				digits = (digits << 2) | digit;
+			}
+			HILBERTbyte_table[state][bits] = (unsigned short)((digits << 3) | next);
+		}
+	}
+	return true;
+}
+
+static const bool HILBERTtables_ready = HILBERT_init_tables();
+
+// returns log2(side), or -1 if side is not a power of two in [1, 2^32]
+static int HILBERT_side_bits(long long side)
+{
+	if (side <= 0 || (side & (side - 1)) != 0) return -1;
+	int bits = __builtin_ctzll((unsigned long long)side);
+	return bits <= 32 ? bits : -1;
+}
+
+static long long HILBERT_walk(unsigned long long z, int bits)
+{
+	int state = 0;
+	unsigned long long num = 0;
+	while (bits % 4 != 0) {
+		bits--;
+		unsigned char entry = HILBERTbit_table[state][(z >> (2 * bits)) & 3];
+		num = (num << 2) | (entry >> 3);
+		state = entry & 7;
+	}
+	while (bits > 0) {
+		bits -= 4;
+		unsigned short entry = HILBERTbyte_table[state][(z >> (2 * bits)) & 0xFF];
+		num = (num << 8) | (entry >> 3);
+		state = entry & 7;
+	}
+	return (long long)num;
+}
+
+long long compute_Hilbert_value_lut(long long x, long long y, long long side)
+{
+	int bits = HILBERT_side_bits(side);
+	if (bits < 0) {
+		return compute_Hilbert_value(x, y, side);
+	}
+	return HILBERT_walk(compute_Z_value(x, y), bits);
+}
+
+void compute_Hilbert_values(const long long x[], const long long y[], long long result[], size_t length, long long side)
+{
+	int bits = HILBERT_side_bits(side);
+	if (bits < 0) {
+		for (size_t i = 0; i < length; i++) {
+			result[i] = compute_Hilbert_value(x[i], y[i], side);
+		}
+		return;
+	}
+	compute_Z_values(x, y, result, length);
+	for (size_t i = 0; i < length; i++) {
+		result[i] = HILBERT_walk(result[i], bits);
+	}
+}
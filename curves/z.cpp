@@ -46,3 +46,80 @@ long long compute_Z_value(long long x, long long y, int bit_num)
 	}
 	return result;
 }
+
+
+// spreads the low 32 bits of v to the even bit positions
+static inline unsigned long long spread_bits(unsigned long long v)
+{
+	v &= 0xFFFFFFFFULL;
+	v = (v | (v << 16)) & 0x0000FFFF0000FFFFULL;
+	v = (v | (v << 8)) & 0x00FF00FF00FF00FFULL;
+	v = (v | (v << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	v = (v | (v << 2)) & 0x3333333333333333ULL;
+	v = (v | (v << 1)) & 0x5555555555555555ULL;
+	return v;
+}
+
+void compute_Z_values_portable(const long long x[], const long long y[], long long result[], size_t length)
+{
+	for (size_t i = 0; i < length; i++)
+	{
+		result[i] = spread_bits(x[i]) | (spread_bits(y[i]) << 1);
+	}
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+__attribute__((target("bmi2")))
+static void compute_Z_values_bmi2(const long long x[], const long long y[], long long result[], size_t length)
+{
+	for (size_t i = 0; i < length; i++)
+	{
+		result[i] = _pdep_u64(x[i] & 0xFFFFFFFFULL, 0x5555555555555555ULL) | _pdep_u64(y[i] & 0xFFFFFFFFULL, 0xAAAAAAAAAAAAAAAAULL);
+	}
+}
+
+static bool detect_bmi2()
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("bmi2");
+}
+#else
+static bool detect_bmi2()
+{
+	return false;
+}
+#endif
+
+typedef void (*z_batch_encoder)(const long long[], const long long[], long long[], size_t);
+
+static z_batch_encoder select_z_encoder()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	if (detect_bmi2())
+	{
+		return compute_Z_values_bmi2;
+	}
+#endif
+	return compute_Z_values_portable;
+}
+
+static const z_batch_encoder z_encoder = select_z_encoder();
+
+bool z_uses_bmi2()
+{
+	return z_encoder != compute_Z_values_portable;
+}
+
+long long compute_Z_value(long long x, long long y)
+{
+	long long result;
+	z_encoder(&x, &y, &result, 1);
+	return result;
+}
+
+void compute_Z_values(const long long x[], const long long y[], long long result[], size_t length)
+{
+	z_encoder(x, y, result, length);
+}
@@ -0,0 +1,233 @@
+#ifndef COMPRESSEDPAGE_H
+#define COMPRESSEDPAGE_H
+
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+#include <emmintrin.h>
+#include "Point.h"
+#include "Mbr.h"
+#include "../utils/MemoryAccounting.h"
+using namespace std;
+
+// Leaf page split into a hot part that scans read and a cold part they rarely touch. The hot
+// part holds every point as 16-bit offsets from the lower corner of the page's MBR, quantized to
+// STEPS steps per side: 4 bytes per point. The cold part is an exact copy of the points' x and y
+// floats, 8 bytes per point, in its own allocation. A page stores 12 bytes per point, more than
+// the 8 bytes of bare x and y and a quarter of a 48-byte Point; what it saves is what a scan
+// reads. Quantization is monotone, so comparing a point's offsets with the offsets of a query's
+// bounds decides most points exactly: offsets strictly between a window's bounds are inside it
+// and offsets beyond them are outside. Scans compare the offsets of 8 points at a time with SSE2
+// and read the cold copy only for points whose offsets equal a bound, and for results. Only x
+// and y of a point are kept.
+class CompressedPage
+{
+public:
+    static const int STEPS = 65535;
+
+    int size = 0;
+    int capacity = 0;
+    float origin_x = 0;
+    float origin_y = 0;
+    // steps per unit; 0 for a page of zero width or height, whose points all share offset 0
+    float inverse_scale_x = 0;
+    float inverse_scale_y = 0;
+    // hot: capacity rounded up to a multiple of 8, 16-byte aligned, right after the page
+    uint16_t *offsets_x = NULL;
+    uint16_t *offsets_y = NULL;
+    // cold: x and y of point i at 2 * i and 2 * i + 1
+    float *coordinates = NULL;
+    memory_accounting::Arena *arena;
+
+    // room for capacity points, allocated from arena and freed with it
+    CompressedPage(memory_accounting::Arena *arena, int capacity)
+    {
+        this->arena = arena;
+        this->capacity = capacity;
+        int padded = get_padded(capacity);
+        offsets_x = (uint16_t *)arena->allocate(padded * sizeof(uint16_t), 16, memory_accounting::LEAF_POINTS);
+        offsets_y = (uint16_t *)arena->allocate(padded * sizeof(uint16_t), 16, memory_accounting::LEAF_POINTS);
+        coordinates = (float *)arena->allocate(capacity * 2 * sizeof(float), 16, memory_accounting::LEAF_POINTS);
+        memset(offsets_x, 0, padded * sizeof(uint16_t));
+        memset(offsets_y, 0, padded * sizeof(uint16_t));
+    }
+
+    static CompressedPage *create(memory_accounting::Arena *arena, int capacity)
+    {
+        void *page = arena->allocate(sizeof(CompressedPage), alignof(CompressedPage), memory_accounting::LEAF_POINTS);
+        return new (page) CompressedPage(arena, capacity);
+    }
+
+    static int get_padded(int capacity)
+    {
+        return (capacity + 7) / 8 * 8;
+    }
+
+    // bytes create takes from a 16-byte aligned arena cursor, which it leaves 16-byte aligned
+    static size_t get_size(int capacity)
+    {
+        return (sizeof(CompressedPage) + 15) / 16 * 16 + get_padded(capacity) * 2 * sizeof(uint16_t) + (capacity * 2 * sizeof(float) + 15) / 16 * 16;
+    }
+
+    static int quantize(float value, float origin, float inverse_scale)
+    {
+        float offset = (value - origin) * inverse_scale;
+        offset = offset < 0 ? 0 : (offset > STEPS ? STEPS : offset);
+        return (int)offset;
+    }
+
+    int quantize_x(float x) const
+    {
+        return quantize(x, origin_x, inverse_scale_x);
+    }
+
+    int quantize_y(float y) const
+    {
+        return quantize(y, origin_y, inverse_scale_y);
+    }
+
+    float get_x(int i) const
+    {
+        return coordinates[2 * i];
+    }
+
+    float get_y(int i) const
+    {
+        return coordinates[2 * i + 1];
+    }
+
+    void set_point(int i, Point point)
+    {
+        coordinates[2 * i] = point.x;
+        coordinates[2 * i + 1] = point.y;
+        offsets_x[i] = quantize_x(point.x);
+        offsets_y[i] = quantize_y(point.y);
+    }
+
+    // replaces the points with length points (at most capacity) quantized over mbr, which
+    // must contain them
+    void encode(const Point *points, int length, const Mbr &mbr)
+    {
+        origin_x = mbr.x1;
+        origin_y = mbr.y1;
+        inverse_scale_x = mbr.x2 > mbr.x1 ? STEPS / (mbr.x2 - mbr.x1) : 0;
+        inverse_scale_y = mbr.y2 > mbr.y1 ? STEPS / (mbr.y2 - mbr.y1) : 0;
+        size = length;
+        for (int i = 0; i < length; i++)
+        {
+            set_point(i, points[i]);
+        }
+    }
+
+    Point get_point(int i) const
+    {
+        return Point(get_x(i), get_y(i));
+    }
+
+    void get_points(vector<Point> &points) const
+    {
+        for (int i = 0; i < size; i++)
+        {
+            points.push_back(get_point(i));
+        }
+    }
+
+    // appends point, false if the page is full; a point outside the quantized box re-encodes
+    // the page over mbr, the page's MBR including point
+    bool add(Point point, const Mbr &mbr)
+    {
+        if (size >= capacity)
+        {
+            return false;
+        }
+        bool is_covered = point.x >= origin_x && point.y >= origin_y && (inverse_scale_x == 0 ? point.x == origin_x : (point.x - origin_x) * inverse_scale_x <= STEPS) && (inverse_scale_y == 0 ? point.y == origin_y : (point.y - origin_y) * inverse_scale_y <= STEPS);
+        if (is_covered)
+        {
+            set_point(size++, point);
+            return true;
+        }
+        vector<Point> points;
+        get_points(points);
+        points.push_back(point);
+        encode(points.data(), points.size(), mbr);
+        return true;
+    }
+
+    // index of a point with point's coordinates, -1 if none
+    int find(Point point) const
+    {
+        __m128i bias = _mm_set1_epi16((short)0x8000);
+        __m128i target_x = _mm_set1_epi16((short)(quantize_x(point.x) ^ 0x8000));
+        __m128i target_y = _mm_set1_epi16((short)(quantize_y(point.y) ^ 0x8000));
+        for (int i = 0; i < size; i += 8)
+        {
+            __m128i x = _mm_xor_si128(_mm_load_si128((const __m128i *)(offsets_x + i)), bias);
+            __m128i y = _mm_xor_si128(_mm_load_si128((const __m128i *)(offsets_y + i)), bias);
+            int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi16(x, target_x), _mm_cmpeq_epi16(y, target_y)));
+            for (int lane = 0; mask != 0 && lane < 8 && i + lane < size; lane++, mask >>= 2)
+            {
+                if ((mask & 1) && get_x(i + lane) == point.x && get_y(i + lane) == point.y)
+                {
+                    return i + lane;
+                }
+            }
+        }
+        return -1;
+    }
+
+    bool remove(Point point)
+    {
+        int i = find(point);
+        if (i < 0)
+        {
+            return false;
+        }
+        int moved = size - i - 1;
+        memmove(offsets_x + i, offsets_x + i + 1, moved * sizeof(uint16_t));
+        memmove(offsets_y + i, offsets_y + i + 1, moved * sizeof(uint16_t));
+        memmove(coordinates + 2 * i, coordinates + 2 * (i + 1), moved * 2 * sizeof(float));
+        size--;
+        return true;
+    }
+
+    // calls f(point) for every point window contains, as Mbr::contains decides it
+    template <class F>
+    void scan(const Mbr &window, F f) const
+    {
+        // offsets are unsigned: flip the sign bit so signed 16-bit compares order them
+        __m128i bias = _mm_set1_epi16((short)0x8000);
+        __m128i low_x = _mm_set1_epi16((short)(quantize_x(window.x1) ^ 0x8000));
+        __m128i high_x = _mm_set1_epi16((short)(quantize_x(window.x2) ^ 0x8000));
+        __m128i low_y = _mm_set1_epi16((short)(quantize_y(window.y1) ^ 0x8000));
+        __m128i high_y = _mm_set1_epi16((short)(quantize_y(window.y2) ^ 0x8000));
+        for (int i = 0; i < size; i += 8)
+        {
+            __m128i x = _mm_xor_si128(_mm_load_si128((const __m128i *)(offsets_x + i)), bias);
+            __m128i y = _mm_xor_si128(_mm_load_si128((const __m128i *)(offsets_y + i)), bias);
+            __m128i outside = _mm_or_si128(_mm_or_si128(_mm_cmplt_epi16(x, low_x), _mm_cmpgt_epi16(x, high_x)), _mm_or_si128(_mm_cmplt_epi16(y, low_y), _mm_cmpgt_epi16(y, high_y)));
+            __m128i inside = _mm_and_si128(_mm_and_si128(_mm_cmpgt_epi16(x, low_x), _mm_cmplt_epi16(x, high_x)), _mm_and_si128(_mm_cmpgt_epi16(y, low_y), _mm_cmplt_epi16(y, high_y)));
+            // two mask bits per lane, keep the low one; padding lanes past size are dropped
+            int inside_mask = _mm_movemask_epi8(inside) & 0x5555;
+            int candidate_mask = ~_mm_movemask_epi8(outside) & 0x5555;
+            if (size - i < 8)
+            {
+                candidate_mask &= (1 << (2 * (size - i))) - 1;
+            }
+            while (candidate_mask != 0)
+            {
+                int bit = __builtin_ctz(candidate_mask);
+                candidate_mask &= candidate_mask - 1;
+                int j = i + bit / 2;
+                float point_x = get_x(j);
+                float point_y = get_y(j);
+                // on a bound: only the exact coordinates can tell
+                if ((inside_mask >> bit & 1) || (window.x1 <= point_x && point_x <= window.x2 && window.y1 <= point_y && point_y <= window.y2))
+                {
+                    f(Point(point_x, point_y));
+                }
+            }
+        }
+    }
+};
+
+#endif
@@ -6,44 +6,176 @@
 #include <algorithm>
 using namespace std;
 
-LeafNode::LeafNode()
+LeafNode::LeafNode() : LeafNode(&memory_accounting::Account::global())
 {
-    children = new vector<Point>();
 }
 
-LeafNode::LeafNode(Mbr mbr)
+LeafNode::LeafNode(Mbr mbr) : LeafNode(&memory_accounting::Account::global())
 {
     this->mbr = mbr;
-    children = new vector<Point>();
 }
 
-void LeafNode::add_point(Point point)
+LeafNode::LeafNode(memory_accounting::Account *account)
 {
-    // add
-    children->push_back(point);
-    // update MBR
+    account->charge(memory_accounting::LEAF_POINTS, sizeof(PointPage));
+    children = new PointPage(PointPage::allocator_type(account));
+}
+
+LeafNode::LeafNode(memory_accounting::Arena *arena, int capacity, bool is_compressed)
+{
+    if (is_compressed)
+    {
+        children = NULL;
+        compressed = CompressedPage::create(arena, capacity);
+        return;
+    }
+    void *page = arena->allocate(sizeof(PointPage), alignof(PointPage), memory_accounting::LEAF_POINTS);
+    children = new (page) PointPage(PointPage::allocator_type(arena));
+    children->reserve(capacity);
+}
+
+LeafNode::LeafNode(buffer_pool::BufferPool *pool, long long page_id)
+{
+    children = NULL;
+    this->pool = pool;
+    this->page_id = page_id;
+}
+
+bool LeafNode::add_point(Point point)
+{
+    if (compressed != NULL)
+    {
+        Mbr grown = mbr;
+        grown.update(point.x, point.y);
+        if (!compressed->add(point, grown))
+        {
+            return false;
+        }
+        mbr = grown;
+        return true;
+    }
+    if (pool != NULL)
+    {
+        buffer_pool::BufferPool::Handle page = pool->fetch(page_id, NULL, true);
+        if (page->size >= page->capacity)
+        {
+            return false;
+        }
+        page->set_point(page->size++, point);
+        mbr.update(point.x, point.y);
+        return true;
+    }
     mbr.update(point.x, point.y);
+    children->push_back(point);
+    return true;
+}
+
+bool LeafNode::add_points(vector<Point> points)
+{
+    return add_points(points.data(), points.data() + points.size());
 }
 
-void LeafNode::add_points(vector<Point> points)
+bool LeafNode::add_points(Point *begin, Point *end)
 {
-    for (int i = 0; i < points.size(); i++)
+    if (pool != NULL)
+    {
+        buffer_pool::BufferPool::Handle page = pool->fetch(page_id, NULL, true);
+        if (page->size + (end - begin) > page->capacity)
+        {
+            return false;
+        }
+        for (Point *point = begin; point != end; point++)
+        {
+            mbr.update(point->x, point->y);
+            page->set_point(page->size++, *point);
+        }
+        return true;
+    }
+    if (compressed != NULL && compressed->size + (end - begin) > compressed->capacity)
+    {
+        return false;
+    }
+    if (compressed != NULL && compressed->size > 0)
+    {
+        for (Point *point = begin; point != end; point++)
+        {
+            add_point(*point);
+        }
+        return true;
+    }
+    for (Point *point = begin; point != end; point++)
     {
-        add_point(points[i]);
+        mbr.update(point->x, point->y);
     }
+    if (compressed != NULL)
+    {
+        compressed->encode(begin, end - begin, mbr);
+        return true;
+    }
+    children->insert(children->end(), begin, end);
+    return true;
+}
+
+bool LeafNode::is_full(int page_size)
+{
+    return size() >= page_size;
+}
+
+int LeafNode::size()
+{
+    if (pool != NULL)
+    {
+        return pool->fetch(page_id)->size;
+    }
+    return compressed != NULL ? compressed->size : children->size();
+}
+
+bool LeafNode::has_point(Point point, buffer_pool::IoStats *io_stats)
+{
+    if (compressed != NULL)
+    {
+        return compressed->find(point) >= 0;
+    }
+    if (pool != NULL)
+    {
+        buffer_pool::BufferPool::Handle page = pool->fetch(page_id, io_stats);
+        for (int i = 0; i < page->size; i++)
+        {
+            if (page->get_point(i).x == point.x && page->get_point(i).y == point.y)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+    return find(children->begin(), children->end(), point) != children->end();
 }
 
-bool LeafNode::is_full()
+void LeafNode::get_points(vector<Point> &points)
 {
-    return children->size() >= Constants::PAGESIZE;
+    if (compressed != NULL)
+    {
+        compressed->get_points(points);
+        return;
+    }
+    if (pool != NULL)
+    {
+        buffer_pool::BufferPool::Handle page = pool->fetch(page_id);
+        for (int i = 0; i < page->size; i++)
+        {
+            points.push_back(page->get_point(i));
+        }
+        return;
+    }
+    points.insert(points.end(), children->begin(), children->end());
 }
 
-LeafNode *LeafNode::split()
+LeafNode *LeafNode::split(int page_size)
 {
     // build rightNode
-    LeafNode *right = new LeafNode();
+    LeafNode *right = new LeafNode(children->get_allocator().account);
     right->parent = this->parent;
-    int mid = Constants::PAGESIZE / 2;
+    int mid = page_size / 2;
     vector<Point> vec(children->begin() + mid, children->end());
     right->add_points(vec);
 
@@ -54,12 +186,33 @@ LeafNode *LeafNode::split()
     return right;
 }
 
-LeafNode LeafNode::split1()
+LeafNode LeafNode::split1(int page_size)
 {
-    // build rightNode
-    LeafNode right;
+    int mid = page_size / 2;
+    if (compressed != NULL)
+    {
+        vector<Point> points;
+        compressed->get_points(points);
+        LeafNode right(compressed->arena, page_size, true);
+        right.parent = this->parent;
+        right.add_points(points.data() + mid, points.data() + points.size());
+        compressed->encode(points.data(), mid, mbr);
+        return right;
+    }
+    if (pool != NULL)
+    {
+        vector<Point> points;
+        get_points(points);
+        LeafNode right(pool, pool->allocate_page());
+        right.parent = this->parent;
+        right.add_points(points.data() + mid, points.data() + points.size());
+        pool->fetch(page_id, NULL, true)->size = mid;
+        return right;
+    }
+    // build rightNode from the same arena or account as this page
+    memory_accounting::Arena *arena = children->get_allocator().arena;
+    LeafNode right = arena != NULL ? LeafNode(arena, page_size) : LeafNode(children->get_allocator().account);
     right.parent = this->parent;
-    int mid = Constants::PAGESIZE / 2;
     vector<Point> vec(children->begin() + mid, children->end());
     right.add_points(vec);
 
@@ -72,7 +225,25 @@ LeafNode LeafNode::split1()
 
 bool LeafNode::delete_point(Point point)
 {
-    vector<Point>::iterator iter = find(children->begin(), children->end(), point);
+    if (compressed != NULL)
+    {
+        return compressed->remove(point);
+    }
+    if (pool != NULL)
+    {
+        buffer_pool::BufferPool::Handle page = pool->fetch(page_id, NULL, true);
+        for (int i = 0; i < page->size; i++)
+        {
+            if (page->get_point(i).x == point.x && page->get_point(i).y == point.y)
+            {
+                page->size--;
+                memmove(page->coordinates() + 2 * i, page->coordinates() + 2 * (i + 1), (page->size - i) * 2 * sizeof(float));
+                return true;
+            }
+        }
+        return false;
+    }
+    PointPage::iterator iter = find(children->begin(), children->end(), point);
     if (iter != children->end())
     {
         // cout << "find it" << endl;
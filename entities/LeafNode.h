@@ -6,22 +6,88 @@
 #include "Point.h"
 #include "Mbr.h"
 #include "NonLeafNode.h"
+#include "CompressedPage.h"
+#include "../utils/Constants.h"
+#include "../utils/MemoryAccounting.h"
+#include "../utils/BufferPool.h"
 using namespace std;
 
+// points of a leaf page, charged to the leaf points of an index's memory account
+typedef vector<Point, memory_accounting::Allocator<Point, memory_accounting::LEAF_POINTS>> PointPage;
+
 class LeafNode : public nodespace::Node
 {
 public:
     int level;
-    vector<Point> *children;
+    // the points, unless the page is compressed or on disk; then children is NULL
+    PointPage *children;
+    CompressedPage *compressed = NULL;
+    // a disk-resident page: page page_id of pool's file
+    buffer_pool::BufferPool *pool = NULL;
+    long long page_id = -1;
     NonLeafNode *parent;
     LeafNode();
     LeafNode(Mbr mbr);
-    void add_point(Point);
-    void add_points(vector<Point>);
+    // the page and its points are charged to account
+    LeafNode(memory_accounting::Account *account);
+    // the page and room for capacity points are allocated from arena and freed with it;
+    // copies of the LeafNode share the page
+    LeafNode(memory_accounting::Arena *arena, int capacity, bool is_compressed = false);
+    // the page is page_id of pool's file; the caller sets the MBR of points already written to it
+    LeafNode(buffer_pool::BufferPool *pool, long long page_id);
+    // false, with the page and MBR unchanged, when a compressed or disk page has no room for
+    // the points; Point pages always grow
+    bool add_point(Point);
+    bool add_points(vector<Point>);
+    bool add_points(Point *begin, Point *end);
     bool delete_point(Point);
-    bool is_full();
-    LeafNode *split();
-    LeafNode split1();
+    bool is_full(int page_size = Constants::PAGESIZE);
+    LeafNode *split(int page_size = Constants::PAGESIZE);
+    LeafNode split1(int page_size = Constants::PAGESIZE);
+
+    // the accessors below work on any page format; reads of a disk-resident page are counted
+    // in io_stats when given
+    int size();
+    // whether a point has point's coordinates
+    bool has_point(Point point, buffer_pool::IoStats *io_stats = NULL);
+    void get_points(vector<Point> &points);
+
+    // calls f(point) for every point window contains
+    template <class F>
+    void scan(const Mbr &window, F f, buffer_pool::IoStats *io_stats = NULL)
+    {
+        if (compressed != NULL)
+        {
+            compressed->scan(window, f);
+            return;
+        }
+        if (pool != NULL)
+        {
+            buffer_pool::BufferPool::Handle page = pool->fetch(page_id, io_stats);
+            scan_page(page.get(), window, f);
+            return;
+        }
+        for (Point point : *children)
+        {
+            if (window.x1 <= point.x && point.x <= window.x2 && window.y1 <= point.y && point.y <= window.y2)
+            {
+                f(point);
+            }
+        }
+    }
+    // scan of a disk page the caller fetched, e.g. through BufferPool::fetch_batch
+    template <class F>
+    static void scan_page(buffer_pool::DiskPage *page, const Mbr &window, F f)
+    {
+        for (int i = 0; i < page->size; i++)
+        {
+            Point point = page->get_point(i);
+            if (window.x1 <= point.x && point.x <= window.x2 && window.y1 <= point.y && point.y <= window.y2)
+            {
+                f(point);
+            }
+        }
+    }
 };
 
 #endif
\ No newline at end of file
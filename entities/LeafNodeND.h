@@ -0,0 +1,27 @@
+#ifndef LEAFNODEND_H
+#define LEAFNODEND_H
+
+#include <vector>
+#include "PointND.h"
+#include "MbrND.h"
+using namespace std;
+
+// D-dimensional leaf page of RSMIND. Points are held by value, unlike LeafNode.
+template <int D>
+class LeafNodeND
+{
+public:
+    MbrND<D> mbr;
+    vector<PointND<D>> children;
+
+    void add_points(const PointND<D> *begin, const PointND<D> *end)
+    {
+        children.insert(children.end(), begin, end);
+        for (const PointND<D> *point = begin; point != end; point++)
+        {
+            mbr.update(*point);
+        }
+    }
+};
+
+#endif
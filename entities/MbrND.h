@@ -0,0 +1,127 @@
+#ifndef MBRND_H
+#define MBRND_H
+#include <limits>
+#include <vector>
+#include <random>
+#include <math.h>
+#include "PointND.h"
+using namespace std;
+
+// D-dimensional counterpart of Mbr: low[d] and high[d] bound dimension d.
+template <int D>
+class MbrND
+{
+public:
+    float low[D];
+    float high[D];
+
+    MbrND()
+    {
+        clean();
+    }
+
+    void clean()
+    {
+        for (int d = 0; d < D; d++)
+        {
+            low[d] = numeric_limits<float>::max();
+            high[d] = numeric_limits<float>::lowest();
+        }
+    }
+
+    void update(const PointND<D> &point)
+    {
+        for (int d = 0; d < D; d++)
+        {
+            low[d] = point.coords[d] < low[d] ? point.coords[d] : low[d];
+            high[d] = point.coords[d] > high[d] ? point.coords[d] : high[d];
+        }
+    }
+
+    bool contains(const PointND<D> &point) const
+    {
+        for (int d = 0; d < D; d++)
+        {
+            if (point.coords[d] < low[d] || point.coords[d] > high[d])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool interact(const MbrND &mbr) const
+    {
+        for (int d = 0; d < D; d++)
+        {
+            if (high[d] < mbr.low[d] || mbr.high[d] < low[d])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    float cal_dist(const PointND<D> &point) const
+    {
+        float sum = 0;
+        for (int d = 0; d < D; d++)
+        {
+            float diff = 0;
+            if (point.coords[d] < low[d])
+            {
+                diff = low[d] - point.coords[d];
+            }
+            else if (point.coords[d] > high[d])
+            {
+                diff = point.coords[d] - high[d];
+            }
+            sum += diff * diff;
+        }
+        return sqrt(sum);
+    }
+
+    // the 2^D vertices; bit d of the vertex number picks low[d] or high[d]
+    vector<PointND<D>> get_corner_points() const
+    {
+        vector<PointND<D>> result(1 << D);
+        for (int corner = 0; corner < (1 << D); corner++)
+        {
+            for (int d = 0; d < D; d++)
+            {
+                result[corner].coords[d] = (corner >> d) & 1 ? high[d] : low[d];
+            }
+        }
+        return result;
+    }
+
+    // cube of half side knnquery_side around point, clipped to the unit space
+    static MbrND get_mbr(const PointND<D> &point, float knnquery_side)
+    {
+        MbrND mbr;
+        for (int d = 0; d < D; d++)
+        {
+            float low = point.coords[d] - knnquery_side;
+            float high = point.coords[d] + knnquery_side;
+            mbr.low[d] = low < 0 ? 0 : low;
+            mbr.high[d] = high > 1 ? 1 : high;
+        }
+        return mbr;
+    }
+
+    // num windows of the given volume centred on random dataset points
+    static vector<MbrND> get_mbrs(const vector<PointND<D>> &dataset, float volume, int num)
+    {
+        mt19937 gen(7);
+        uniform_int_distribution<long long> dist(0, dataset.size() - 1);
+        float half_side = pow(volume, 1.0 / D) / 2;
+        vector<MbrND> mbrs;
+        for (int i = 0; i < num; i++)
+        {
+            mbrs.push_back(get_mbr(dataset[dist(gen)], half_side));
+        }
+        return mbrs;
+    }
+};
+
+#endif
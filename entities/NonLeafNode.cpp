@@ -51,12 +51,12 @@ bool NonLeafNode::is_full()
     return children->size() >= Constants::PAGESIZE;
 }
 
-NonLeafNode *NonLeafNode::split()
+NonLeafNode *NonLeafNode::split(int page_size)
 {
     // build rightNode
     NonLeafNode *right = new NonLeafNode();
     right->parent = this->parent;
-    int mid = Constants::PAGESIZE / 2;
+    int mid = page_size / 2;
     auto bn = children->begin() + mid;
     auto en = children->end();
     vector<Node *> vec(bn, en);
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include "Node.h"
+#include "../utils/Constants.h"
 
 class NonLeafNode : public nodespace::Node
 {
@@ -15,7 +16,7 @@ public:
     void addNode(Node*);
     void addNodes(vector<Node*>);
     bool is_full();
-    NonLeafNode* split();
+    NonLeafNode* split(int page_size = Constants::PAGESIZE);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,69 @@
+#ifndef POINTND_H
+#define POINTND_H
+#include <vector>
+#include <random>
+#include <math.h>
+using namespace std;
+
+// D-dimensional counterpart of Point, used by RSMIND. Coordinates are expected in [0, 1].
+template <int D>
+class PointND
+{
+public:
+    float index = 0;
+    float coords[D];
+    long long curve_val = 0;
+
+    PointND()
+    {
+        for (int d = 0; d < D; d++)
+        {
+            coords[d] = 0;
+        }
+    }
+
+    PointND(const float *values)
+    {
+        for (int d = 0; d < D; d++)
+        {
+            coords[d] = values[d];
+        }
+    }
+
+    bool operator==(const PointND &point) const
+    {
+        for (int d = 0; d < D; d++)
+        {
+            if (coords[d] != point.coords[d])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    float cal_dist(const PointND &point) const
+    {
+        float sum = 0;
+        for (int d = 0; d < D; d++)
+        {
+            float diff = coords[d] - point.coords[d];
+            sum += diff * diff;
+        }
+        return sqrt(sum);
+    }
+
+    static vector<PointND> get_points(const vector<PointND> &dataset, int num)
+    {
+        mt19937 gen(42);
+        uniform_int_distribution<long long> dist(0, dataset.size() - 1);
+        vector<PointND> points;
+        for (int i = 0; i < num; i++)
+        {
+            points.push_back(dataset[dist(gen)]);
+        }
+        return points;
+    }
+};
+
+#endif
@@ -9,11 +9,25 @@
 #include "../utils/ExpRecorder.h"
 #include "../utils/SortTools.h"
 #include "../utils/ModelTools.h"
+#include "../utils/ModelStore.h"
+#include "../utils/BuildScheduler.h"
+#include "../utils/RadixSort.h"
+#include "../utils/CurveSelector.h"
+#include "../utils/QueryLog.h"
+#include "../utils/IndexStats.h"
+#include "../utils/RSMIConfig.h"
+#include "../utils/MemoryAccounting.h"
+#include "../utils/HugePages.h"
+#include "../utils/BufferPool.h"
 #include "../curves/hilbert.H"
 #include "../curves/hilbert4.H"
 #include "../curves/z.H"
 #include <map>
+#include <random>
+#include <chrono>
+#include <cmath>
 #include <boost/smart_ptr/make_shared_object.hpp>
+#ifdef use_torch
 #include <torch/script.h>
 #include <ATen/ATen.h>
 #include <torch/torch.h>
@@ -25,6 +39,7 @@
 using namespace at;
 using namespace torch::nn;
 using namespace torch::optim;
+#endif
 using namespace std;
 
 class RSMI
@@ -33,7 +48,7 @@ class RSMI
 private:
     int level;
     int index;
-    int max_partition_num;
+    RSMIConfig config;
     long long N = 0;
     int max_error = 0;
     int min_error = 0;
@@ -41,23 +56,87 @@ private:
     int leaf_node_num;
     
     bool is_last;
+    // curve that orders the points of a last-level node or labels the cells of a non-leaf node
+    int curve = curve_selection::HILBERT;
     Mbr mbr;
     std::shared_ptr<Net> net;
+    // build decision and the statistics behind it, see RSMIConfig::adaptive
+    int decision = index_stats::FIXED;
+    double skew = 0;
+    double trial_error = -1;
+    // points of a last-level node in the buffer given to build, valid until its model is trained
+    Point *build_points = NULL;
+    // shared by all nodes of the tree
+    std::shared_ptr<memory_accounting::Account> account = std::make_shared<memory_accounting::Account>();
+    // huge pages of the tree's arenas, NULL unless config.huge_pages is set
+    std::shared_ptr<huge_pages::PageSource> page_source;
+    // pages of the tree's leaves when they are on disk, NULL unless config.page_file is set
+    std::shared_ptr<buffer_pool::BufferPool> pool;
+    // owns the node's pages, its model weights and the map nodes of its children; released in
+    // bulk when the node is rebuilt or destroyed
+    std::shared_ptr<memory_accounting::Arena> arena = std::make_shared<memory_accounting::Arena>(account.get());
+
+    void build(ExpRecorder &exp_recorder, Point *points, long long length, BuildScheduler &scheduler);
+    void build_last(ExpRecorder &exp_recorder, Point *points, long long length, BuildScheduler &scheduler, bool is_ordered);
+    void train_leaf_model(ExpRecorder &exp_recorder, BuildScheduler &scheduler);
+    void order_by_curve(Point *points, long long length, long long side);
+    static double estimate_skew(Point *points, long long length);
+    double trial_fit(Point *points, long long length);
+    int get_bit_num(long long length);
+    void init_page_source();
+    void init_buffer_pool();
+    // the pages of a last-level node that are in window, for prefetching, empty in memory
+    vector<long long> get_page_ids(int front, int back, Mbr window);
+    // whether queries read their pages in batches, see RSMIConfig::read_mode
+    bool is_batched();
+    // reads the pages of leafnodes[front..back] in window as one batch and calls f(leafnode,
+    // page) as each page arrives
+    template <class F>
+    void fetch_leaves(ExpRecorder &exp_recorder, int front, int back, Mbr window, F f);
+    // the last-level node query_point is routed to, NULL if it is routed to no child
+    RSMI *route(Point query_point);
+    void collect_stats(vector<index_stats::NodeStats> &nodes, vector<int> &page_sizes, int parent, double sibling_overlap);
 
 public:
-    string model_path;
     static string model_path_root;
-    map<int, RSMI> children;
-    vector<LeafNode> leafnodes;
+    // trainings of a non-leaf model before a node whose points all fall into one child is made
+    // a last-level node
+    static const int MAX_RETRAIN_NUM = 10;
+    // set on the root to append every point, window and kNN query it serves to a query log
+    query_log::QueryLogWriter *query_log = NULL;
+    typedef map<int, RSMI, less<int>, memory_accounting::Allocator<pair<const int, RSMI>, memory_accounting::DIRECTORY>> ChildMap;
+    ChildMap children = ChildMap(ChildMap::allocator_type(arena.get()));
+    vector<LeafNode, memory_accounting::Allocator<LeafNode, memory_accounting::DIRECTORY>> leafnodes = vector<LeafNode, memory_accounting::Allocator<LeafNode, memory_accounting::DIRECTORY>>(arena.get());
 
     RSMI();
     RSMI(int index, int max_partition_num);
-    RSMI(int index, int level, int max_partition_num);
+    RSMI(int index, RSMIConfig config);
+    RSMI(int index, int level, RSMIConfig config);
+    // a child node charging the tree's account, allocating from its page source and keeping
+    // its pages in its buffer pool
+    RSMI(int index, int level, RSMIConfig config, std::shared_ptr<memory_accounting::Account> account, std::shared_ptr<huge_pages::PageSource> page_source, std::shared_ptr<buffer_pool::BufferPool> pool);
     void build(ExpRecorder &exp_recorder, vector<Point> points);
     void print_index_info(ExpRecorder &exp_recorder);
+    // writes one record per node and the error span and page occupancy histograms, format "json" or "csv"
+    void dump_stats(string filename, string format);
+    // bytes held by the tree by component, with their peaks since the tree was created
+    memory_accounting::Usage get_memory_usage();
+    // NULL unless config.huge_pages is set
+    huge_pages::PageSource *get_page_source();
+    // NULL unless config.page_file is set
+    buffer_pool::BufferPool *get_buffer_pool();
+    // searches options' page sizes, thresholds and max widths on samples of points, query_points
+    // and query_windows (point queries use sampled points when query_points is empty); the
+    // other parameters come from base
+    static RSMIConfig tune(vector<Point> &points, vector<Point> &query_points, vector<Mbr> &query_windows, RSMIConfig base, RSMITuneOptions options);
 
     bool point_query(ExpRecorder &exp_recorder, Point query_point);
     void point_query(ExpRecorder &exp_recorder, vector<Point> query_points);
+    // answers query_points batch_size at a time and returns how many are found: every query of
+    // a batch is routed to its last-level node first, then the pages all of them may be on are
+    // read as one batch, shared by the queries waiting for them. Pages on disk are read once
+    // per batch with a batch read_mode; otherwise the queries run one after another.
+    long long point_query(ExpRecorder &exp_recorder, vector<Point> &query_points, int batch_size);
 
     void window_query(ExpRecorder &exp_recorder, vector<Mbr> query_windows);
     // vector<Point> window_query(ExpRecorder &exp_recorder, Mbr query_window);
@@ -88,159 +167,465 @@ RSMI::RSMI()
 RSMI::RSMI(int index, int max_partition_num)
 {
     this->index = index;
-    this->max_partition_num = max_partition_num;
+    this->config.max_width = max_partition_num;
     this->level = 0;
 }
 
-RSMI::RSMI(int index, int level, int max_partition_num)
+RSMI::RSMI(int index, RSMIConfig config)
+{
+    this->index = index;
+    this->config = config;
+    this->level = 0;
+    init_page_source();
+    init_buffer_pool();
+}
+
+RSMI::RSMI(int index, int level, RSMIConfig config)
 {
     this->index = index;
     this->level = level;
-    this->max_partition_num = max_partition_num;
+    this->config = config;
+    init_page_source();
+    init_buffer_pool();
+}
+
+RSMI::RSMI(int index, int level, RSMIConfig config, std::shared_ptr<memory_accounting::Account> account, std::shared_ptr<huge_pages::PageSource> page_source, std::shared_ptr<buffer_pool::BufferPool> pool) : account(account), page_source(page_source), pool(pool)
+{
+    this->index = index;
+    this->level = level;
+    this->config = config;
+    arena->set_source(page_source.get());
+}
+
+void RSMI::init_page_source()
+{
+    if (config.huge_pages != huge_pages::OFF)
+    {
+        page_source = std::make_shared<huge_pages::PageSource>((huge_pages::Mode)config.huge_pages);
+        arena->set_source(page_source.get());
+    }
+}
+
+void RSMI::init_buffer_pool()
+{
+    if (!config.page_file.empty())
+    {
+        pool = std::make_shared<buffer_pool::BufferPool>(config.page_file, config.page_size, config.buffer_pool_pages, (buffer_pool::Policy)config.buffer_pool_policy, account.get(), (buffer_pool::ReadMode)config.read_mode);
+    }
 }
 
 void RSMI::build(ExpRecorder &exp_recorder, vector<Point> points)
 {
+    BuildScheduler scheduler;
+    build(exp_recorder, points.data(), points.size(), scheduler);
+    scheduler.run();
+    exp_recorder.leaf_training_time += scheduler.time;
+    exp_recorder.trained_leaf_model_num += scheduler.size();
+}
 
-    int page_size = Constants::PAGESIZE;
-    auto start = chrono::high_resolution_clock::now();
-    if (points.size() <= exp_recorder.N)
+void RSMI::train_leaf_model(ExpRecorder &exp_recorder, BuildScheduler &scheduler)
+{
+    auto setup_start = chrono::high_resolution_clock::now();
+    TrainingStage &stage = training_stage();
+    stage.resize(N, 2);
+    // the pages hold build_points in order, but compressed pages do not keep their labels
+    for (long long point_index = 0; point_index < N; point_index++)
     {
-        this->model_path += "_" + to_string(level) + "_" + to_string(index);
-        if (exp_recorder.depth < level)
+        Point &point = build_points[point_index];
+        stage.locations[point_index * 2] = point.x;
+        stage.locations[point_index * 2 + 1] = point.y;
+        stage.labels[point_index] = point.index;
+    }
+    long long setup_time = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - setup_start).count();
+
+    ModelStore model_store(model_path_root);
+    uint64_t model_key = ModelStore::key(stage.locations.data(), stage.labels.data(), N, *net, level, 0);
+    bool is_cached = model_store.load(*net, model_key);
+    if (!is_cached)
+    {
+        net->train_model(stage.locations.data(), stage.labels.data(), N);
+        model_store.save(*net, model_key);
+    }
+    setup_start = chrono::high_resolution_clock::now();
+    net->get_parameters();
+    setup_time += chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - setup_start).count();
+
+    for (long long point_index = 0; point_index < N; point_index++)
+    {
+        Point &point = build_points[point_index];
+        int predicted_index = (int)(net->predict(point) * leaf_node_num);
+        predicted_index = predicted_index < 0 ? 0 : predicted_index;
+        predicted_index = predicted_index >= leaf_node_num ? leaf_node_num - 1 : predicted_index;
+
+        // page of the point
+        int error = point_index / config.page_size - predicted_index;
+
+        if (error > 0)
         {
-            exp_recorder.depth = level;
-        }
-        exp_recorder.last_level_model_num++;
-        is_last = true;
-        N = points.size();
-        long long side = pow(2, ceil(log(points.size()) / log(2)));
-        sort(points.begin(), points.end(), sortX());
-        for (int i = 0; i < N; i++)
-        {
-            points[i].x_i = i;
-            mbr.update(points[i].x, points[i].y);
+            if (error > max_error)
+            {
+                max_error = error;
+            }
         }
-        sort(points.begin(), points.end(), sortY());
-        for (int i = 0; i < N; i++)
+        else
         {
-            points[i].y_i = i;
-            long long curve_val = compute_Hilbert_value(points[i].x_i, points[i].y_i, side);
-            points[i].curve_val = curve_val;
+            if (error < min_error)
+            {
+                min_error = error;
+            }
         }
-        sort(points.begin(), points.end(), sort_curve_val());
-        width = N - 1;
-        if (N == 1)
+    }
+    build_points = NULL;
+
+    lock_guard<mutex> guard(scheduler.lock());
+    exp_recorder.leaf_setup_time += setup_time + net->setup_time;
+    if (is_cached)
+    {
+        exp_recorder.cached_model_num++;
+    }
+    exp_recorder.total_max_error += max_error;
+    exp_recorder.total_min_error += min_error;
+    if ((max_error - min_error) > (exp_recorder.max_error - exp_recorder.min_error))
+    {
+        exp_recorder.max_error = max_error;
+        exp_recorder.min_error = min_error;
+    }
+}
+
+// Maps points to rank space (x_i, y_i) and orders them along the Hilbert or the Z curve of their
+// ranks, whichever curve_selection prefers for this node from a sample. The orderings are radix
+// sorts over (key, index) pairs; the points themselves are permuted only once, at the end.
+void RSMI::order_by_curve(Point *points, long long length, long long side)
+{
+    int thread_num = thread_utils::default_thread_num();
+    vector<radix_sort::KeyIndex<uint32_t>> coordinates(length);
+    vector<long long> x_ranks(length), y_ranks(length);
+
+    for (long long i = 0; i < length; i++)
+    {
+        coordinates[i].key = radix_sort::float_key(points[i].x);
+        coordinates[i].index = i;
+        mbr.update(points[i].x, points[i].y);
+    }
+    radix_sort::sort(coordinates, thread_num);
+    for (long long i = 0; i < length; i++)
+    {
+        x_ranks[coordinates[i].index] = i;
+    }
+
+    for (long long i = 0; i < length; i++)
+    {
+        coordinates[i].key = radix_sort::float_key(points[i].y);
+        coordinates[i].index = i;
+    }
+    radix_sort::sort(coordinates, thread_num);
+    for (long long i = 0; i < length; i++)
+    {
+        y_ranks[coordinates[i].index] = i;
+    }
+
+    // trial fit of the position along each curve on a sample, in pages: the sample is ordered
+    // by its curve values and a sampled point's rank in the sample stands in for its position
+    long long stride = length > curve_selection::SAMPLE_SIZE ? length / curve_selection::SAMPLE_SIZE : 1;
+    vector<long long> sample_x_ranks, sample_y_ranks;
+    for (long long i = 0; i < length; i += stride)
+    {
+        sample_x_ranks.push_back(x_ranks[i]);
+        sample_y_ranks.push_back(y_ranks[i]);
+    }
+    long long sample_num = sample_x_ranks.size();
+    vector<long long> sample_values(sample_num);
+    vector<pair<long long, long long>> sample_order(sample_num);
+    vector<float> sample_locations(sample_num * 2), sample_labels(sample_num);
+    double fit_errors[curve_selection::CURVE_NUM];
+    int page_num = (length + config.page_size - 1) / config.page_size;
+    for (int c = 0; c < curve_selection::CURVE_NUM; c++)
+    {
+        if (c == curve_selection::Z)
         {
-            points[0].index = 0;
+            compute_Z_values(sample_x_ranks.data(), sample_y_ranks.data(), sample_values.data(), sample_num);
         }
         else
         {
-            for (long i = 0; i < N; i++)
+            compute_Hilbert_values(sample_x_ranks.data(), sample_y_ranks.data(), sample_values.data(), sample_num, side);
+        }
+        for (long long j = 0; j < sample_num; j++)
+        {
+            sample_order[j] = {sample_values[j], j * stride};
+        }
+        sort(sample_order.begin(), sample_order.end());
+        for (long long j = 0; j < sample_num; j++)
+        {
+            sample_locations[j * 2] = points[sample_order[j].second].x;
+            sample_locations[j * 2 + 1] = points[sample_order[j].second].y;
+            sample_labels[j] = sample_num > 1 ? j * 1.0 / (sample_num - 1) : 0;
+        }
+        fit_errors[c] = curve_selection::fit_error(sample_locations.data(), sample_labels.data(), sample_num, page_num);
+    }
+    curve = curve_selection::select(fit_errors, config.page_size);
+
+    // only the chosen curve is encoded, in one batch (table-driven Hilbert, BMI2 Z), and sorted
+    vector<long long> curve_values(length);
+    if (curve == curve_selection::Z)
+    {
+        compute_Z_values(x_ranks.data(), y_ranks.data(), curve_values.data(), length);
+    }
+    else
+    {
+        compute_Hilbert_values(x_ranks.data(), y_ranks.data(), curve_values.data(), length, side);
+    }
+    vector<radix_sort::KeyIndex<uint64_t>> curve_vals(length);
+    for (long long i = 0; i < length; i++)
+    {
+        curve_vals[i].key = curve_values[i];
+        curve_vals[i].index = i;
+    }
+    radix_sort::sort(curve_vals, thread_num);
+    vector<Point> ordered(length);
+    for (long long i = 0; i < length; i++)
+    {
+        long long source = curve_vals[i].index;
+        ordered[i] = points[source];
+        ordered[i].x_i = x_ranks[source];
+        ordered[i].y_i = y_ranks[source];
+        ordered[i].curve_val = curve_values[source];
+    }
+    copy(ordered.begin(), ordered.end(), points);
+}
+
+// coefficient of variation of the counts of a sample of the points over an 8x8 grid of the
+// sample's bounding box: about 0.25 for uniform points, well above 1 for clustered ones
+double RSMI::estimate_skew(Point *points, long long length)
+{
+    const int grid = 8;
+    long long stride = length > curve_selection::SAMPLE_SIZE ? length / curve_selection::SAMPLE_SIZE : 1;
+    Mbr box;
+    for (long long i = 0; i < length; i += stride)
+    {
+        box.update(points[i].x, points[i].y);
+    }
+    float x_side = box.x2 > box.x1 ? box.x2 - box.x1 : 1;
+    float y_side = box.y2 > box.y1 ? box.y2 - box.y1 : 1;
+    vector<int> counts(grid * grid, 0);
+    long long sample_num = 0;
+    for (long long i = 0; i < length; i += stride)
+    {
+        int x = min(grid - 1, (int)((points[i].x - box.x1) / x_side * grid));
+        int y = min(grid - 1, (int)((points[i].y - box.y1) / y_side * grid));
+        counts[x * grid + y]++;
+        sample_num++;
+    }
+    double mean = sample_num * 1.0 / counts.size();
+    double variance = 0;
+    for (int count : counts)
+    {
+        variance += (count - mean) * (count - mean);
+    }
+    return sqrt(variance / counts.size()) / mean;
+}
+
+// mean absolute error in pages of a model trained for trial_epoch epochs on a sample of the
+// points, which must already be in curve order
+double RSMI::trial_fit(Point *points, long long length)
+{
+    long long page_num = (length + config.page_size - 1) / config.page_size;
+    long long stride = length > curve_selection::SAMPLE_SIZE ? length / curve_selection::SAMPLE_SIZE : 1;
+    vector<float> sample_locations, sample_labels;
+    vector<long long> sample_pages;
+    for (long long i = 0; i < length; i += stride)
+    {
+        sample_locations.push_back(points[i].x);
+        sample_locations.push_back(points[i].y);
+        sample_labels.push_back(length > 1 ? i * 1.0 / (length - 1) : 0);
+        sample_pages.push_back(i / config.page_size);
+    }
+    Net trial(2, page_num / 2 + 2, config.hidden_layer_width);
+    trial.epoch = config.trial_epoch;
+    trial.learning_rate = config.learning_rate;
+    trial.train_model(sample_locations.data(), sample_labels.data(), sample_labels.size());
+    trial.get_parameters();
+    double error = 0;
+    for (size_t i = 0; i < sample_pages.size(); i++)
+    {
+        long long predicted_page = (long long)(trial.predict(Point(sample_locations[i * 2], sample_locations[i * 2 + 1])) * page_num);
+        predicted_page = predicted_page < 0 ? 0 : (predicted_page >= page_num ? page_num - 1 : predicted_page);
+        error += llabs(sample_pages[i] - predicted_page);
+    }
+    return error / sample_pages.size();
+}
+
+// cells per side of a non-leaf node: max_width, or when adaptive the power of two that gives
+// about one cell per threshold points (threshold / leaf_band in hot spots). At least 4 per side:
+// the model of a 2x2 grid often predicts one cell for every point and is retrained forever.
+int RSMI::get_bit_num(long long length)
+{
+    if (!config.adaptive)
+    {
+        return config.max_width;
+    }
+    double child_size = skew > config.hot_skew ? config.threshold / config.leaf_band : config.threshold;
+    double cells_per_side = sqrt(length / child_size);
+    int bit_num = min(4, config.max_width);
+    while (bit_num < cells_per_side && bit_num * 2 <= config.max_width)
+    {
+        bit_num *= 2;
+    }
+    return bit_num;
+}
+
+// makes this node a last-level node over points, ordered along its curve unless is_ordered
+void RSMI::build_last(ExpRecorder &exp_recorder, Point *points, long long length, BuildScheduler &scheduler, bool is_ordered)
+{
+    int page_size = config.page_size;
+    if (exp_recorder.depth < level)
+    {
+        exp_recorder.depth = level;
+    }
+    exp_recorder.last_level_model_num++;
+    is_last = true;
+    N = length;
+    long long page_num = (length + page_size - 1) / page_size;
+    // one block for the page headers and all pages
+    if (pool != NULL)
+    {
+        arena->reserve(page_num * sizeof(LeafNode), memory_accounting::LEAF_POINTS);
+    }
+    else if (config.compressed_pages)
+    {
+        arena->reserve(page_num * (sizeof(LeafNode) + CompressedPage::get_size(page_size)) + 16, memory_accounting::LEAF_POINTS);
+    }
+    else
+    {
+        arena->reserve(page_num * (sizeof(LeafNode) + sizeof(PointPage) + page_size * sizeof(Point) + alignof(PointPage)), memory_accounting::LEAF_POINTS);
+    }
+    leafnodes.reserve(page_num);
+    if (!is_ordered)
+    {
+        long long side = pow(2, ceil(log(length) / log(2)));
+        order_by_curve(points, length, side);
+    }
+    if (curve == curve_selection::Z)
+    {
+        exp_recorder.z_node_num++;
+    }
+    else
+    {
+        exp_recorder.hilbert_node_num++;
+    }
+    width = N - 1;
+    if (N == 1)
+    {
+        points[0].index = 0;
+    }
+    else
+    {
+        for (long i = 0; i < N; i++)
+        {
+            points[i].index = i * 1.0 / (N - 1);
+        }
+    }
+    // points stays alive until the scheduler has trained every model
+    build_points = points;
+    leaf_node_num = length / page_size;
+    if (pool != NULL)
+    {
+        // the node's pages go to consecutive pages of the file in one write
+        long long first_page = pool->write_pages(points, length);
+        leaf_node_num = page_num;
+        for (int i = 0; i < leaf_node_num; i++)
+        {
+            LeafNode leafNode(pool.get(), first_page + i);
+            for (long long j = (long long)i * page_size; j < length && j < (long long)(i + 1) * page_size; j++)
             {
-                points[i].index = i * 1.0 / (N - 1);
+                leafNode.mbr.update(points[j].x, points[j].y);
             }
+            leafnodes.push_back(leafNode);
         }
-        leaf_node_num = points.size() / page_size;
+    }
+    else
+    {
         for (int i = 0; i < leaf_node_num; i++)
         {
-            LeafNode leafNode;
-            auto bn = points.begin() + i * page_size;
-            auto en = points.begin() + i * page_size + page_size;
-            vector<Point> vec(bn, en);
-            // cout << vec.size() << " " << vec[0]->x_i << " " << vec[99]->x_i << endl;
-            leafNode.add_points(vec);
+            LeafNode leafNode(arena.get(), page_size, config.compressed_pages);
+            leafNode.add_points(points + i * page_size, points + i * page_size + page_size);
             leafnodes.push_back(leafNode);
         }
 
         // for the last leafNode
-        if (points.size() > page_size * leaf_node_num)
+        if (length > page_size * leaf_node_num)
         {
             // TODO if do not delete will it last to the end of lifecycle?
-            LeafNode leafNode;
-            auto bn = points.begin() + page_size * leaf_node_num;
-            auto en = points.end();
-            vector<Point> vec(bn, en);
-            leafNode.add_points(vec);
+            LeafNode leafNode(arena.get(), page_size, config.compressed_pages);
+            leafNode.add_points(points + page_size * leaf_node_num, points + length);
             leafnodes.push_back(leafNode);
             leaf_node_num++;
         }
-        exp_recorder.leaf_node_num += leaf_node_num;
-        net = std::make_shared<Net>(2, leaf_node_num / 2 + 2);
-        #ifdef use_gpu
-            net->to(torch::kCUDA);
-        #endif
-        vector<float> locations;
-        vector<float> labels;
-        for (Point point : points)
-        {
-            locations.push_back(point.x);
-            locations.push_back(point.y);
-            labels.push_back(point.index);
-        }
-        
-        std::ifstream fin(this->model_path);
-        if (!fin)
+    }
+    exp_recorder.leaf_node_num += leaf_node_num;
+    net = std::allocate_shared<Net>(memory_accounting::Allocator<Net, memory_accounting::MODELS>(account.get()), 2, leaf_node_num / 2 + 2, config.hidden_layer_width, 0.1, arena.get());
+    net->set_account(account.get());
+    net->epoch = config.epoch;
+    net->learning_rate = config.learning_rate;
+    #ifdef use_gpu
+        net->to(torch::kCUDA);
+    #endif
+    exp_recorder.non_leaf_node_num++;
+    // last-level models are independent of each other and are trained together later
+    scheduler.add([this, &exp_recorder, &scheduler]() { train_leaf_model(exp_recorder, scheduler); });
+}
+
+void RSMI::build(ExpRecorder &exp_recorder, Point *points, long long length, BuildScheduler &scheduler)
+{
+    auto start = chrono::high_resolution_clock::now();
+    long long side = pow(2, ceil(log(length) / log(2)));
+    bool is_ordered = false;
+    bool is_leaf = length <= config.threshold;
+    if (config.adaptive)
+    {
+        skew = estimate_skew(points, length);
+        if (length <= config.threshold / config.leaf_band)
         {
-            net->train_model(locations, labels);
-            // torch::save(net, this->model_path);
+            decision = index_stats::SMALL;
+            is_leaf = true;
         }
-        else
+        else if (length > config.threshold * config.leaf_band)
         {
-            torch::load(net, this->model_path);
+            decision = index_stats::LARGE;
+            is_leaf = false;
         }
-        net->get_parameters();
-
-        exp_recorder.non_leaf_node_num++;
-        for (int i = 0; i < N; i++)
-        {
-            Point point = points[i];
-            int predicted_index = (int)(net->predict(point) * leaf_node_num);
-            predicted_index = predicted_index < 0 ? 0 : predicted_index;
-            predicted_index = predicted_index >= leaf_node_num ? leaf_node_num - 1 : predicted_index;
-
-            int error = i / page_size - predicted_index;
-
-            if (error > 0)
-            {
-                if (error > max_error)
-                {
-                    max_error = error;
-                }
-            }
-            else
-            {
-                if (error < min_error)
-                {
-                    min_error = error;
-                }
-            }
-        }
-        exp_recorder.average_max_error += max_error;
-        exp_recorder.average_min_error += min_error;
-        if ((max_error - min_error) > (exp_recorder.max_error - exp_recorder.min_error))
+        else
         {
-            exp_recorder.max_error = max_error;
-            exp_recorder.min_error = min_error;
+            order_by_curve(points, length, side);
+            is_ordered = true;
+            trial_error = trial_fit(points, length);
+            is_leaf = trial_error <= config.max_trial_error;
+            decision = is_leaf ? index_stats::FIT : index_stats::MISFIT;
         }
-
+    }
+    if (is_leaf)
+    {
+        build_last(exp_recorder, points, length, scheduler, is_ordered);
     }
     else
     {
         is_last = false;
-        N = (long long)points.size();
-        int bit_num = max_partition_num;
-        int partition_size = ceil(points.size() * 1.0 / pow(bit_num, 2));
-        sort(points.begin(), points.end(), sortX());
+        N = length;
+        int bit_num = get_bit_num(length);
+        int partition_size = ceil(length * 1.0 / pow(bit_num, 2));
+        sort(points, points + length, sortX());
         long long side = pow(bit_num, 2);
         width = side - 1;
-        map<int, vector<Point>> points_map;
         int each_item_size = partition_size * bit_num;
         long long point_index = 0;
 
-        vector<float> locations(N * 2);
-        vector<float> labels(N);
+        TrainingStage &stage = training_stage();
+        stage.resize(N, 2);
+        memory_accounting::Buffer<float> &locations = stage.locations;
+        memory_accounting::Buffer<float> &labels = stage.labels;
 
+        // cut the x-sorted points into bit_num strips and each strip, sorted by y in place,
+        // into bit_num cells; the cells are labelled along the curve chosen below
+        memory_accounting::Buffer<int> cells(length, 0, account.get());
         for (size_t i = 0; i < bit_num; i++)
         {
             long long bn_index = i * each_item_size;
@@ -256,129 +641,168 @@ void RSMI::build(ExpRecorder &exp_recorder, vector<Point> points)
                     end_index = N;
                 }
             }
-            auto bn = points.begin() + bn_index;
-            auto en = points.begin() + end_index;
-            vector<Point> vec(bn, en);
-            sort(vec.begin(), vec.end(), sortY());
+            Point *strip = points + bn_index;
+            long long strip_size = end_index - bn_index;
+            sort(strip, strip + strip_size, sortY());
             for (size_t j = 0; j < bit_num; j++)
             {
                 long long sub_bn_index = j * partition_size;
                 long long sub_end_index = sub_bn_index + partition_size;
-                if (sub_bn_index >= vec.size())
+                if (sub_bn_index >= strip_size)
                 {
                     break;
                 }
                 else
                 {
-                    if (sub_end_index > vec.size())
+                    if (sub_end_index > strip_size)
                     {
-                        sub_end_index = vec.size();
+                        sub_end_index = strip_size;
                     }
                 }
-                auto sub_bn = vec.begin() + sub_bn_index;
-                auto sub_en = vec.begin() + sub_end_index;
-                vector<Point> sub_vec(sub_bn, sub_en);
-                int Z_value = compute_Z_value(i, j, side);
-                int sub_point_index = 1;
-                long sub_size = sub_vec.size();
-                for (Point point : sub_vec)
+                for (long long k = sub_bn_index; k < sub_end_index; k++)
                 {
-                    point.index = Z_value * 1.0 / width;
+                    Point &point = strip[k];
                     locations[point_index * 2] = point.x;
                     locations[point_index * 2 + 1] = point.y;
-                    labels[point_index] = point.index;
+                    cells[point_index] = i * bit_num + j;
                     point_index++;
                     mbr.update(point.x, point.y);
-                    sub_point_index++;
                 }
-                vector<Point> temp;
-                points_map.insert(pair<int, vector<Point>>(Z_value, temp));
             }
         }
 
-        int epoch = Constants::START_EPOCH;
+        // label of every cell along each curve, trial-fitted on a sample in children
+        vector<float> cell_labels[curve_selection::CURVE_NUM];
+        double fit_errors[curve_selection::CURVE_NUM];
+        for (int c = 0; c < curve_selection::CURVE_NUM; c++)
+        {
+            cell_labels[c].resize(bit_num * bit_num);
+            for (int i = 0; i < bit_num; i++)
+            {
+                for (int j = 0; j < bit_num; j++)
+                {
+                    long long curve_value = c == curve_selection::Z ? compute_Z_value(i, j) : compute_Hilbert_value_lut(i, j, bit_num);
+                    cell_labels[c][i * bit_num + j] = curve_value * 1.0 / width;
+                }
+            }
+        }
+        long long stride = length > curve_selection::SAMPLE_SIZE ? length / curve_selection::SAMPLE_SIZE : 1;
+        vector<float> sample_locations, sample_labels;
+        for (int c = 0; c < curve_selection::CURVE_NUM; c++)
+        {
+            sample_locations.clear();
+            sample_labels.clear();
+            for (long long k = 0; k < length; k += stride)
+            {
+                sample_locations.push_back(locations[k * 2]);
+                sample_locations.push_back(locations[k * 2 + 1]);
+                sample_labels.push_back(cell_labels[c][cells[k]]);
+            }
+            fit_errors[c] = curve_selection::fit_error(sample_locations.data(), sample_labels.data(), sample_labels.size(), width);
+        }
+        curve = curve_selection::select(fit_errors, max(length / width, 1LL));
+        if (curve == curve_selection::Z)
+        {
+            exp_recorder.z_node_num++;
+        }
+        else
+        {
+            exp_recorder.hilbert_node_num++;
+        }
+        for (long long k = 0; k < length; k++)
+        {
+            labels[k] = cell_labels[curve][cells[k]];
+        }
+        cells.clear();
+        cells.shrink_to_fit();
+
+        // each retraining gets EPOCH_ADDED more epochs
+        int epoch = config.epoch;
         bool is_retrain = false;
+        ModelStore model_store(model_path_root);
+        int attempt = 0;
+        int thread_num = length < radix_sort::PARALLEL_THRESHOLD ? 1 : thread_utils::default_thread_num();
+        memory_accounting::Buffer<int> predicted_indexes(length, 0, account.get());
+        vector<long long> bucket_begin;
         do
         {
-            net = std::make_shared<Net>(2);
+            net = std::allocate_shared<Net>(memory_accounting::Allocator<Net, memory_accounting::MODELS>(account.get()), 2, config.hidden_layer_width, config.hidden_layer_width, 1, arena.get());
+            net->set_account(account.get());
+            net->epoch = epoch;
+            net->learning_rate = config.learning_rate;
             #ifdef use_gpu
                 net->to(torch::kCUDA);
             #endif
 
-            this->model_path += "_" + to_string(level) + "_" + to_string(index);
-            std::ifstream fin(this->model_path);
-                net->train_model(locations, labels);
-
-            // if (!fin)
-            // {
-            //     net->train_model(locations, labels);
-            //     // torch::save(net, this->model_path);
-            // }
-            // else
-            // {
-            //     torch::load(net, this->model_path);
-            // }
-            net->get_parameters();
-
-            for (Point point : points)
+            uint64_t model_key = ModelStore::key(locations.data(), labels.data(), N, *net, level, attempt);
+            if (model_store.load(*net, model_key))
             {
-                int predicted_index = (int)(net->predict(point) * width);
-
-                predicted_index = predicted_index < 0 ? 0 : predicted_index;
-                predicted_index = predicted_index >= width ? width - 1 : predicted_index;
-                points_map[predicted_index].push_back(point);
+                exp_recorder.cached_model_num++;
             }
-
-            map<int, vector<Point>>::iterator iter1;
-            iter1 = points_map.begin();
-            int map_size = 0;
-            while (iter1 != points_map.end())
+            else
             {
-                if (iter1->second.size() > 0)
+                net->train_model(locations.data(), labels.data(), N);
+                model_store.save(*net, model_key);
+            }
+            attempt++;
+            net->get_parameters();
+
+            thread_utils::parallel_for(0, length, thread_num, [&](int, long long bn, long long en) {
+                for (long long i = bn; i < en; i++)
                 {
-                    map_size++;
+                    int predicted_index = (int)(net->predict(points[i]) * width);
+                    predicted_index = predicted_index < 0 ? 0 : predicted_index;
+                    predicted_index = predicted_index >= width ? width - 1 : predicted_index;
+                    predicted_indexes[i] = predicted_index;
                 }
-                iter1++;
+            });
+
+            // retrain if every point falls into the same child
+            is_retrain = true;
+            for (long long i = 1; i < length && is_retrain; i++)
+            {
+                is_retrain = predicted_indexes[i] == predicted_indexes[0];
             }
-            if (map_size < 2)
+            if (is_retrain)
             {
-                int predicted_index = (int)(net->predict(points[0]) * width);
-                predicted_index = predicted_index < 0 ? 0 : predicted_index;
-                predicted_index = predicted_index >= width ? width - 1 : predicted_index;
+                epoch += Constants::EPOCH_ADDED;
+            }
+
+        } while (is_retrain && attempt < MAX_RETRAIN_NUM);
 
-                points_map[predicted_index].clear();
-                points_map[predicted_index].shrink_to_fit();
-                is_retrain = true;
-                epoch = Constants::EPOCH_ADDED;
+        if (is_retrain)
+        {
+            // the model cannot split these points (e.g. a tight cluster), keep them in one node
+            decision = index_stats::UNSPLIT;
+            if (curve == curve_selection::Z)
+            {
+                exp_recorder.z_node_num--;
             }
             else
             {
-                is_retrain = false;
+                exp_recorder.hilbert_node_num--;
             }
+            build_last(exp_recorder, points, length, scheduler, false);
+            return;
+        }
 
-        } while (is_retrain);
+        // counting sort by child: children are built over contiguous sub-ranges of points
+        radix_sort::partition(points, length, predicted_indexes.data(), width, bucket_begin, thread_num);
+        predicted_indexes.clear();
+        predicted_indexes.shrink_to_fit();
         auto finish = chrono::high_resolution_clock::now();
         
         exp_recorder.non_leaf_node_num++;
 
-        points.clear();
-        points.shrink_to_fit();
-
-        map<int, vector<Point>>::iterator iter;
-        iter = points_map.begin();
-
-        while (iter != points_map.end())
+        for (int i = 0; i < width; i++)
         {
-            if (iter->second.size() > 0)
+            long long child_length = bucket_begin[i + 1] - bucket_begin[i];
+            if (child_length > 0)
             {
-                RSMI partition(iter->first, level + 1, max_partition_num);
-                partition.model_path = model_path;
-                partition.build(exp_recorder, iter->second);
-                iter->second.clear();
-                iter->second.shrink_to_fit();
-                children.insert(pair<int, RSMI>(iter->first, partition));
+                // build the child in place: its training job keeps a pointer to it
+                RSMI &partition = children.emplace(piecewise_construct, forward_as_tuple(i), forward_as_tuple(i, level + 1, config, account, page_source, pool)).first->second;
+                partition.build(exp_recorder, points + bucket_begin[i], child_length, scheduler);
             }
-            iter++;
         }
     }
 }
@@ -387,37 +811,214 @@ void RSMI::print_index_info(ExpRecorder &exp_recorder)
 {
     cout << "finish point_query max_error: " << exp_recorder.max_error << endl;
     cout << "finish point_query min_error: " << exp_recorder.min_error << endl;
-    cout << "finish point_query average_max_error: " << exp_recorder.average_max_error << endl;
-    cout << "finish point_query average_min_error: " << exp_recorder.average_min_error << endl;
+    cout << "finish point_query average_max_error: " << exp_recorder.get_average_max_error() << endl;
+    cout << "finish point_query average_min_error: " << exp_recorder.get_average_min_error() << endl;
     cout << "last_level_model_num: " << exp_recorder.last_level_model_num << endl;
     cout << "leaf_node_num: " << exp_recorder.leaf_node_num << endl;
     cout << "non_leaf_node_num: " << exp_recorder.non_leaf_node_num << endl;
     cout << "depth: " << exp_recorder.depth << endl;
+    cout << "cached_model_num: " << exp_recorder.cached_model_num << endl;
+    cout << "curves: Hilbert " << exp_recorder.hilbert_node_num << " Z " << exp_recorder.z_node_num << endl;
+    cout << "models_per_second: " << exp_recorder.get_models_per_second() << endl;
+    if (exp_recorder.last_level_model_num > 0)
+    {
+        cout << "leaf model setup time: " << exp_recorder.leaf_setup_time / exp_recorder.last_level_model_num << endl;
+    }
+}
+
+void RSMI::collect_stats(vector<index_stats::NodeStats> &nodes, vector<int> &page_sizes, int parent, double sibling_overlap)
+{
+    index_stats::NodeStats node;
+    node.id = nodes.size();
+    node.parent = parent;
+    node.level = level;
+    node.is_last = is_last;
+    node.N = N;
+    node.fanout = is_last ? leafnodes.size() : children.size();
+    node.model_width = width;
+    node.min_error = min_error;
+    node.max_error = max_error;
+    node.fill_factor = 0;
+    node.mbr_area = index_stats::area(mbr);
+    node.sibling_overlap = sibling_overlap;
+    node.curve = curve == curve_selection::Z ? "Z" : "Hilbert";
+    node.decision = index_stats::DECISION_NAMES[decision];
+    node.skew = skew;
+    node.trial_error = trial_error;
+    if (is_last)
+    {
+        long long point_num = 0;
+        for (LeafNode &leafnode : leafnodes)
+        {
+            page_sizes.push_back(leafnode.size());
+            point_num += leafnode.size();
+        }
+        node.fill_factor = leafnodes.empty() ? 0 : point_num * 1.0 / (leafnodes.size() * config.page_size);
+    }
+    nodes.push_back(node);
+    for (ChildMap::iterator iter = children.begin(); iter != children.end(); iter++)
+    {
+        double overlap = 0;
+        for (ChildMap::iterator sibling = children.begin(); sibling != children.end(); sibling++)
+        {
+            if (sibling != iter)
+            {
+                overlap += index_stats::intersection_area(iter->second.mbr, sibling->second.mbr);
+            }
+        }
+        iter->second.collect_stats(nodes, page_sizes, node.id, overlap);
+    }
+}
+
+void RSMI::dump_stats(string filename, string format)
+{
+    vector<index_stats::NodeStats> nodes;
+    vector<int> page_sizes;
+    collect_stats(nodes, page_sizes, -1, 0);
+    index_stats::write(filename, format, nodes, page_sizes, config.page_size);
+}
+
+memory_accounting::Usage RSMI::get_memory_usage()
+{
+    return account->get_usage();
+}
+
+huge_pages::PageSource *RSMI::get_page_source()
+{
+    return page_source.get();
+}
+
+buffer_pool::BufferPool *RSMI::get_buffer_pool()
+{
+    return pool.get();
+}
+
+RSMIConfig RSMI::tune(vector<Point> &points, vector<Point> &query_points, vector<Mbr> &query_windows, RSMIConfig base, RSMITuneOptions options)
+{
+    mt19937 gen(options.seed);
+    vector<Point> sample = points;
+    if ((long long)sample.size() > options.sample_size)
+    {
+        shuffle(sample.begin(), sample.end(), gen);
+        sample.resize(options.sample_size);
+    }
+    double ratio = sample.size() * 1.0 / points.size();
+    vector<Point> sample_queries = query_points.empty() ? sample : query_points;
+    shuffle(sample_queries.begin(), sample_queries.end(), gen);
+    sample_queries.resize(min((size_t)options.query_num, sample_queries.size()));
+    vector<Mbr> sample_windows = query_windows;
+    shuffle(sample_windows.begin(), sample_windows.end(), gen);
+    sample_windows.resize(min((size_t)options.query_num, sample_windows.size()));
+
+    vector<RSMIConfig> configs;
+    vector<double> latencies;
+    vector<double> sizes;
+    for (int page_size : options.page_sizes)
+    {
+        for (int threshold : options.thresholds)
+        {
+            for (int max_width : options.max_widths)
+            {
+                RSMIConfig config = base;
+                config.page_size = page_size;
+                config.threshold = threshold;
+                config.max_width = max_width;
+                if (!config.validate())
+                {
+                    continue;
+                }
+                RSMIConfig trial = config;
+                trial.threshold = max((long long)page_size, (long long)(threshold * ratio));
+                ExpRecorder exp_recorder;
+                exp_recorder.clean();
+                RSMI *index = new RSMI(0, trial);
+                index->build(exp_recorder, sample);
+                auto start = chrono::high_resolution_clock::now();
+                for (Point &query_point : sample_queries)
+                {
+                    index->point_query(exp_recorder, query_point);
+                }
+                for (Mbr &query_window : sample_windows)
+                {
+                    index->window_query(exp_recorder, query_window.get_corner_points(), query_window);
+                    exp_recorder.window_query_results.clear();
+                }
+                auto finish = chrono::high_resolution_clock::now();
+                long long query_num = sample_queries.size() + sample_windows.size();
+                configs.push_back(config);
+                latencies.push_back(chrono::duration_cast<chrono::nanoseconds>(finish - start).count() * 1.0 / (query_num > 0 ? query_num : 1));
+                memory_accounting::Usage usage = index->get_memory_usage();
+                sizes.push_back((usage.total() - usage.bytes[memory_accounting::BUFFERS]) * 1.0 / sample.size());
+                delete index;
+            }
+        }
+    }
+    if (configs.empty())
+    {
+        cerr << "RSMI::tune: no valid config, keeping the base config" << endl;
+        return base;
+    }
+
+    double best_latency = *min_element(latencies.begin(), latencies.end());
+    double best_size = *min_element(sizes.begin(), sizes.end());
+    int best = 0;
+    double best_score = 0;
+    cout << "tune: page_size threshold max_width latency(ns) size(bytes/point) score" << endl;
+    for (size_t i = 0; i < configs.size(); i++)
+    {
+        double score = options.latency_weight * latencies[i] / best_latency + options.memory_weight * sizes[i] / best_size;
+        cout << "tune: " << configs[i].page_size << " " << configs[i].threshold << " " << configs[i].max_width << " " << latencies[i] << " " << sizes[i] << " " << score << endl;
+        if (i == 0 || score < best_score)
+        {
+            best = i;
+            best_score = score;
+        }
+    }
+    cout << "tune: chose page_size " << configs[best].page_size << " threshold " << configs[best].threshold << " max_width " << configs[best].max_width << endl;
+    return configs[best];
 }
 
 bool RSMI::point_query(ExpRecorder &exp_recorder, Point query_point)
 {
+    if (query_log != NULL)
+    {
+        query_log->record_point(query_point);
+    }
     if (is_last)
     {
+        exp_recorder.phase_counters.enter(perf_counters::PREDICT);
         int predicted_index = 0;
         predicted_index = net->predict(query_point) * leaf_node_num;
         predicted_index = predicted_index < 0 ? 0 : predicted_index;
         predicted_index = predicted_index >= leaf_node_num ? leaf_node_num - 1 : predicted_index;
+        exp_recorder.phase_counters.enter(perf_counters::LEAF_SEARCH);
+        int front = predicted_index + min_error;
+        front = front < 0 ? 0 : front;
+        int back = predicted_index + max_error;
+        back = back >= leaf_node_num ? leaf_node_num - 1 : back;
+        if (is_batched())
+        {
+            // every page of the error window is read at once instead of probing outwards
+            bool is_found = false;
+            fetch_leaves(exp_recorder, min(front, predicted_index), max(back, predicted_index), Mbr(query_point.x, query_point.y, query_point.x, query_point.y), [&](LeafNode &, buffer_pool::DiskPage *page) {
+                if (!is_found)
+                {
+                    exp_recorder.page_access += 1;
+                    LeafNode::scan_page(page, Mbr(query_point.x, query_point.y, query_point.x, query_point.y), [&](Point) { is_found = true; });
+                }
+            });
+            return is_found;
+        }
         LeafNode leafnode = leafnodes[predicted_index];
         if (leafnode.mbr.contains(query_point))
         {
             exp_recorder.page_access += 1;
-            vector<Point>::iterator iter = find(leafnode.children->begin(), leafnode.children->end(), query_point);
-            if (iter != leafnode.children->end())
+            if (leafnode.has_point(query_point, &exp_recorder.io_stats))
             {
                 return true;
             }
         }
         // predicted result is not correct
-        int front = predicted_index + min_error;
-        front = front < 0 ? 0 : front;
-        int back = predicted_index + max_error;
-        back = back >= leaf_node_num ? leaf_node_num - 1 : back;
 
         int gap = 1;
         int predicted_index_left = predicted_index - gap;
@@ -429,12 +1030,9 @@ bool RSMI::point_query(ExpRecorder &exp_recorder, Point query_point)
             if (leafnode.mbr.contains(query_point))
             {
                 exp_recorder.page_access += 1;
-                for (Point point : (*leafnode.children))
+                if (leafnode.has_point(query_point, &exp_recorder.io_stats))
                 {
-                    if (query_point.x == point.x && query_point.y == point.y)
-                    {
-                        return true;
-                    }
+                    return true;
                 }
             }
 
@@ -443,12 +1041,9 @@ bool RSMI::point_query(ExpRecorder &exp_recorder, Point query_point)
             if (leafnode.mbr.contains(query_point))
             {
                 exp_recorder.page_access += 1;
-                for (Point point : (*leafnode.children))
+                if (leafnode.has_point(query_point, &exp_recorder.io_stats))
                 {
-                    if (query_point.x == point.x && query_point.y == point.y)
-                    {
-                        return true;
-                    }
+                    return true;
                 }
             }
             gap++;
@@ -463,12 +1058,9 @@ bool RSMI::point_query(ExpRecorder &exp_recorder, Point query_point)
             if (leafnode.mbr.contains(query_point))
             {
                 exp_recorder.page_access += 1;
-                for (Point point : (*leafnode.children))
+                if (leafnode.has_point(query_point, &exp_recorder.io_stats))
                 {
-                    if (query_point.x == point.x && query_point.y == point.y)
-                    {
-                        return true;
-                    }
+                    return true;
                 }
             }
             gap++;
@@ -482,12 +1074,9 @@ bool RSMI::point_query(ExpRecorder &exp_recorder, Point query_point)
             if (leafnode.mbr.contains(query_point))
             {
                 exp_recorder.page_access += 1;
-                for (Point point : (*leafnode.children))
+                if (leafnode.has_point(query_point, &exp_recorder.io_stats))
                 {
-                    if (query_point.x == point.x && query_point.y == point.y)
-                    {
-                        return true;
-                    }
+                    return true;
                 }
             }
             gap++;
@@ -499,9 +1088,11 @@ bool RSMI::point_query(ExpRecorder &exp_recorder, Point query_point)
     }
     else
     {
+        exp_recorder.phase_counters.enter(perf_counters::PREDICT);
         int predicted_index = net->predict(query_point) * width;
         predicted_index = predicted_index < 0 ? 0 : predicted_index;
         predicted_index = predicted_index >= width ? width - 1 : predicted_index;
+        exp_recorder.phase_counters.enter(perf_counters::ROUTE);
         if (children.count(predicted_index) == 0)
         {
             return false;
@@ -515,15 +1106,106 @@ void RSMI::point_query(ExpRecorder &exp_recorder, vector<Point> query_points)
     long size = query_points.size();
     for (long i = 0; i < size; i++)
     {
+        double page_access = exp_recorder.page_access;
         auto start = chrono::high_resolution_clock::now();
         point_query(exp_recorder, query_points[i]);
         auto finish = chrono::high_resolution_clock::now();
-        exp_recorder.time += chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
+        exp_recorder.phase_counters.leave();
+        long long temp_time = chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
+        exp_recorder.time += temp_time;
+        exp_recorder.record(temp_time, exp_recorder.page_access - page_access);
     }
     exp_recorder.time /= size;
     exp_recorder.page_access = exp_recorder.page_access / size;
 }
 
+long long RSMI::point_query(ExpRecorder &exp_recorder, vector<Point> &query_points, int batch_size)
+{
+    long long found_num = 0;
+    if (!is_batched())
+    {
+        for (Point &query_point : query_points)
+        {
+            found_num += point_query(exp_recorder, query_point);
+        }
+        return found_num;
+    }
+    for (size_t begin = 0; begin < query_points.size(); begin += batch_size)
+    {
+        size_t end = min(query_points.size(), begin + batch_size);
+        // pages of the batch and, per page, the queries waiting for it
+        vector<long long> page_ids;
+        vector<vector<int>> waiting;
+        unordered_map<long long, int> page_index;
+        vector<bool> is_found(end - begin, false);
+        for (size_t q = begin; q < end; q++)
+        {
+            Point &query_point = query_points[q];
+            if (query_log != NULL)
+            {
+                query_log->record_point(query_point);
+            }
+            RSMI *node = route(query_point);
+            if (node == NULL)
+            {
+                continue;
+            }
+            int predicted_index = node->net->predict(query_point) * node->leaf_node_num;
+            predicted_index = predicted_index < 0 ? 0 : predicted_index;
+            predicted_index = predicted_index >= node->leaf_node_num ? node->leaf_node_num - 1 : predicted_index;
+            int front = min(max(predicted_index + node->min_error, 0), predicted_index);
+            int back = max(min(predicted_index + node->max_error, node->leaf_node_num - 1), predicted_index);
+            for (int i = front; i <= back; i++)
+            {
+                LeafNode &leafnode = node->leafnodes[i];
+                if (!leafnode.mbr.contains(query_point))
+                {
+                    continue;
+                }
+                pair<unordered_map<long long, int>::iterator, bool> inserted = page_index.insert({leafnode.page_id, (int)page_ids.size()});
+                if (inserted.second)
+                {
+                    page_ids.push_back(leafnode.page_id);
+                    waiting.push_back(vector<int>());
+                }
+                waiting[inserted.first->second].push_back(q - begin);
+            }
+        }
+        pool->fetch_batch(page_ids, &exp_recorder.io_stats, [&](int i, buffer_pool::DiskPage *page) {
+            for (int q : waiting[i])
+            {
+                if (is_found[q])
+                {
+                    continue;
+                }
+                Point &query_point = query_points[begin + q];
+                exp_recorder.page_access += 1;
+                LeafNode::scan_page(page, Mbr(query_point.x, query_point.y, query_point.x, query_point.y), [&](Point) { is_found[q] = true; });
+            }
+        });
+        found_num += count(is_found.begin(), is_found.end(), true);
+    }
+    return found_num;
+}
+
+RSMI *RSMI::route(Point query_point)
+{
+    RSMI *node = this;
+    while (!node->is_last)
+    {
+        int predicted_index = node->net->predict(query_point) * node->width;
+        predicted_index = predicted_index < 0 ? 0 : predicted_index;
+        predicted_index = predicted_index >= node->width ? node->width - 1 : predicted_index;
+        ChildMap::iterator iter = node->children.find(predicted_index);
+        if (iter == node->children.end())
+        {
+            return NULL;
+        }
+        node = &iter->second;
+    }
+    return node->leaf_node_num > 0 ? node : NULL;
+}
+
 void RSMI::window_query(ExpRecorder &exp_recorder, vector<Mbr> query_windows)
 {
     long long time_cost = 0;
@@ -532,13 +1214,17 @@ void RSMI::window_query(ExpRecorder &exp_recorder, vector<Mbr> query_windows)
     for (int i = 0; i < length; i++)
     {
         vector<Point> vertexes = query_windows[i].get_corner_points();
+        double page_access = exp_recorder.page_access;
         auto start = chrono::high_resolution_clock::now();
         window_query(exp_recorder, vertexes, query_windows[i]);
         auto finish = chrono::high_resolution_clock::now();
+        exp_recorder.phase_counters.leave();
         exp_recorder.window_query_result_size += exp_recorder.window_query_results.size();
         exp_recorder.window_query_results.clear();
         exp_recorder.window_query_results.shrink_to_fit();
-        exp_recorder.time += chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
+        long long temp_time = chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
+        exp_recorder.time += temp_time;
+        exp_recorder.record(temp_time, exp_recorder.page_access - page_access);
     }
     exp_recorder.time /= length;
     exp_recorder.page_access = (double)exp_recorder.page_access / length;
@@ -546,11 +1232,16 @@ void RSMI::window_query(ExpRecorder &exp_recorder, vector<Mbr> query_windows)
 
 void RSMI::window_query(ExpRecorder &exp_recorder, vector<Point> vertexes, Mbr query_window)
 {
+    if (query_log != NULL)
+    {
+        query_log->record_window(query_window);
+    }
     if (is_last)
     {
         int leafnodes_size = leafnodes.size();
         int front = leafnodes_size - 1;
         int back = 0;
+        exp_recorder.phase_counters.enter(perf_counters::PREDICT);
         if (leaf_node_num == 0)
         {
             return;
@@ -584,26 +1275,35 @@ void RSMI::window_query(ExpRecorder &exp_recorder, vector<Point> vertexes, Mbr q
             front = min < 0 ? 0 : min;
             back = max >= leafnodes_size ? leafnodes_size - 1 : max;
         }
+        exp_recorder.phase_counters.enter(perf_counters::LEAF_SEARCH);
+        if (is_batched())
+        {
+            fetch_leaves(exp_recorder, front, back, query_window, [&](LeafNode &, buffer_pool::DiskPage *page) {
+                exp_recorder.page_access += 1;
+                LeafNode::scan_page(page, query_window, [&](Point point) { exp_recorder.window_query_results.push_back(point); });
+            });
+            return;
+        }
+        if (pool != NULL)
+        {
+            pool->prefetch(get_page_ids(front, back, query_window), &exp_recorder.io_stats);
+        }
         for (size_t i = front; i <= back; i++)
         {
             LeafNode leafnode = leafnodes[i];
             if (leafnode.mbr.interact(query_window))
             {
                 exp_recorder.page_access += 1;
-                for (Point point : (*leafnode.children))
-                {
-                    if (query_window.contains(point))
-                    {
-                        exp_recorder.window_query_results.push_back(point);
-                        // exp_recorder.window_query_result_size++;
-                    }
-                }
+                exp_recorder.phase_counters.enter(perf_counters::MATERIALIZE);
+                leafnode.scan(query_window, [&](Point point) { exp_recorder.window_query_results.push_back(point); }, &exp_recorder.io_stats);
+                exp_recorder.phase_counters.enter(perf_counters::LEAF_SEARCH);
             }
         }
         return;
     }
     else
     {
+        exp_recorder.phase_counters.enter(perf_counters::PREDICT);
         int children_size = children.size();
         int front = children_size - 1;
         int back = 0;
@@ -621,7 +1321,7 @@ void RSMI::window_query(ExpRecorder &exp_recorder, vector<Point> vertexes, Mbr q
                 back = predicted_index;
             }
         }
-
+        exp_recorder.phase_counters.enter(perf_counters::ROUTE);
         for (size_t i = front; i <= back; i++)
         {
             if (children.count(i) == 0)
@@ -631,6 +1331,7 @@ void RSMI::window_query(ExpRecorder &exp_recorder, vector<Point> vertexes, Mbr q
             if (children[i].mbr.interact(query_window))
             {
                 children[i].window_query(exp_recorder, vertexes, query_window);
+                exp_recorder.phase_counters.enter(perf_counters::ROUTE);
             }
         }
     }
@@ -644,6 +1345,7 @@ void RSMI::window_query(ExpRecorder &exp_recorder, vector<Point> vertexes, Mbr q
         int leafnodesSize = leafnodes.size();
         int front = leafnodesSize - 1;
         int back = 0;
+        exp_recorder.phase_counters.enter(perf_counters::PREDICT);
         if (leaf_node_num == 0)
         {
             return;
@@ -679,6 +1381,30 @@ void RSMI::window_query(ExpRecorder &exp_recorder, vector<Point> vertexes, Mbr q
             front = min < 0 ? 0 : min;
             back = max >= leafnodesSize ? leafnodesSize - 1 : max;
         }
+        exp_recorder.phase_counters.enter(perf_counters::LEAF_SEARCH);
+        if (is_batched())
+        {
+            // the heap grows as pages arrive, so the pruning is decided when a page is there
+            fetch_leaves(exp_recorder, front, back, query_window, [&](LeafNode &leafnode, buffer_pool::DiskPage *page) {
+                float dis = leafnode.mbr.cal_dist(query_point);
+                if (dis > boundary || (exp_recorder.pq.size() >= k && dis > kth))
+                {
+                    return;
+                }
+                exp_recorder.page_access += 1;
+                LeafNode::scan_page(page, query_window, [&](Point point) {
+                    if (point.cal_dist(query_point) <= boundary)
+                    {
+                        exp_recorder.pq.push(point);
+                    }
+                });
+            });
+            return;
+        }
+        if (pool != NULL)
+        {
+            pool->prefetch(get_page_ids(front, back, query_window), &exp_recorder.io_stats);
+        }
         for (size_t i = front; i <= back; i++)
         {
             LeafNode leafnode = leafnodes[i];
@@ -694,22 +1420,21 @@ void RSMI::window_query(ExpRecorder &exp_recorder, vector<Point> vertexes, Mbr q
             if (leafnode.mbr.interact(query_window))
             {
                 exp_recorder.page_access += 1;
-                for (Point point : (*leafnode.children))
-                {
-                    if (query_window.contains(point))
+                exp_recorder.phase_counters.enter(perf_counters::MATERIALIZE);
+                leafnode.scan(query_window, [&](Point point) {
+                    if (point.cal_dist(query_point) <= boundary)
                     {
-                        if (point.cal_dist(query_point) <= boundary)
-                        {
-                            exp_recorder.pq.push(point);
-                        }
+                        exp_recorder.pq.push(point);
                     }
-                }
+                }, &exp_recorder.io_stats);
+                exp_recorder.phase_counters.enter(perf_counters::LEAF_SEARCH);
             }
         }
         return;
     }
     else
     {
+        exp_recorder.phase_counters.enter(perf_counters::PREDICT);
         int front = width;
         int back = 0;
         for (size_t i = 0; i < vertexes.size(); i++)
@@ -728,6 +1453,7 @@ void RSMI::window_query(ExpRecorder &exp_recorder, vector<Point> vertexes, Mbr q
                 back = predicted_index;
             }
         }
+        exp_recorder.phase_counters.enter(perf_counters::ROUTE);
         for (size_t i = front; i <= back; i++)
         {
             if (children.count(i) == 0)
@@ -741,34 +1467,74 @@ void RSMI::window_query(ExpRecorder &exp_recorder, vector<Point> vertexes, Mbr q
             if (children[i].mbr.interact(query_window))
             {
                 children[i].window_query(exp_recorder, vertexes, query_window, boundary, k, query_point, kth);
+                exp_recorder.phase_counters.enter(perf_counters::ROUTE);
             }
         }
     }
 }
 
+vector<long long> RSMI::get_page_ids(int front, int back, Mbr window)
+{
+    vector<long long> page_ids;
+    for (int i = front; i <= back; i++)
+    {
+        if (leafnodes[i].pool != NULL && leafnodes[i].mbr.interact(window))
+        {
+            page_ids.push_back(leafnodes[i].page_id);
+        }
+    }
+    return page_ids;
+}
+
+bool RSMI::is_batched()
+{
+    return pool != NULL && pool->get_read_mode() != buffer_pool::SYNC;
+}
+
+template <class F>
+void RSMI::fetch_leaves(ExpRecorder &exp_recorder, int front, int back, Mbr window, F f)
+{
+    vector<int> indexes;
+    vector<long long> page_ids;
+    for (int i = front; i <= back; i++)
+    {
+        if (leafnodes[i].mbr.interact(window))
+        {
+            indexes.push_back(i);
+            page_ids.push_back(leafnodes[i].page_id);
+        }
+    }
+    pool->fetch_batch(page_ids, &exp_recorder.io_stats, [&](int i, buffer_pool::DiskPage *page) { f(leafnodes[indexes[i]], page); });
+}
+
 vector<Point> RSMI::acc_window_query(ExpRecorder &exp_recorder, Mbr query_window)
 {
     vector<Point> window_query_results;
-    if (is_last)
+    if (is_last && is_batched())
+    {
+        fetch_leaves(exp_recorder, 0, (int)leafnodes.size() - 1, query_window, [&](LeafNode &, buffer_pool::DiskPage *page) {
+            exp_recorder.page_access += 1;
+            LeafNode::scan_page(page, query_window, [&](Point point) { window_query_results.push_back(point); });
+        });
+    }
+    else if (is_last)
     {
+        if (pool != NULL)
+        {
+            pool->prefetch(get_page_ids(0, (int)leafnodes.size() - 1, query_window), &exp_recorder.io_stats);
+        }
         for (LeafNode leafnode : leafnodes)
         {
             if (leafnode.mbr.interact(query_window))
             {
                 exp_recorder.page_access += 1;
-                for (Point point : (*leafnode.children))
-                {
-                    if (query_window.contains(point))
-                    {
-                        window_query_results.push_back(point);
-                    }
-                }
+                leafnode.scan(query_window, [&](Point point) { window_query_results.push_back(point); }, &exp_recorder.io_stats);
             }
         }
     }
     else
     {
-        map<int, RSMI>::iterator iter = children.begin();
+        ChildMap::iterator iter = children.begin();
         while (iter != children.end())
         {
             if (iter->second.mbr.interact(query_window))
@@ -787,10 +1553,13 @@ void RSMI::acc_window_query(ExpRecorder &exp_recorder, vector<Mbr> query_windows
     int length = query_windows.size();
     for (int i = 0; i < length; i++)
     {
+        double page_access = exp_recorder.page_access;
         auto start = chrono::high_resolution_clock::now();
         exp_recorder.acc_window_query_qesult_size += acc_window_query(exp_recorder, query_windows[i]).size();
         auto finish = chrono::high_resolution_clock::now();
-        exp_recorder.time += chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
+        long long temp_time = chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
+        exp_recorder.time += temp_time;
+        exp_recorder.record(temp_time, exp_recorder.page_access - page_access);
     }
     exp_recorder.time = exp_recorder.time / length;
     exp_recorder.page_access = (double)exp_recorder.page_access / length;
@@ -806,11 +1575,14 @@ void RSMI::kNN_query(ExpRecorder &exp_recorder, vector<Point> query_points, int
     {
         priority_queue<Point , vector<Point>, sortForKNN2> temp_pq;
         exp_recorder.pq = temp_pq;
+        double page_access = exp_recorder.page_access;
         auto start = chrono::high_resolution_clock::now();
         vector<Point> knnresult = kNN_query(exp_recorder, query_points[i], k);
         auto finish = chrono::high_resolution_clock::now();
+        exp_recorder.phase_counters.leave();
         long long temp_time = chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
         exp_recorder.time += temp_time;
+        exp_recorder.record(temp_time, exp_recorder.page_access - page_access);
         exp_recorder.knn_query_results.insert(exp_recorder.knn_query_results.end(), knnresult.begin(), knnresult.end());
     }
     exp_recorder.time /= length;
@@ -847,6 +1619,10 @@ double RSMI::cal_rho(Point point)
 
 vector<Point> RSMI::kNN_query(ExpRecorder &exp_recorder, Point query_point, int k)
 {
+    if (query_log != NULL)
+    {
+        query_log->record_kNN(query_point, k);
+    }
     // double rh0 = cal_rho(query_point);
     // float knnquery_side = sqrt((float)k / N) * rh0;
     vector<Point> result;
@@ -862,6 +1638,7 @@ vector<Point> RSMI::kNN_query(ExpRecorder &exp_recorder, Point query_point, int
         size = exp_recorder.pq.size();
         if (size >= k)
         {
+            exp_recorder.phase_counters.enter(perf_counters::MATERIALIZE);
             for (size_t i = 0; i < k; i++)
             {
                 result.push_back(exp_recorder.pq.top());
@@ -880,10 +1657,13 @@ void RSMI::acc_kNN_query(ExpRecorder &exp_recorder, vector<Point> query_points,
     // length = 1;
     for (int i = 0; i < length; i++)
     {
+        double page_access = exp_recorder.page_access;
         auto start = chrono::high_resolution_clock::now();
         vector<Point> knnresult = acc_kNN_query(exp_recorder, query_points[i], k);
         auto finish = chrono::high_resolution_clock::now();
-        exp_recorder.time += chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
+        long long temp_time = chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
+        exp_recorder.time += temp_time;
+        exp_recorder.record(temp_time, exp_recorder.page_access - page_access);
         exp_recorder.acc_knn_query_results.insert(exp_recorder.acc_knn_query_results.end(), knnresult.begin(), knnresult.end());
     }
     exp_recorder.time /= length;
@@ -924,18 +1704,25 @@ void RSMI::insert(ExpRecorder &exp_recorder, Point point)
     int predicted_index = net->predict(point) * width;
     predicted_index = predicted_index < 0 ? 0 : predicted_index;
     predicted_index = predicted_index >= width ? width - 1 : predicted_index;
+    // window queries skip a child whose MBR misses the window
+    mbr.update(point.x, point.y);
     if (is_last)
     {
-        if (N == Constants::THRESHOLD)
+        // a last-level node is rebuilt once it outgrows the largest size a node is built as one
+        if (N >= (config.adaptive ? config.threshold * config.leaf_band : config.threshold))
         {
             // cout << "rebuild: " << endl;
             is_last = false;
             vector<Point> points;
             for (LeafNode leafNode : leafnodes)
             {
-                points.insert(points.end(), leafNode.children->begin(), leafNode.children->end());
+                leafNode.get_points(points);
             }
             points.push_back(point);
+            leafnodes.clear();
+            leafnodes.shrink_to_fit();
+            net.reset();
+            arena->release();
             auto start = chrono::high_resolution_clock::now();
             build(exp_recorder, points);
             auto finish = chrono::high_resolution_clock::now();
@@ -944,15 +1731,27 @@ void RSMI::insert(ExpRecorder &exp_recorder, Point point)
         }
         else
         {
-            int insertedIndex = predicted_index / Constants::PAGESIZE;
-            LeafNode leafnode = leafnodes[insertedIndex];
-            if (leafnode.is_full())
+            int insertedIndex = predicted_index / config.page_size;
+            // width only grows, so after deletes it can point past the last page
+            insertedIndex = insertedIndex >= leafnodes.size() ? leafnodes.size() - 1 : insertedIndex;
+            // the stored page, not a copy, so its MBR grows with the point; a compressed or disk
+            // page that is full refuses the point
+            if (leafnodes[insertedIndex].is_full(config.page_size) || !leafnodes[insertedIndex].add_point(point))
             {
-                LeafNode right = leafnode.split1();
+                LeafNode right = leafnodes[insertedIndex].split1(config.page_size);
                 leafnodes.insert(leafnodes.begin() + insertedIndex + 1, right);
                 leaf_node_num++;
+                leafnodes[insertedIndex].add_point(point);
+                // the pages after the split move one slot up, and queries now scale the model's
+                // output by one more page, which moves a prediction up by at most one page
+                max_error++;
+                min_error--;
             }
-            leafnode.add_point(point);
+            int query_index = net->predict(point) * leaf_node_num;
+            query_index = query_index < 0 ? 0 : query_index;
+            query_index = query_index >= leaf_node_num ? leaf_node_num - 1 : query_index;
+            max_error = max(max_error, insertedIndex - query_index);
+            min_error = min(min_error, insertedIndex - query_index);
             N++;
             width++;
         }
@@ -961,7 +1760,9 @@ void RSMI::insert(ExpRecorder &exp_recorder, Point point)
     {
         if (children.count(predicted_index) == 0)
         {
-            // TODO
+            // no build point was routed here: the point starts a last-level child of its own
+            RSMI &partition = children.emplace(piecewise_construct, forward_as_tuple(predicted_index), forward_as_tuple(predicted_index, level + 1, config, account, page_source, pool)).first->second;
+            partition.build(exp_recorder, vector<Point>(1, point));
             return;
         }
         children[predicted_index].insert(exp_recorder, point);
@@ -970,13 +1771,18 @@ void RSMI::insert(ExpRecorder &exp_recorder, Point point)
 
 void RSMI::insert(ExpRecorder &exp_recorder, vector<Point> points)
 {
-    auto start = chrono::high_resolution_clock::now();
+    long long time_cost = 0;
     for (Point point : points)
     {
+        double page_access = exp_recorder.page_access;
+        auto start = chrono::high_resolution_clock::now();
         insert(exp_recorder, point);
+        auto finish = chrono::high_resolution_clock::now();
+        long long temp_time = chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
+        time_cost += temp_time;
+        exp_recorder.record(temp_time, exp_recorder.page_access - page_access);
     }
-    auto finish = chrono::high_resolution_clock::now();
-    exp_recorder.insert_time = (chrono::duration_cast<chrono::nanoseconds>(finish - start).count()) / exp_recorder.insert_num;
+    exp_recorder.insert_time = time_cost / exp_recorder.insert_num;
 }
 
 void RSMI::remove(ExpRecorder &exp_recorder, Point point)
@@ -991,12 +1797,11 @@ void RSMI::remove(ExpRecorder &exp_recorder, Point point)
         front = front < 0 ? 0 : front;
         int back = predicted_index + max_error;
         back = back >= N ? N - 1 : back;
-        front = front / Constants::PAGESIZE;
-        back = back / Constants::PAGESIZE;
+        front = front / config.page_size;
+        back = back / config.page_size;
         for (size_t i = front; i <= back; i++)
         {
             LeafNode leafnode = leafnodes[i];
-            vector<Point>::iterator iter = find(leafnode.children->begin(), leafnode.children->end(), point);
             if (leafnode.mbr.contains(point) && leafnode.delete_point(point))
             {
                 N--;
@@ -1016,13 +1821,18 @@ void RSMI::remove(ExpRecorder &exp_recorder, Point point)
 
 void RSMI::remove(ExpRecorder &exp_recorder, vector<Point> points)
 {
-    auto start = chrono::high_resolution_clock::now();
+    long long time_cost = 0;
     for (Point point : points)
     {
+        double page_access = exp_recorder.page_access;
+        auto start = chrono::high_resolution_clock::now();
         remove(exp_recorder, point);
+        auto finish = chrono::high_resolution_clock::now();
+        long long temp_time = chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
+        time_cost += temp_time;
+        exp_recorder.record(temp_time, exp_recorder.page_access - page_access);
     }
-    auto finish = chrono::high_resolution_clock::now();
     long long oldTimeCost = exp_recorder.delete_time * exp_recorder.delete_num;
     exp_recorder.delete_num += points.size();
-    exp_recorder.delete_time = (oldTimeCost + oldTimeCost + chrono::duration_cast<chrono::nanoseconds>(finish - start).count()) / exp_recorder.delete_num;
+    exp_recorder.delete_time = (oldTimeCost + time_cost) / exp_recorder.delete_num;
 }
\ No newline at end of file
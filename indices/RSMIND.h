@@ -0,0 +1,694 @@
+#ifndef RSMIND_H
+#define RSMIND_H
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include "../entities/PointND.h"
+#include "../entities/MbrND.h"
+#include "../entities/LeafNodeND.h"
+#include "../utils/ExpRecorder.h"
+#include "../utils/ModelTools.h"
+#include "../utils/ModelStore.h"
+#include "../utils/BuildScheduler.h"
+#include "../utils/RadixSort.h"
+#include "../curves/hilbert4.H"
+using namespace std;
+
+// RSMI over D-dimensional points (D = 2..4). The structure follows RSMI: non-leaf nodes cut
+// their points into fanout^D equal-count cells (fanout slabs per dimension), label the cells
+// in Z order and learn a D-input model that routes points to children; last-level nodes order
+// their points by the D-dimensional Hilbert value of their ranks (hilbert_c2i) and learn the
+// page of each point. D is a template parameter, so models and MBR tests are compiled for each
+// dimension and the 2-D RSMI is left as it is.
+template <int D>
+class RSMIND
+{
+private:
+    int level = 0;
+    int index = 0;
+    int fanout = 0;
+    long long N = 0;
+    int max_error = 0;
+    int min_error = 0;
+    int width = 0;
+    int leaf_node_num = 0;
+
+    bool is_last = false;
+    MbrND<D> mbr;
+    std::shared_ptr<Net> net;
+
+    void build(ExpRecorder &exp_recorder, PointND<D> *points, long long length, BuildScheduler &scheduler);
+    void train_leaf_model(ExpRecorder &exp_recorder, BuildScheduler &scheduler);
+    void order_by_curve(PointND<D> *points, long long length, long long side);
+    template <typename K>
+    void sort_by_curve(PointND<D> *points, long long length, const vector<bitmask_t> &curve_vals);
+    void label_cells(PointND<D> *points, long long length, int dim, int cell[], long long cell_size, int cell_bits, TrainingStage &stage, long long &point_index);
+    int predict_child(const PointND<D> &point);
+    int predict_page(const PointND<D> &point);
+    bool search_page(ExpRecorder &exp_recorder, int page, const PointND<D> &query_point);
+    void window_query(ExpRecorder &exp_recorder, const vector<PointND<D>> &vertexes, const MbrND<D> &query_window, vector<PointND<D>> &results);
+
+public:
+    static string model_path_root;
+    map<int, RSMIND> children;
+    vector<LeafNodeND<D>> leafnodes;
+
+    // partitions per dimension: about 256 children per non-leaf node, as 16 x 16 in RSMI
+    static int default_fanout()
+    {
+        return D == 2 ? Constants::MAX_WIDTH : (D == 3 ? 6 : 4);
+    }
+
+    RSMIND()
+    {
+    }
+
+    RSMIND(int index, int level, int fanout)
+    {
+        this->index = index;
+        this->level = level;
+        this->fanout = fanout;
+    }
+
+    void build(ExpRecorder &exp_recorder, vector<PointND<D>> points);
+    void print_index_info(ExpRecorder &exp_recorder);
+
+    bool point_query(ExpRecorder &exp_recorder, const PointND<D> &query_point);
+    void point_query(ExpRecorder &exp_recorder, const vector<PointND<D>> &query_points);
+
+    vector<PointND<D>> window_query(ExpRecorder &exp_recorder, const MbrND<D> &query_window);
+    void window_query(ExpRecorder &exp_recorder, const vector<MbrND<D>> &query_windows);
+    vector<PointND<D>> acc_window_query(ExpRecorder &exp_recorder, const MbrND<D> &query_window);
+    void acc_window_query(ExpRecorder &exp_recorder, const vector<MbrND<D>> &query_windows);
+
+    vector<PointND<D>> kNN_query(ExpRecorder &exp_recorder, const PointND<D> &query_point, int k);
+    vector<PointND<D>> kNN_query(ExpRecorder &exp_recorder, const vector<PointND<D>> &query_points, int k);
+    vector<PointND<D>> acc_kNN_query(ExpRecorder &exp_recorder, const PointND<D> &query_point, int k);
+    vector<PointND<D>> acc_kNN_query(ExpRecorder &exp_recorder, const vector<PointND<D>> &query_points, int k);
+};
+
+template <int D>
+string RSMIND<D>::model_path_root = "";
+
+template <int D>
+void RSMIND<D>::build(ExpRecorder &exp_recorder, vector<PointND<D>> points)
+{
+    BuildScheduler scheduler;
+    build(exp_recorder, points.data(), points.size(), scheduler);
+    scheduler.run();
+    exp_recorder.leaf_training_time += scheduler.time;
+    exp_recorder.trained_leaf_model_num += scheduler.size();
+}
+
+template <int D>
+void RSMIND<D>::train_leaf_model(ExpRecorder &exp_recorder, BuildScheduler &scheduler)
+{
+    TrainingStage &stage = training_stage();
+    stage.resize(N, D);
+    long long point_index = 0;
+    for (LeafNodeND<D> &leafnode : leafnodes)
+    {
+        for (PointND<D> &point : leafnode.children)
+        {
+            copy(point.coords, point.coords + D, stage.locations.begin() + point_index * D);
+            stage.labels[point_index] = point.index;
+            point_index++;
+        }
+    }
+
+    ModelStore model_store(model_path_root);
+    uint64_t model_key = ModelStore::key(stage.locations.data(), stage.labels.data(), N, *net, level, 0);
+    bool is_cached = model_store.load(*net, model_key);
+    if (!is_cached)
+    {
+        net->train_model(stage.locations.data(), stage.labels.data(), N);
+        model_store.save(*net, model_key);
+    }
+    net->get_parameters_ND();
+
+    for (int i = 0; i < leaf_node_num; i++)
+    {
+        for (PointND<D> &point : leafnodes[i].children)
+        {
+            int error = i - predict_page(point);
+            max_error = error > max_error ? error : max_error;
+            min_error = error < min_error ? error : min_error;
+        }
+    }
+
+    lock_guard<mutex> guard(scheduler.lock());
+    if (is_cached)
+    {
+        exp_recorder.cached_model_num++;
+    }
+    exp_recorder.total_max_error += max_error;
+    exp_recorder.total_min_error += min_error;
+    if ((max_error - min_error) > (exp_recorder.max_error - exp_recorder.min_error))
+    {
+        exp_recorder.max_error = max_error;
+        exp_recorder.min_error = min_error;
+    }
+}
+
+// Ranks every dimension with a radix sort and orders the points by the Hilbert value of their
+// ranks. Hilbert values take D * log2(side) bits, so 64-bit keys are used when they fit.
+template <int D>
+void RSMIND<D>::order_by_curve(PointND<D> *points, long long length, long long side)
+{
+    int thread_num = thread_utils::default_thread_num();
+    int bits = 1;
+    while ((1LL << bits) < side)
+    {
+        bits++;
+    }
+    vector<bitmask_t> ranks(length * D);
+    vector<radix_sort::KeyIndex<uint32_t>> coordinates(length);
+    for (int d = 0; d < D; d++)
+    {
+        for (long long i = 0; i < length; i++)
+        {
+            coordinates[i].key = radix_sort::float_key(points[i].coords[d]);
+            coordinates[i].index = i;
+        }
+        radix_sort::sort(coordinates, thread_num);
+        for (long long i = 0; i < length; i++)
+        {
+            ranks[coordinates[i].index * D + d] = i;
+        }
+    }
+    for (long long i = 0; i < length; i++)
+    {
+        mbr.update(points[i]);
+    }
+
+    vector<bitmask_t> curve_vals(length);
+    for (long long i = 0; i < length; i++)
+    {
+        curve_vals[i] = hilbert_c2i(D, bits, &ranks[i * D]);
+        points[i].curve_val = (long long)curve_vals[i];
+    }
+    if (D * bits <= 64)
+    {
+        sort_by_curve<uint64_t>(points, length, curve_vals);
+    }
+    else
+    {
+        sort_by_curve<__uint128_t>(points, length, curve_vals);
+    }
+}
+
+template <int D>
+template <typename K>
+void RSMIND<D>::sort_by_curve(PointND<D> *points, long long length, const vector<bitmask_t> &curve_vals)
+{
+    vector<radix_sort::KeyIndex<K>> keys(length);
+    for (long long i = 0; i < length; i++)
+    {
+        keys[i].key = (K)curve_vals[i];
+        keys[i].index = i;
+    }
+    radix_sort::sort(keys, thread_utils::default_thread_num());
+    vector<PointND<D>> ordered(length);
+    for (long long i = 0; i < length; i++)
+    {
+        ordered[i] = points[keys[i].index];
+    }
+    copy(ordered.begin(), ordered.end(), points);
+}
+
+// Sorts the range by dimension dim and cuts it into fanout slabs, recursing into each slab with
+// the next dimension; in the last dimension every slab is one cell of cell_size points, whose
+// label is its Z value. For D = 2 these are the strips and cells of RSMI.
+template <int D>
+void RSMIND<D>::label_cells(PointND<D> *points, long long length, int dim, int cell[], long long cell_size, int cell_bits, TrainingStage &stage, long long &point_index)
+{
+    sort(points, points + length, [dim](const PointND<D> &a, const PointND<D> &b) { return a.coords[dim] < b.coords[dim]; });
+    long long slab_size = cell_size;
+    for (int d = dim + 1; d < D; d++)
+    {
+        slab_size *= fanout;
+    }
+    for (int i = 0; i < fanout; i++)
+    {
+        long long bn_index = i * slab_size;
+        if (bn_index >= length)
+        {
+            break;
+        }
+        long long end_index = bn_index + slab_size > length ? length : bn_index + slab_size;
+        cell[dim] = i;
+        if (dim < D - 1)
+        {
+            label_cells(points + bn_index, end_index - bn_index, dim + 1, cell, cell_size, cell_bits, stage, point_index);
+            continue;
+        }
+        long long Z_value = 0;
+        for (int b = 0; b < cell_bits; b++)
+        {
+            for (int d = 0; d < D; d++)
+            {
+                Z_value |= (long long)((cell[d] >> b) & 1) << (b * D + d);
+            }
+        }
+        for (long long k = bn_index; k < end_index; k++)
+        {
+            PointND<D> &point = points[k];
+            copy(point.coords, point.coords + D, stage.locations.begin() + point_index * D);
+            stage.labels[point_index] = Z_value * 1.0 / width;
+            point_index++;
+            mbr.update(point);
+        }
+    }
+}
+
+template <int D>
+void RSMIND<D>::build(ExpRecorder &exp_recorder, PointND<D> *points, long long length, BuildScheduler &scheduler)
+{
+    int page_size = exp_recorder.config.page_size;
+    N = length;
+    if (length <= exp_recorder.config.threshold)
+    {
+        if (exp_recorder.depth < level)
+        {
+            exp_recorder.depth = level;
+        }
+        exp_recorder.last_level_model_num++;
+        is_last = true;
+        long long side = pow(2, ceil(log(length) / log(2)));
+        order_by_curve(points, length, side);
+        width = N - 1;
+        for (long long i = 0; i < N; i++)
+        {
+            points[i].index = N == 1 ? 0 : i * 1.0 / (N - 1);
+        }
+        for (long long bn_index = 0; bn_index < length; bn_index += page_size)
+        {
+            long long end_index = bn_index + page_size > length ? length : bn_index + page_size;
+            LeafNodeND<D> leafnode;
+            leafnode.add_points(points + bn_index, points + end_index);
+            leafnodes.push_back(leafnode);
+        }
+        leaf_node_num = leafnodes.size();
+        exp_recorder.leaf_node_num += leaf_node_num;
+        net = std::make_shared<Net>(D, leaf_node_num / 2 + 2, exp_recorder.config.hidden_layer_width);
+        net->epoch = exp_recorder.config.epoch;
+        net->learning_rate = exp_recorder.config.learning_rate;
+        exp_recorder.non_leaf_node_num++;
+        scheduler.add([this, &exp_recorder, &scheduler]() { train_leaf_model(exp_recorder, scheduler); });
+        return;
+    }
+
+    is_last = false;
+    int cell_bits = 0;
+    while ((1 << cell_bits) < fanout)
+    {
+        cell_bits++;
+    }
+    width = (1 << (cell_bits * D)) - 1;
+    long long cell_size = ceil(length / pow(fanout, D));
+    TrainingStage &stage = training_stage();
+    stage.resize(N, D);
+    int cell[D];
+    long long point_index = 0;
+    label_cells(points, length, 0, cell, cell_size, cell_bits, stage, point_index);
+
+    ModelStore model_store(model_path_root);
+    int attempt = 0;
+    int thread_num = length < radix_sort::PARALLEL_THRESHOLD ? 1 : thread_utils::default_thread_num();
+    vector<int> predicted_indexes(length);
+    vector<long long> bucket_begin;
+    bool is_retrain = false;
+    do
+    {
+        net = std::make_shared<Net>(D, exp_recorder.config.hidden_layer_width, exp_recorder.config.hidden_layer_width, 1);
+        net->epoch = exp_recorder.config.epoch;
+        net->learning_rate = exp_recorder.config.learning_rate;
+        uint64_t model_key = ModelStore::key(stage.locations.data(), stage.labels.data(), N, *net, level, attempt);
+        if (model_store.load(*net, model_key))
+        {
+            exp_recorder.cached_model_num++;
+        }
+        else
+        {
+            net->train_model(stage.locations.data(), stage.labels.data(), N);
+            model_store.save(*net, model_key);
+        }
+        attempt++;
+        net->get_parameters_ND();
+
+        thread_utils::parallel_for(0, length, thread_num, [&](int, long long bn, long long en) {
+            for (long long i = bn; i < en; i++)
+            {
+                predicted_indexes[i] = predict_child(points[i]);
+            }
+        });
+        // retrain if every point falls into the same child
+        is_retrain = true;
+        for (long long i = 1; i < length && is_retrain; i++)
+        {
+            is_retrain = predicted_indexes[i] == predicted_indexes[0];
+        }
+    } while (is_retrain);
+
+    radix_sort::partition(points, length, predicted_indexes.data(), width, bucket_begin, thread_num);
+    predicted_indexes.clear();
+    predicted_indexes.shrink_to_fit();
+    exp_recorder.non_leaf_node_num++;
+
+    for (int i = 0; i < width; i++)
+    {
+        long long child_length = bucket_begin[i + 1] - bucket_begin[i];
+        if (child_length > 0)
+        {
+            RSMIND &partition = children.insert(pair<int, RSMIND>(i, RSMIND(i, level + 1, fanout))).first->second;
+            partition.build(exp_recorder, points + bucket_begin[i], child_length, scheduler);
+        }
+    }
+}
+
+template <int D>
+void RSMIND<D>::print_index_info(ExpRecorder &exp_recorder)
+{
+    cout << "dimension: " << D << " fanout: " << fanout << endl;
+    cout << "finish point_query max_error: " << exp_recorder.max_error << endl;
+    cout << "finish point_query min_error: " << exp_recorder.min_error << endl;
+    cout << "last_level_model_num: " << exp_recorder.last_level_model_num << endl;
+    cout << "leaf_node_num: " << exp_recorder.leaf_node_num << endl;
+    cout << "non_leaf_node_num: " << exp_recorder.non_leaf_node_num << endl;
+    cout << "depth: " << exp_recorder.depth << endl;
+    cout << "cached_model_num: " << exp_recorder.cached_model_num << endl;
+    cout << "models_per_second: " << exp_recorder.get_models_per_second() << endl;
+}
+
+template <int D>
+int RSMIND<D>::predict_child(const PointND<D> &point)
+{
+    int predicted_index = (int)(net->template predict_ND<D>(point.coords) * width);
+    predicted_index = predicted_index < 0 ? 0 : predicted_index;
+    return predicted_index >= width ? width - 1 : predicted_index;
+}
+
+template <int D>
+int RSMIND<D>::predict_page(const PointND<D> &point)
+{
+    int predicted_index = (int)(net->template predict_ND<D>(point.coords) * leaf_node_num);
+    predicted_index = predicted_index < 0 ? 0 : predicted_index;
+    return predicted_index >= leaf_node_num ? leaf_node_num - 1 : predicted_index;
+}
+
+template <int D>
+bool RSMIND<D>::search_page(ExpRecorder &exp_recorder, int page, const PointND<D> &query_point)
+{
+    LeafNodeND<D> &leafnode = leafnodes[page];
+    if (!leafnode.mbr.contains(query_point))
+    {
+        return false;
+    }
+    exp_recorder.page_access += 1;
+    return find(leafnode.children.begin(), leafnode.children.end(), query_point) != leafnode.children.end();
+}
+
+template <int D>
+bool RSMIND<D>::point_query(ExpRecorder &exp_recorder, const PointND<D> &query_point)
+{
+    if (!is_last)
+    {
+        auto iter = children.find(predict_child(query_point));
+        return iter != children.end() && iter->second.point_query(exp_recorder, query_point);
+    }
+    int predicted_index = predict_page(query_point);
+    int front = predicted_index + min_error < 0 ? 0 : predicted_index + min_error;
+    int back = predicted_index + max_error >= leaf_node_num ? leaf_node_num - 1 : predicted_index + max_error;
+    // pages nearest to the prediction first
+    for (int gap = 0; predicted_index - gap >= front || predicted_index + gap <= back; gap++)
+    {
+        if (predicted_index - gap >= front && search_page(exp_recorder, predicted_index - gap, query_point))
+        {
+            return true;
+        }
+        if (gap > 0 && predicted_index + gap <= back && search_page(exp_recorder, predicted_index + gap, query_point))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <int D>
+void RSMIND<D>::point_query(ExpRecorder &exp_recorder, const vector<PointND<D>> &query_points)
+{
+    long size = query_points.size();
+    for (long i = 0; i < size; i++)
+    {
+        double page_access = exp_recorder.page_access;
+        auto start = chrono::high_resolution_clock::now();
+        point_query(exp_recorder, query_points[i]);
+        auto finish = chrono::high_resolution_clock::now();
+        long long temp_time = chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
+        exp_recorder.time += temp_time;
+        exp_recorder.record(temp_time, exp_recorder.page_access - page_access);
+    }
+    exp_recorder.time /= size;
+    exp_recorder.page_access = exp_recorder.page_access / size;
+}
+
+template <int D>
+void RSMIND<D>::window_query(ExpRecorder &exp_recorder, const vector<PointND<D>> &vertexes, const MbrND<D> &query_window, vector<PointND<D>> &results)
+{
+    if (is_last)
+    {
+        if (leaf_node_num == 0)
+        {
+            return;
+        }
+        int front = 0;
+        int back = 0;
+        if (leaf_node_num > 1)
+        {
+            int min = leaf_node_num;
+            int max = 0;
+            for (const PointND<D> &vertex : vertexes)
+            {
+                int predicted_index = predict_page(vertex);
+                min = predicted_index + min_error < min ? predicted_index + min_error : min;
+                max = predicted_index + max_error > max ? predicted_index + max_error : max;
+            }
+            front = min < 0 ? 0 : min;
+            back = max >= leaf_node_num ? leaf_node_num - 1 : max;
+        }
+        for (int i = front; i <= back; i++)
+        {
+            LeafNodeND<D> &leafnode = leafnodes[i];
+            if (leafnode.mbr.interact(query_window))
+            {
+                exp_recorder.page_access += 1;
+                for (PointND<D> &point : leafnode.children)
+                {
+                    if (query_window.contains(point))
+                    {
+                        results.push_back(point);
+                    }
+                }
+            }
+        }
+        return;
+    }
+    int front = width;
+    int back = 0;
+    for (const PointND<D> &vertex : vertexes)
+    {
+        int predicted_index = predict_child(vertex);
+        front = predicted_index < front ? predicted_index : front;
+        back = predicted_index > back ? predicted_index : back;
+    }
+    for (auto iter = children.lower_bound(front); iter != children.end() && iter->first <= back; iter++)
+    {
+        if (iter->second.mbr.interact(query_window))
+        {
+            iter->second.window_query(exp_recorder, vertexes, query_window, results);
+        }
+    }
+}
+
+template <int D>
+vector<PointND<D>> RSMIND<D>::window_query(ExpRecorder &exp_recorder, const MbrND<D> &query_window)
+{
+    vector<PointND<D>> results;
+    window_query(exp_recorder, query_window.get_corner_points(), query_window, results);
+    return results;
+}
+
+template <int D>
+void RSMIND<D>::window_query(ExpRecorder &exp_recorder, const vector<MbrND<D>> &query_windows)
+{
+    int length = query_windows.size();
+    for (int i = 0; i < length; i++)
+    {
+        double page_access = exp_recorder.page_access;
+        auto start = chrono::high_resolution_clock::now();
+        exp_recorder.window_query_result_size += window_query(exp_recorder, query_windows[i]).size();
+        auto finish = chrono::high_resolution_clock::now();
+        long long temp_time = chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
+        exp_recorder.time += temp_time;
+        exp_recorder.record(temp_time, exp_recorder.page_access - page_access);
+    }
+    exp_recorder.time /= length;
+    exp_recorder.page_access = (double)exp_recorder.page_access / length;
+}
+
+template <int D>
+vector<PointND<D>> RSMIND<D>::acc_window_query(ExpRecorder &exp_recorder, const MbrND<D> &query_window)
+{
+    vector<PointND<D>> results;
+    if (is_last)
+    {
+        for (LeafNodeND<D> &leafnode : leafnodes)
+        {
+            if (leafnode.mbr.interact(query_window))
+            {
+                exp_recorder.page_access += 1;
+                for (PointND<D> &point : leafnode.children)
+                {
+                    if (query_window.contains(point))
+                    {
+                        results.push_back(point);
+                    }
+                }
+            }
+        }
+        return results;
+    }
+    for (auto &child : children)
+    {
+        if (child.second.mbr.interact(query_window))
+        {
+            vector<PointND<D>> temp_results = child.second.acc_window_query(exp_recorder, query_window);
+            results.insert(results.end(), temp_results.begin(), temp_results.end());
+        }
+    }
+    return results;
+}
+
+template <int D>
+void RSMIND<D>::acc_window_query(ExpRecorder &exp_recorder, const vector<MbrND<D>> &query_windows)
+{
+    int length = query_windows.size();
+    for (int i = 0; i < length; i++)
+    {
+        double page_access = exp_recorder.page_access;
+        auto start = chrono::high_resolution_clock::now();
+        exp_recorder.acc_window_query_qesult_size += acc_window_query(exp_recorder, query_windows[i]).size();
+        auto finish = chrono::high_resolution_clock::now();
+        long long temp_time = chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
+        exp_recorder.time += temp_time;
+        exp_recorder.record(temp_time, exp_recorder.page_access - page_access);
+    }
+    exp_recorder.time /= length;
+    exp_recorder.page_access = (double)exp_recorder.page_access / length;
+}
+
+// Window-based kNN as in RSMI: query a cube around the point, keep the candidates within the
+// cube's half side and double the side until k of them are found.
+template <int D>
+vector<PointND<D>> RSMIND<D>::kNN_query(ExpRecorder &exp_recorder, const PointND<D> &query_point, int k)
+{
+    float knnquery_side = pow((float)k / N, 1.0 / D) * 4;
+    float max_side = sqrt((float)D);
+    while (true)
+    {
+        MbrND<D> window = MbrND<D>::get_mbr(query_point, knnquery_side);
+        vector<PointND<D>> candidates;
+        for (PointND<D> &point : window_query(exp_recorder, window))
+        {
+            if (point.cal_dist(query_point) <= knnquery_side)
+            {
+                candidates.push_back(point);
+            }
+        }
+        if (candidates.size() >= k || knnquery_side > max_side)
+        {
+            int result_size = candidates.size() < k ? candidates.size() : k;
+            partial_sort(candidates.begin(), candidates.begin() + result_size, candidates.end(), [&query_point](const PointND<D> &a, const PointND<D> &b) {
+                return a.cal_dist(query_point) < b.cal_dist(query_point);
+            });
+            candidates.resize(result_size);
+            return candidates;
+        }
+        knnquery_side *= 2;
+    }
+}
+
+template <int D>
+vector<PointND<D>> RSMIND<D>::kNN_query(ExpRecorder &exp_recorder, const vector<PointND<D>> &query_points, int k)
+{
+    vector<PointND<D>> results;
+    int length = query_points.size();
+    for (int i = 0; i < length; i++)
+    {
+        double page_access = exp_recorder.page_access;
+        auto start = chrono::high_resolution_clock::now();
+        vector<PointND<D>> knn_result = kNN_query(exp_recorder, query_points[i], k);
+        auto finish = chrono::high_resolution_clock::now();
+        long long temp_time = chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
+        exp_recorder.time += temp_time;
+        exp_recorder.record(temp_time, exp_recorder.page_access - page_access);
+        results.insert(results.end(), knn_result.begin(), knn_result.end());
+    }
+    exp_recorder.time /= length;
+    exp_recorder.page_access = (double)exp_recorder.page_access / length;
+    exp_recorder.k_num = k;
+    return results;
+}
+
+template <int D>
+vector<PointND<D>> RSMIND<D>::acc_kNN_query(ExpRecorder &exp_recorder, const PointND<D> &query_point, int k)
+{
+    float knnquery_side = pow((float)k / N, 1.0 / D);
+    float max_side = sqrt((float)D);
+    while (true)
+    {
+        MbrND<D> window = MbrND<D>::get_mbr(query_point, knnquery_side);
+        vector<PointND<D>> candidates = acc_window_query(exp_recorder, window);
+        if (candidates.size() >= k || knnquery_side > max_side)
+        {
+            int result_size = candidates.size() < k ? candidates.size() : k;
+            partial_sort(candidates.begin(), candidates.begin() + result_size, candidates.end(), [&query_point](const PointND<D> &a, const PointND<D> &b) {
+                return a.cal_dist(query_point) < b.cal_dist(query_point);
+            });
+            candidates.resize(result_size);
+            if (result_size < k || candidates.back().cal_dist(query_point) <= knnquery_side || knnquery_side > max_side)
+            {
+                return candidates;
+            }
+        }
+        knnquery_side *= 2;
+    }
+}
+
+template <int D>
+vector<PointND<D>> RSMIND<D>::acc_kNN_query(ExpRecorder &exp_recorder, const vector<PointND<D>> &query_points, int k)
+{
+    vector<PointND<D>> results;
+    int length = query_points.size();
+    for (int i = 0; i < length; i++)
+    {
+        double page_access = exp_recorder.page_access;
+        auto start = chrono::high_resolution_clock::now();
+        vector<PointND<D>> knn_result = acc_kNN_query(exp_recorder, query_points[i], k);
+        auto finish = chrono::high_resolution_clock::now();
+        long long temp_time = chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
+        exp_recorder.time += temp_time;
+        exp_recorder.record(temp_time, exp_recorder.page_access - page_access);
+        results.insert(results.end(), knn_result.begin(), knn_result.end());
+    }
+    exp_recorder.time /= length;
+    exp_recorder.page_access = (double)exp_recorder.page_access / length;
+    exp_recorder.k_num = k;
+    return results;
+}
+
+#endif
@@ -0,0 +1,483 @@
+#ifndef RTREE_H
+#define RTREE_H
+
+#include <iostream>
+#include <vector>
+#include <queue>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <typeinfo>
+#include "../entities/Node.h"
+#include "../entities/Point.h"
+#include "../entities/Mbr.h"
+#include "../entities/NonLeafNode.h"
+#include "../entities/LeafNode.h"
+#include "../entities/NodeExtend.h"
+#include "../utils/ExpRecorder.h"
+#include "../utils/SortTools.h"
+using namespace std;
+
+// R-tree baseline over the entity node classes. build bulk-loads it with Sort-Tile-Recursive
+// packing (Leutenegger et al., ICDE 1997): pages of config.page_size points, and every upper
+// level packs the MBR centres of the level below the same way. kNN is best-first over a
+// priority queue of NodeExtend (sortPQ); insert descends by least area enlargement and splits
+// full nodes along their longer side. page_access counts leaf pages, as for RSMI and ZM.
+class RTree
+{
+private:
+    nodespace::Node *root = NULL;
+    int height = 0;
+    // entries per node, set from exp_recorder.config by build
+    int page_size = Constants::PAGESIZE;
+
+    static float area(Mbr mbr);
+    static float enlargement(Mbr mbr, Point point);
+    static bool is_leaf(nodespace::Node *node);
+    template <typename T>
+    static vector<vector<T>> str_pack(vector<T> items, int capacity, float (*center_x)(const T &), float (*center_y)(const T &));
+    void split(ExpRecorder &exp_recorder, nodespace::Node *node);
+    void get_memory_usage(nodespace::Node *node, memory_accounting::Usage &usage);
+
+    bool point_query(ExpRecorder &exp_recorder, nodespace::Node *node, Point query_point);
+    void window_query(ExpRecorder &exp_recorder, nodespace::Node *node, Mbr query_window, vector<Point> &results);
+
+public:
+    RTree();
+    void build(ExpRecorder &exp_recorder, vector<Point> points);
+    void print_index_info(ExpRecorder &exp_recorder);
+    // bytes of the nodes and their containers, capacity included, counted as an Account
+    // counts them: node objects and child arrays as the directory, point pages as leaf points
+    memory_accounting::Usage get_memory_usage();
+
+    bool point_query(ExpRecorder &exp_recorder, Point query_point);
+    void point_query(ExpRecorder &exp_recorder, vector<Point> query_points);
+
+    vector<Point> window_query(ExpRecorder &exp_recorder, Mbr query_window);
+    void window_query(ExpRecorder &exp_recorder, vector<Mbr> query_windows);
+
+    vector<Point> kNN_query(ExpRecorder &exp_recorder, Point query_point, int k);
+    void kNN_query(ExpRecorder &exp_recorder, vector<Point> query_points, int k);
+
+    void insert(ExpRecorder &exp_recorder, Point point);
+    void insert(ExpRecorder &exp_recorder, vector<Point> points);
+};
+
+RTree::RTree()
+{
+}
+
+float RTree::area(Mbr mbr)
+{
+    return (mbr.x2 - mbr.x1) * (mbr.y2 - mbr.y1);
+}
+
+float RTree::enlargement(Mbr mbr, Point point)
+{
+    float before = area(mbr);
+    mbr.update(point);
+    return area(mbr) - before;
+}
+
+bool RTree::is_leaf(nodespace::Node *node)
+{
+    return typeid(*node) == typeid(LeafNode);
+}
+
+// Sort-Tile-Recursive: sort by x, cut into sqrt(P) vertical slabs, sort each slab by y and cut
+// it into groups of capacity items
+template <typename T>
+vector<vector<T>> RTree::str_pack(vector<T> items, int capacity, float (*center_x)(const T &), float (*center_y)(const T &))
+{
+    long long length = items.size();
+    long long group_num = (length + capacity - 1) / capacity;
+    long long slab_num = ceil(sqrt((double)group_num));
+    long long slab_size = slab_num * capacity;
+    sort(items.begin(), items.end(), [center_x](const T &a, const T &b) { return center_x(a) < center_x(b); });
+    vector<vector<T>> groups;
+    for (long long bn_index = 0; bn_index < length; bn_index += slab_size)
+    {
+        auto bn = items.begin() + bn_index;
+        auto en = bn_index + slab_size > length ? items.end() : bn + slab_size;
+        sort(bn, en, [center_y](const T &a, const T &b) { return center_y(a) < center_y(b); });
+        for (auto group_bn = bn; group_bn < en; group_bn += min((long long)capacity, (long long)(en - group_bn)))
+        {
+            auto group_en = en - group_bn > capacity ? group_bn + capacity : en;
+            groups.push_back(vector<T>(group_bn, group_en));
+        }
+    }
+    return groups;
+}
+
+static float str_point_x(const Point &point)
+{
+    return point.x;
+}
+
+static float str_point_y(const Point &point)
+{
+    return point.y;
+}
+
+static float str_node_x(nodespace::Node *const &node)
+{
+    return (node->mbr.x1 + node->mbr.x2) / 2;
+}
+
+static float str_node_y(nodespace::Node *const &node)
+{
+    return (node->mbr.y1 + node->mbr.y2) / 2;
+}
+
+void RTree::build(ExpRecorder &exp_recorder, vector<Point> points)
+{
+    page_size = exp_recorder.config.page_size;
+    vector<nodespace::Node *> level_nodes;
+    for (vector<Point> &group : str_pack<Point>(points, page_size, str_point_x, str_point_y))
+    {
+        LeafNode *leafnode = new LeafNode();
+        leafnode->level = 0;
+        leafnode->parent = NULL;
+        leafnode->add_points(group);
+        level_nodes.push_back(leafnode);
+    }
+    exp_recorder.leaf_node_num += level_nodes.size();
+    height = 1;
+    while (level_nodes.size() > 1)
+    {
+        vector<nodespace::Node *> upper_nodes;
+        for (vector<nodespace::Node *> &group : str_pack<nodespace::Node *>(level_nodes, page_size, str_node_x, str_node_y))
+        {
+            NonLeafNode *node = new NonLeafNode();
+            node->level = height;
+            node->parent = NULL;
+            node->addNodes(group);
+            upper_nodes.push_back(node);
+        }
+        exp_recorder.non_leaf_node_num += upper_nodes.size();
+        level_nodes.swap(upper_nodes);
+        height++;
+    }
+    root = level_nodes.empty() ? NULL : level_nodes[0];
+    exp_recorder.depth = height;
+}
+
+void RTree::print_index_info(ExpRecorder &exp_recorder)
+{
+    cout << "leaf_node_num: " << exp_recorder.leaf_node_num << endl;
+    cout << "non_leaf_node_num: " << exp_recorder.non_leaf_node_num << endl;
+    cout << "depth: " << exp_recorder.depth << endl;
+}
+
+void RTree::get_memory_usage(nodespace::Node *node, memory_accounting::Usage &usage)
+{
+    if (is_leaf(node))
+    {
+        LeafNode *leafnode = dynamic_cast<LeafNode *>(node);
+        usage.bytes[memory_accounting::DIRECTORY] += sizeof(LeafNode);
+        usage.allocations[memory_accounting::DIRECTORY]++;
+        usage.bytes[memory_accounting::LEAF_POINTS] += sizeof(PointPage) + leafnode->children->capacity() * sizeof(Point);
+        usage.allocations[memory_accounting::LEAF_POINTS] += leafnode->children->capacity() > 0 ? 2 : 1;
+        return;
+    }
+    NonLeafNode *nonleafnode = dynamic_cast<NonLeafNode *>(node);
+    usage.bytes[memory_accounting::DIRECTORY] += sizeof(NonLeafNode) + sizeof(vector<nodespace::Node *>) + nonleafnode->children->capacity() * sizeof(nodespace::Node *);
+    usage.allocations[memory_accounting::DIRECTORY] += nonleafnode->children->capacity() > 0 ? 3 : 2;
+    for (nodespace::Node *child : *(nonleafnode->children))
+    {
+        get_memory_usage(child, usage);
+    }
+}
+
+memory_accounting::Usage RTree::get_memory_usage()
+{
+    memory_accounting::Usage usage;
+    if (root != NULL)
+    {
+        get_memory_usage(root, usage);
+    }
+    // measured from the tree as it is, so the peaks are the current sizes
+    for (int c = 0; c < memory_accounting::COMPONENT_NUM; c++)
+    {
+        usage.peak_bytes[c] = usage.bytes[c];
+    }
+    return usage;
+}
+
+bool RTree::point_query(ExpRecorder &exp_recorder, nodespace::Node *node, Point query_point)
+{
+    if (!node->mbr.contains(query_point))
+    {
+        return false;
+    }
+    if (is_leaf(node))
+    {
+        LeafNode *leafnode = dynamic_cast<LeafNode *>(node);
+        exp_recorder.page_access += 1;
+        return find(leafnode->children->begin(), leafnode->children->end(), query_point) != leafnode->children->end();
+    }
+    NonLeafNode *nonleafnode = dynamic_cast<NonLeafNode *>(node);
+    for (nodespace::Node *child : *(nonleafnode->children))
+    {
+        if (point_query(exp_recorder, child, query_point))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool RTree::point_query(ExpRecorder &exp_recorder, Point query_point)
+{
+    return root != NULL && point_query(exp_recorder, root, query_point);
+}
+
+void RTree::point_query(ExpRecorder &exp_recorder, vector<Point> query_points)
+{
+    long size = query_points.size();
+    for (long i = 0; i < size; i++)
+    {
+        double page_access = exp_recorder.page_access;
+        auto start = chrono::high_resolution_clock::now();
+        point_query(exp_recorder, query_points[i]);
+        auto finish = chrono::high_resolution_clock::now();
+        long long temp_time = chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
+        exp_recorder.time += temp_time;
+        exp_recorder.record(temp_time, exp_recorder.page_access - page_access);
+    }
+    exp_recorder.time /= size;
+    exp_recorder.page_access = exp_recorder.page_access / size;
+}
+
+void RTree::window_query(ExpRecorder &exp_recorder, nodespace::Node *node, Mbr query_window, vector<Point> &results)
+{
+    if (!node->mbr.interact(query_window))
+    {
+        return;
+    }
+    if (is_leaf(node))
+    {
+        LeafNode *leafnode = dynamic_cast<LeafNode *>(node);
+        exp_recorder.page_access += 1;
+        for (Point point : *(leafnode->children))
+        {
+            if (query_window.contains(point))
+            {
+                results.push_back(point);
+            }
+        }
+        return;
+    }
+    NonLeafNode *nonleafnode = dynamic_cast<NonLeafNode *>(node);
+    for (nodespace::Node *child : *(nonleafnode->children))
+    {
+        window_query(exp_recorder, child, query_window, results);
+    }
+}
+
+vector<Point> RTree::window_query(ExpRecorder &exp_recorder, Mbr query_window)
+{
+    vector<Point> results;
+    if (root != NULL)
+    {
+        window_query(exp_recorder, root, query_window, results);
+    }
+    return results;
+}
+
+void RTree::window_query(ExpRecorder &exp_recorder, vector<Mbr> query_windows)
+{
+    int length = query_windows.size();
+    for (int i = 0; i < length; i++)
+    {
+        double page_access = exp_recorder.page_access;
+        auto start = chrono::high_resolution_clock::now();
+        exp_recorder.window_query_result_size += window_query(exp_recorder, query_windows[i]).size();
+        auto finish = chrono::high_resolution_clock::now();
+        long long temp_time = chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
+        exp_recorder.time += temp_time;
+        exp_recorder.record(temp_time, exp_recorder.page_access - page_access);
+    }
+    exp_recorder.time /= length;
+    exp_recorder.page_access = (double)exp_recorder.page_access / length;
+}
+
+// best-first search: nodes and points share one queue ordered by distance, so the first k
+// points popped are the k nearest
+vector<Point> RTree::kNN_query(ExpRecorder &exp_recorder, Point query_point, int k)
+{
+    vector<Point> result;
+    if (root == NULL)
+    {
+        return result;
+    }
+    priority_queue<NodeExtend *, vector<NodeExtend *>, sortPQ> pq;
+    pq.push(new NodeExtend(root, root->cal_dist(query_point)));
+    while (!pq.empty() && result.size() < k)
+    {
+        NodeExtend *top = pq.top();
+        pq.pop();
+        if (top->node == NULL)
+        {
+            result.push_back(top->point);
+        }
+        else if (is_leaf(top->node))
+        {
+            LeafNode *leafnode = dynamic_cast<LeafNode *>(top->node);
+            exp_recorder.page_access += 1;
+            for (Point point : *(leafnode->children))
+            {
+                // Point::cal_dist caches its result, drop any distance left from another query
+                point.temp_dist = 0;
+                pq.push(new NodeExtend(point, point.cal_dist(query_point)));
+            }
+        }
+        else
+        {
+            NonLeafNode *nonleafnode = dynamic_cast<NonLeafNode *>(top->node);
+            for (nodespace::Node *child : *(nonleafnode->children))
+            {
+                pq.push(new NodeExtend(child, child->cal_dist(query_point)));
+            }
+        }
+        delete top;
+    }
+    while (!pq.empty())
+    {
+        delete pq.top();
+        pq.pop();
+    }
+    return result;
+}
+
+void RTree::kNN_query(ExpRecorder &exp_recorder, vector<Point> query_points, int k)
+{
+    int length = query_points.size();
+    exp_recorder.time = 0;
+    exp_recorder.page_access = 0;
+    for (int i = 0; i < length; i++)
+    {
+        double page_access = exp_recorder.page_access;
+        auto start = chrono::high_resolution_clock::now();
+        vector<Point> knn_result = kNN_query(exp_recorder, query_points[i], k);
+        auto finish = chrono::high_resolution_clock::now();
+        long long temp_time = chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
+        exp_recorder.time += temp_time;
+        exp_recorder.record(temp_time, exp_recorder.page_access - page_access);
+        exp_recorder.knn_query_results.insert(exp_recorder.knn_query_results.end(), knn_result.begin(), knn_result.end());
+    }
+    exp_recorder.time /= length;
+    exp_recorder.page_access = (double)exp_recorder.page_access / length;
+    exp_recorder.k_num = k;
+}
+
+// splits a full node in half along the longer side of its MBR and hands the right half to the
+// parent, splitting upwards and growing a new root when needed
+void RTree::split(ExpRecorder &exp_recorder, nodespace::Node *node)
+{
+    bool by_x = node->mbr.x2 - node->mbr.x1 >= node->mbr.y2 - node->mbr.y1;
+    nodespace::Node *right = NULL;
+    NonLeafNode *parent = NULL;
+    if (is_leaf(node))
+    {
+        LeafNode *leafnode = dynamic_cast<LeafNode *>(node);
+        sort(leafnode->children->begin(), leafnode->children->end(), [by_x](const Point &a, const Point &b) { return by_x ? a.x < b.x : a.y < b.y; });
+        LeafNode *right_leaf = leafnode->split(page_size);
+        leafnode->mbr = Mbr();
+        for (Point point : *(leafnode->children))
+        {
+            leafnode->mbr.update(point);
+        }
+        right_leaf->level = 0;
+        right = right_leaf;
+        parent = leafnode->parent;
+        exp_recorder.leaf_node_num++;
+    }
+    else
+    {
+        NonLeafNode *nonleafnode = dynamic_cast<NonLeafNode *>(node);
+        sort(nonleafnode->children->begin(), nonleafnode->children->end(), [by_x](nodespace::Node *a, nodespace::Node *b) { return by_x ? str_node_x(a) < str_node_x(b) : str_node_y(a) < str_node_y(b); });
+        NonLeafNode *right_node = nonleafnode->split(page_size);
+        nonleafnode->mbr = Mbr();
+        for (nodespace::Node *child : *(nonleafnode->children))
+        {
+            nonleafnode->mbr.update(child->mbr);
+        }
+        right_node->level = nonleafnode->level;
+        right = right_node;
+        parent = nonleafnode->parent;
+        exp_recorder.non_leaf_node_num++;
+    }
+    if (parent == NULL)
+    {
+        NonLeafNode *new_root = new NonLeafNode();
+        new_root->level = height;
+        new_root->parent = NULL;
+        new_root->addNode(node);
+        new_root->addNode(right);
+        root = new_root;
+        height++;
+        exp_recorder.non_leaf_node_num++;
+        return;
+    }
+    parent->addNode(right);
+    if (parent->children->size() > (size_t)page_size)
+    {
+        split(exp_recorder, parent);
+    }
+}
+
+void RTree::insert(ExpRecorder &exp_recorder, Point point)
+{
+    if (root == NULL)
+    {
+        LeafNode *leafnode = new LeafNode();
+        leafnode->level = 0;
+        leafnode->parent = NULL;
+        root = leafnode;
+        height = 1;
+        exp_recorder.leaf_node_num++;
+    }
+    nodespace::Node *node = root;
+    while (!is_leaf(node))
+    {
+        node->mbr.update(point);
+        NonLeafNode *nonleafnode = dynamic_cast<NonLeafNode *>(node);
+        nodespace::Node *best = NULL;
+        float best_enlargement = 0;
+        for (nodespace::Node *child : *(nonleafnode->children))
+        {
+            float child_enlargement = enlargement(child->mbr, point);
+            if (best == NULL || child_enlargement < best_enlargement || (child_enlargement == best_enlargement && area(child->mbr) < area(best->mbr)))
+            {
+                best = child;
+                best_enlargement = child_enlargement;
+            }
+        }
+        node = best;
+    }
+    LeafNode *leafnode = dynamic_cast<LeafNode *>(node);
+    leafnode->add_point(point);
+    if (leafnode->children->size() > (size_t)page_size)
+    {
+        split(exp_recorder, leafnode);
+    }
+}
+
+void RTree::insert(ExpRecorder &exp_recorder, vector<Point> points)
+{
+    long long time_cost = 0;
+    for (Point point : points)
+    {
+        double page_access = exp_recorder.page_access;
+        auto start = chrono::high_resolution_clock::now();
+        insert(exp_recorder, point);
+        auto finish = chrono::high_resolution_clock::now();
+        long long temp_time = chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
+        time_cost += temp_time;
+        exp_recorder.record(temp_time, exp_recorder.page_access - page_access);
+    }
+    exp_recorder.insert_time = time_cost / exp_recorder.insert_num;
+}
+
+#endif
@@ -0,0 +1,511 @@
+#ifndef ZM_H
+#define ZM_H
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include "../entities/Point.h"
+#include "../entities/Mbr.h"
+#include "../entities/LeafNode.h"
+#include "../utils/ExpRecorder.h"
+#include "../utils/SortTools.h"
+#include "../utils/ModelTools.h"
+#include "../utils/ModelStore.h"
+#include "../utils/BuildScheduler.h"
+#include "../utils/RadixSort.h"
+#include "../curves/z.H"
+using namespace std;
+
+// ZM-index: points are mapped to the Z value of their grid cell, sorted by it and cut into
+// pages; a two-stage recursive model over the 1-D key (one root model routing to
+// stage_num last-stage models) predicts the position of a key. Leaf pages, ExpRecorder
+// accounting, model store and parallel training of the last stage are shared with RSMI.
+class ZM
+{
+private:
+    // bits per dimension of the Z grid; 2 * BIT_NUM bits keep keys exact in a float
+    static const int BIT_NUM = 12;
+
+    long long N = 0;
+    // points per page, RSMIConfig::page_size of the recorder given to build
+    int page_size = Constants::PAGESIZE;
+    int page_num = 0;
+    int stage_num = 0;
+    std::shared_ptr<Net> root_net;
+    vector<std::shared_ptr<Net>> nets;
+    vector<int> max_errors;
+    vector<int> min_errors;
+    // last-stage model used for keys routed to each model; empty models borrow a neighbour
+    vector<int> model_map;
+
+    float get_key(float x, float y);
+    int predict_model(float key);
+    int predict_page(float key, int &model);
+    void train_leaf_model(ExpRecorder &exp_recorder, BuildScheduler &scheduler, int model, const vector<uint32_t> &members, const vector<Point> &points);
+    bool search_page(ExpRecorder &exp_recorder, int page, Point query_point);
+
+public:
+    static string model_path_root;
+    vector<LeafNode> leafnodes;
+
+    ZM();
+    void build(ExpRecorder &exp_recorder, vector<Point> points);
+    void print_index_info(ExpRecorder &exp_recorder);
+
+    bool point_query(ExpRecorder &exp_recorder, Point query_point);
+    void point_query(ExpRecorder &exp_recorder, vector<Point> query_points);
+
+    vector<Point> window_query(ExpRecorder &exp_recorder, Mbr query_window);
+    void window_query(ExpRecorder &exp_recorder, vector<Mbr> query_windows);
+    vector<Point> acc_window_query(ExpRecorder &exp_recorder, Mbr query_window);
+    void acc_window_query(ExpRecorder &exp_recorder, vector<Mbr> query_windows);
+
+    vector<Point> kNN_query(ExpRecorder &exp_recorder, Point query_point, int k);
+    void kNN_query(ExpRecorder &exp_recorder, vector<Point> query_points, int k);
+    vector<Point> acc_kNN_query(ExpRecorder &exp_recorder, Point query_point, int k);
+    void acc_kNN_query(ExpRecorder &exp_recorder, vector<Point> query_points, int k);
+};
+
+ZM::ZM()
+{
+}
+
+float ZM::get_key(float x, float y)
+{
+    long long side = 1LL << BIT_NUM;
+    long long x_i = (long long)(x * side);
+    long long y_i = (long long)(y * side);
+    x_i = x_i < 0 ? 0 : (x_i >= side ? side - 1 : x_i);
+    y_i = y_i < 0 ? 0 : (y_i >= side ? side - 1 : y_i);
+    return compute_Z_value(x_i, y_i) * 1.0 / ((1LL << (2 * BIT_NUM)) - 1);
+}
+
+int ZM::predict_model(float key)
+{
+    int model = (int)(root_net->predict_ZM(key) * stage_num);
+    model = model < 0 ? 0 : model;
+    model = model >= stage_num ? stage_num - 1 : model;
+    return model_map[model];
+}
+
+int ZM::predict_page(float key, int &model)
+{
+    model = predict_model(key);
+    int page = (int)(nets[model]->predict_ZM(key) * page_num);
+    page = page < 0 ? 0 : page;
+    return page >= page_num ? page_num - 1 : page;
+}
+
+void ZM::build(ExpRecorder &exp_recorder, vector<Point> points)
+{
+    page_size = exp_recorder.config.page_size;
+    N = points.size();
+    page_num = (N + page_size - 1) / page_size;
+    stage_num = (N + exp_recorder.config.threshold - 1) / exp_recorder.config.threshold;
+    stage_num = stage_num < 1 ? 1 : stage_num;
+
+    // order by key
+    int thread_num = thread_utils::default_thread_num();
+    vector<radix_sort::KeyIndex<uint32_t>> keys(N);
+    for (long long i = 0; i < N; i++)
+    {
+        points[i].normalized_curve_val = get_key(points[i].x, points[i].y);
+        keys[i].key = radix_sort::float_key(points[i].normalized_curve_val);
+        keys[i].index = i;
+    }
+    radix_sort::sort(keys, thread_num);
+    vector<Point> ordered(N);
+    for (long long i = 0; i < N; i++)
+    {
+        ordered[i] = points[keys[i].index];
+        ordered[i].index = N > 1 ? i * 1.0 / (N - 1) : 0;
+    }
+    points.swap(ordered);
+    ordered.clear();
+    ordered.shrink_to_fit();
+    keys.clear();
+    keys.shrink_to_fit();
+
+    for (long long bn_index = 0; bn_index < N; bn_index += page_size)
+    {
+        auto bn = points.begin() + bn_index;
+        auto en = bn_index + page_size > N ? points.end() : bn + page_size;
+        LeafNode leafnode;
+        leafnode.add_points(vector<Point>(bn, en));
+        leafnodes.push_back(leafnode);
+    }
+    exp_recorder.leaf_node_num += page_num;
+
+    // root model over all keys
+    TrainingStage &stage = training_stage();
+    stage.resize(N, 1);
+    for (long long i = 0; i < N; i++)
+    {
+        stage.locations[i] = points[i].normalized_curve_val;
+        stage.labels[i] = points[i].index;
+    }
+    ModelStore model_store(model_path_root);
+    root_net = std::make_shared<Net>(1, exp_recorder.config.hidden_layer_width, exp_recorder.config.hidden_layer_width, 1);
+    root_net->epoch = exp_recorder.config.epoch;
+    root_net->learning_rate = exp_recorder.config.learning_rate;
+    uint64_t model_key = ModelStore::key(stage.locations.data(), stage.labels.data(), N, *root_net, 0, 0);
+    if (model_store.load(*root_net, model_key))
+    {
+        exp_recorder.cached_model_num++;
+    }
+    else
+    {
+        root_net->train_model(stage.locations.data(), stage.labels.data(), N);
+        model_store.save(*root_net, model_key);
+    }
+    root_net->get_parameters_ZM();
+    exp_recorder.non_leaf_node_num++;
+
+    // route every point to a last-stage model and train those models in parallel
+    model_map.resize(stage_num);
+    for (int i = 0; i < stage_num; i++)
+    {
+        model_map[i] = i;
+    }
+    vector<vector<uint32_t>> members(stage_num);
+    for (long long i = 0; i < N; i++)
+    {
+        members[predict_model(points[i].normalized_curve_val)].push_back(i);
+    }
+    nets.resize(stage_num);
+    max_errors.assign(stage_num, 0);
+    min_errors.assign(stage_num, 0);
+    BuildScheduler scheduler;
+    for (int i = 0; i < stage_num; i++)
+    {
+        if (members[i].empty())
+        {
+            continue;
+        }
+        nets[i] = std::make_shared<Net>(1, exp_recorder.config.hidden_layer_width, exp_recorder.config.hidden_layer_width, 1);
+        nets[i]->epoch = exp_recorder.config.epoch;
+        nets[i]->learning_rate = exp_recorder.config.learning_rate;
+        exp_recorder.last_level_model_num++;
+        exp_recorder.non_leaf_node_num++;
+        scheduler.add([this, &exp_recorder, &scheduler, &members, &points, i]() { train_leaf_model(exp_recorder, scheduler, i, members[i], points); });
+    }
+    scheduler.run();
+    exp_recorder.leaf_training_time += scheduler.time;
+    exp_recorder.trained_leaf_model_num += scheduler.size();
+    exp_recorder.depth = 1;
+
+    int last = -1;
+    for (int i = 0; i < stage_num; i++)
+    {
+        if (nets[i])
+        {
+            last = i;
+        }
+        model_map[i] = last;
+    }
+    for (int i = stage_num - 1; i >= 0; i--)
+    {
+        if (nets[i])
+        {
+            last = i;
+        }
+        if (model_map[i] < 0)
+        {
+            model_map[i] = last;
+        }
+    }
+}
+
+void ZM::train_leaf_model(ExpRecorder &exp_recorder, BuildScheduler &scheduler, int model, const vector<uint32_t> &members, const vector<Point> &points)
+{
+    long long length = members.size();
+    TrainingStage &stage = training_stage();
+    stage.resize(length, 1);
+    for (long long i = 0; i < length; i++)
+    {
+        stage.locations[i] = points[members[i]].normalized_curve_val;
+        stage.labels[i] = points[members[i]].index;
+    }
+    Net &net = *nets[model];
+    ModelStore model_store(model_path_root);
+    uint64_t model_key = ModelStore::key(stage.locations.data(), stage.labels.data(), length, net, 1, 0);
+    bool is_cached = model_store.load(net, model_key);
+    if (!is_cached)
+    {
+        net.train_model(stage.locations.data(), stage.labels.data(), length);
+        model_store.save(net, model_key);
+    }
+    net.get_parameters_ZM();
+
+    int max_error = 0;
+    int min_error = 0;
+    for (long long i = 0; i < length; i++)
+    {
+        int predicted_page = (int)(net.predict_ZM(stage.locations[i]) * page_num);
+        predicted_page = predicted_page < 0 ? 0 : (predicted_page >= page_num ? page_num - 1 : predicted_page);
+        int error = members[i] / page_size - predicted_page;
+        max_error = error > max_error ? error : max_error;
+        min_error = error < min_error ? error : min_error;
+    }
+    max_errors[model] = max_error;
+    min_errors[model] = min_error;
+
+    lock_guard<mutex> guard(scheduler.lock());
+    if (is_cached)
+    {
+        exp_recorder.cached_model_num++;
+    }
+    exp_recorder.total_max_error += max_error;
+    exp_recorder.total_min_error += min_error;
+    if ((max_error - min_error) > (exp_recorder.max_error - exp_recorder.min_error))
+    {
+        exp_recorder.max_error = max_error;
+        exp_recorder.min_error = min_error;
+    }
+}
+
+void ZM::print_index_info(ExpRecorder &exp_recorder)
+{
+    cout << "finish point_query max_error: " << exp_recorder.max_error << endl;
+    cout << "finish point_query min_error: " << exp_recorder.min_error << endl;
+    cout << "last_level_model_num: " << exp_recorder.last_level_model_num << endl;
+    cout << "leaf_node_num: " << exp_recorder.leaf_node_num << endl;
+    cout << "cached_model_num: " << exp_recorder.cached_model_num << endl;
+    cout << "models_per_second: " << exp_recorder.get_models_per_second() << endl;
+}
+
+bool ZM::search_page(ExpRecorder &exp_recorder, int page, Point query_point)
+{
+    LeafNode &leafnode = leafnodes[page];
+    if (!leafnode.mbr.contains(query_point))
+    {
+        return false;
+    }
+    exp_recorder.page_access += 1;
+    return find(leafnode.children->begin(), leafnode.children->end(), query_point) != leafnode.children->end();
+}
+
+bool ZM::point_query(ExpRecorder &exp_recorder, Point query_point)
+{
+    int model = 0;
+    int predicted_page = predict_page(get_key(query_point.x, query_point.y), model);
+    int front = predicted_page + min_errors[model] < 0 ? 0 : predicted_page + min_errors[model];
+    int back = predicted_page + max_errors[model] >= page_num ? page_num - 1 : predicted_page + max_errors[model];
+    // pages nearest to the prediction first
+    for (int gap = 0; predicted_page - gap >= front || predicted_page + gap <= back; gap++)
+    {
+        if (predicted_page - gap >= front && search_page(exp_recorder, predicted_page - gap, query_point))
+        {
+            return true;
+        }
+        if (gap > 0 && predicted_page + gap <= back && search_page(exp_recorder, predicted_page + gap, query_point))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ZM::point_query(ExpRecorder &exp_recorder, vector<Point> query_points)
+{
+    long size = query_points.size();
+    exp_recorder.time = 0;
+    exp_recorder.page_access = 0;
+    for (long i = 0; i < size; i++)
+    {
+        double page_access = exp_recorder.page_access;
+        auto start = chrono::high_resolution_clock::now();
+        point_query(exp_recorder, query_points[i]);
+        auto finish = chrono::high_resolution_clock::now();
+        long long temp_time = chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
+        exp_recorder.time += temp_time;
+        exp_recorder.record(temp_time, exp_recorder.page_access - page_access);
+    }
+    exp_recorder.time /= size;
+    exp_recorder.page_access = exp_recorder.page_access / size;
+}
+
+// every point of the window lies between the keys of its lower-left and upper-right corners
+vector<Point> ZM::window_query(ExpRecorder &exp_recorder, Mbr query_window)
+{
+    vector<Point> results;
+    int low_model = 0;
+    int high_model = 0;
+    int low_page = predict_page(get_key(query_window.x1, query_window.y1), low_model);
+    int high_page = predict_page(get_key(query_window.x2, query_window.y2), high_model);
+    int front = min(low_page + min_errors[low_model], high_page + min_errors[high_model]);
+    int back = max(low_page + max_errors[low_model], high_page + max_errors[high_model]);
+    front = front < 0 ? 0 : front;
+    back = back >= page_num ? page_num - 1 : back;
+    for (int i = front; i <= back; i++)
+    {
+        LeafNode &leafnode = leafnodes[i];
+        if (leafnode.mbr.interact(query_window))
+        {
+            exp_recorder.page_access += 1;
+            for (Point point : (*leafnode.children))
+            {
+                if (query_window.contains(point))
+                {
+                    results.push_back(point);
+                }
+            }
+        }
+    }
+    return results;
+}
+
+void ZM::window_query(ExpRecorder &exp_recorder, vector<Mbr> query_windows)
+{
+    int length = query_windows.size();
+    exp_recorder.time = 0;
+    exp_recorder.page_access = 0;
+    for (int i = 0; i < length; i++)
+    {
+        double page_access = exp_recorder.page_access;
+        auto start = chrono::high_resolution_clock::now();
+        exp_recorder.window_query_result_size += window_query(exp_recorder, query_windows[i]).size();
+        auto finish = chrono::high_resolution_clock::now();
+        long long temp_time = chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
+        exp_recorder.time += temp_time;
+        exp_recorder.record(temp_time, exp_recorder.page_access - page_access);
+    }
+    exp_recorder.time /= length;
+    exp_recorder.page_access = (double)exp_recorder.page_access / length;
+}
+
+vector<Point> ZM::acc_window_query(ExpRecorder &exp_recorder, Mbr query_window)
+{
+    vector<Point> results;
+    for (LeafNode &leafnode : leafnodes)
+    {
+        if (leafnode.mbr.interact(query_window))
+        {
+            exp_recorder.page_access += 1;
+            for (Point point : (*leafnode.children))
+            {
+                if (query_window.contains(point))
+                {
+                    results.push_back(point);
+                }
+            }
+        }
+    }
+    return results;
+}
+
+void ZM::acc_window_query(ExpRecorder &exp_recorder, vector<Mbr> query_windows)
+{
+    int length = query_windows.size();
+    exp_recorder.time = 0;
+    exp_recorder.page_access = 0;
+    for (int i = 0; i < length; i++)
+    {
+        double page_access = exp_recorder.page_access;
+        auto start = chrono::high_resolution_clock::now();
+        exp_recorder.acc_window_query_qesult_size += acc_window_query(exp_recorder, query_windows[i]).size();
+        auto finish = chrono::high_resolution_clock::now();
+        long long temp_time = chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
+        exp_recorder.time += temp_time;
+        exp_recorder.record(temp_time, exp_recorder.page_access - page_access);
+    }
+    exp_recorder.time /= length;
+    exp_recorder.page_access = (double)exp_recorder.page_access / length;
+}
+
+// window-based kNN as in RSMI: double the window until it holds k points within its half side
+vector<Point> ZM::kNN_query(ExpRecorder &exp_recorder, Point query_point, int k)
+{
+    float knnquery_side = sqrt((float)k / N) * 4;
+    while (true)
+    {
+        Mbr mbr = Mbr::get_mbr(query_point, knnquery_side);
+        vector<Point> candidates;
+        for (Point point : window_query(exp_recorder, mbr))
+        {
+            if (point.cal_dist(query_point) <= knnquery_side)
+            {
+                candidates.push_back(point);
+            }
+        }
+        if (candidates.size() >= k || knnquery_side > 2)
+        {
+            int result_size = candidates.size() < k ? candidates.size() : k;
+            partial_sort(candidates.begin(), candidates.begin() + result_size, candidates.end(), sortForKNN(query_point));
+            candidates.resize(result_size);
+            return candidates;
+        }
+        knnquery_side *= 2;
+    }
+}
+
+void ZM::kNN_query(ExpRecorder &exp_recorder, vector<Point> query_points, int k)
+{
+    int length = query_points.size();
+    exp_recorder.time = 0;
+    exp_recorder.page_access = 0;
+    for (int i = 0; i < length; i++)
+    {
+        double page_access = exp_recorder.page_access;
+        auto start = chrono::high_resolution_clock::now();
+        vector<Point> knn_result = kNN_query(exp_recorder, query_points[i], k);
+        auto finish = chrono::high_resolution_clock::now();
+        long long temp_time = chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
+        exp_recorder.time += temp_time;
+        exp_recorder.record(temp_time, exp_recorder.page_access - page_access);
+        exp_recorder.knn_query_results.insert(exp_recorder.knn_query_results.end(), knn_result.begin(), knn_result.end());
+    }
+    exp_recorder.time /= length;
+    exp_recorder.page_access = (double)exp_recorder.page_access / length;
+    exp_recorder.k_num = k;
+}
+
+vector<Point> ZM::acc_kNN_query(ExpRecorder &exp_recorder, Point query_point, int k)
+{
+    float knnquery_side = sqrt((float)k / N);
+    while (true)
+    {
+        Mbr mbr = Mbr::get_mbr(query_point, knnquery_side);
+        vector<Point> candidates = acc_window_query(exp_recorder, mbr);
+        if (candidates.size() >= k)
+        {
+            sort(candidates.begin(), candidates.end(), sortForKNN(query_point));
+            if (candidates[k - 1].cal_dist(query_point) <= knnquery_side)
+            {
+                candidates.resize(k);
+                return candidates;
+            }
+        }
+        if (knnquery_side > 2)
+        {
+            sort(candidates.begin(), candidates.end(), sortForKNN(query_point));
+            return candidates;
+        }
+        knnquery_side *= 2;
+    }
+}
+
+void ZM::acc_kNN_query(ExpRecorder &exp_recorder, vector<Point> query_points, int k)
+{
+    int length = query_points.size();
+    exp_recorder.time = 0;
+    exp_recorder.page_access = 0;
+    for (int i = 0; i < length; i++)
+    {
+        double page_access = exp_recorder.page_access;
+        auto start = chrono::high_resolution_clock::now();
+        vector<Point> knn_result = acc_kNN_query(exp_recorder, query_points[i], k);
+        auto finish = chrono::high_resolution_clock::now();
+        long long temp_time = chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
+        exp_recorder.time += temp_time;
+        exp_recorder.record(temp_time, exp_recorder.page_access - page_access);
+        exp_recorder.acc_knn_query_results.insert(exp_recorder.acc_knn_query_results.end(), knn_result.begin(), knn_result.end());
+    }
+    exp_recorder.time /= length;
+    exp_recorder.k_num = k;
+    exp_recorder.page_access = (double)exp_recorder.page_access / length;
+}
+
+#endif
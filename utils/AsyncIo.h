@@ -0,0 +1,282 @@
+#ifndef ASYNCIO_H
+#define ASYNCIO_H
+
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#ifdef __linux__
+#include <linux/io_uring.h>
+#endif
+
+using namespace std;
+
+// Batches of positioned reads through io_uring, set up with the raw system calls, so many reads
+// are in flight at once and are handed back as they complete. A Ring falls back to pread, one
+// read at a time as it is queued, when io_uring is missing (older kernels, seccomp-filtered
+// containers, io_uring_disabled); is_async tells which path it took.
+namespace async_io
+{
+    struct Completion
+    {
+        unsigned long long user_data;
+        // bytes read or -errno
+        int result;
+    };
+
+    // Not thread-safe.
+    class Ring
+    {
+    public:
+        // room for entries reads in flight; use_uring false takes the pread path
+        Ring(unsigned entries, bool use_uring = true)
+        {
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+            if (!use_uring)
+            {
+                return;
+            }
+            io_uring_params params;
+            memset(&params, 0, sizeof(params));
+            ring_fd = syscall(__NR_io_uring_setup, entries, &params);
+            if (ring_fd < 0)
+            {
+                ring_fd = -1;
+                return;
+            }
+            sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            // kernels with IORING_FEAT_SINGLE_MMAP map both rings at once
+            if (params.features & IORING_FEAT_SINGLE_MMAP)
+            {
+                sq_ring_size = cq_ring_size = sq_ring_size > cq_ring_size ? sq_ring_size : cq_ring_size;
+            }
+            sq_ring = mmap(NULL, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+            cq_ring = params.features & IORING_FEAT_SINGLE_MMAP ? sq_ring : mmap(NULL, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+            sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+            sqes = (io_uring_sqe *)mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+            if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes == MAP_FAILED)
+            {
+                unmap();
+                return;
+            }
+            char *sq = (char *)sq_ring;
+            sq_head = (unsigned *)(sq + params.sq_off.head);
+            sq_tail = (unsigned *)(sq + params.sq_off.tail);
+            sq_mask = *(unsigned *)(sq + params.sq_off.ring_mask);
+            sq_array = (unsigned *)(sq + params.sq_off.array);
+            char *cq = (char *)cq_ring;
+            cq_head = (unsigned *)(cq + params.cq_off.head);
+            cq_tail = (unsigned *)(cq + params.cq_off.tail);
+            cq_mask = *(unsigned *)(cq + params.cq_off.ring_mask);
+            cqes = (io_uring_cqe *)(cq + params.cq_off.cqes);
+            sq_entries = params.sq_entries;
+            cq_entries = params.cq_entries;
+#endif
+        }
+
+        Ring(const Ring &) = delete;
+        Ring &operator=(const Ring &) = delete;
+
+        ~Ring()
+        {
+            unmap();
+        }
+
+        bool is_async() const
+        {
+            return ring_fd >= 0;
+        }
+
+        // queues a read of length bytes of fd at offset into buffer; with every entry in flight
+        // it first waits for completions, which the next wait hands back
+        void read(int fd, void *buffer, unsigned length, long long offset, unsigned long long user_data)
+        {
+            if (!is_async())
+            {
+                reaped.push_back({user_data, pread_fully(fd, buffer, length, offset)});
+                return;
+            }
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+            while (in_flight >= cq_entries)
+            {
+                reap(true);
+            }
+            unsigned tail = *sq_tail;
+            if (tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries)
+            {
+                submit();
+                tail = *sq_tail;
+            }
+            unsigned index = tail & sq_mask;
+            io_uring_sqe *sqe = &sqes[index];
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = fd;
+            sqe->addr = (unsigned long long)buffer;
+            sqe->len = length;
+            sqe->off = offset;
+            sqe->user_data = user_data;
+            sq_array[index] = index;
+            __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+            queued++;
+            in_flight++;
+#endif
+        }
+
+        // hands queued reads to the kernel
+        void submit()
+        {
+            while (is_async() && queued > 0)
+            {
+                int submitted = enter(queued, 0, 0);
+                if (submitted < 0 && (errno == EAGAIN || errno == EBUSY))
+                {
+                    // the kernel wants completions reaped first
+                    reap(true);
+                    continue;
+                }
+                if (submitted < 0)
+                {
+                    throw runtime_error(string("io_uring_enter: ") + strerror(errno));
+                }
+                queued -= submitted;
+            }
+        }
+
+        // submits queued reads, waits until at least one has completed and moves every completed
+        // read to completions; returns false with nothing in flight
+        bool wait(vector<Completion> &completions)
+        {
+            submit();
+            if (reaped.empty() && in_flight > 0)
+            {
+                reap(true);
+            }
+            if (reaped.empty())
+            {
+                return false;
+            }
+            completions.insert(completions.end(), reaped.begin(), reaped.end());
+            reaped.clear();
+            return true;
+        }
+
+    private:
+        int ring_fd = -1;
+        void *sq_ring = MAP_FAILED;
+        void *cq_ring = MAP_FAILED;
+        size_t sq_ring_size = 0;
+        size_t cq_ring_size = 0;
+        size_t sqes_size = 0;
+        unsigned *sq_head = NULL;
+        unsigned *sq_tail = NULL;
+        unsigned *sq_array = NULL;
+        unsigned sq_mask = 0;
+        unsigned *cq_head = NULL;
+        unsigned *cq_tail = NULL;
+        unsigned cq_mask = 0;
+        unsigned sq_entries = 0;
+        unsigned cq_entries = 0;
+        unsigned queued = 0;
+        unsigned in_flight = 0;
+        vector<Completion> reaped;
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+        io_uring_sqe *sqes = (io_uring_sqe *)MAP_FAILED;
+        io_uring_cqe *cqes = NULL;
+#endif
+
+        static int pread_fully(int fd, void *buffer, unsigned length, long long offset)
+        {
+            unsigned done = 0;
+            while (done < length)
+            {
+                ssize_t result = pread(fd, (char *)buffer + done, length - done, offset + done);
+                if (result < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (result < 0)
+                {
+                    return -errno;
+                }
+                if (result == 0)
+                {
+                    break;
+                }
+                done += result;
+            }
+            return done;
+        }
+
+        int enter(unsigned to_submit, unsigned min_complete, unsigned flags)
+        {
+#if defined(__linux__) && defined(__NR_io_uring_enter)
+            int result = syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, NULL, 0);
+            return result < 0 && errno == EINTR ? 0 : result;
+#else
+            return -1;
+#endif
+        }
+
+        // moves completed reads to reaped, waiting for one if is_blocking and none is there
+        void reap(bool is_blocking)
+        {
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+            unsigned head = *cq_head;
+            if (is_blocking && head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+            {
+                // also submits what is queued
+                int submitted = enter(queued, 1, IORING_ENTER_GETEVENTS);
+                if (submitted < 0 && errno != EAGAIN && errno != EBUSY)
+                {
+                    throw runtime_error(string("io_uring_enter: ") + strerror(errno));
+                }
+                queued -= submitted > 0 ? submitted : 0;
+            }
+            unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+            for (; head != tail; head++)
+            {
+                io_uring_cqe *cqe = &cqes[head & cq_mask];
+                reaped.push_back({cqe->user_data, cqe->res});
+                in_flight--;
+            }
+            __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+#endif
+        }
+
+        void unmap()
+        {
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+            if (sqes != MAP_FAILED)
+            {
+                munmap(sqes, sqes_size);
+            }
+#endif
+            if (cq_ring != MAP_FAILED && cq_ring != sq_ring)
+            {
+                munmap(cq_ring, cq_ring_size);
+            }
+            if (sq_ring != MAP_FAILED)
+            {
+                munmap(sq_ring, sq_ring_size);
+            }
+            if (ring_fd >= 0)
+            {
+                close(ring_fd);
+            }
+            ring_fd = -1;
+            sq_ring = cq_ring = MAP_FAILED;
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+            sqes = (io_uring_sqe *)MAP_FAILED;
+#endif
+        }
+    };
+};
+
+#endif
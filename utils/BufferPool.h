@@ -0,0 +1,780 @@
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "../entities/Point.h"
+#include "MemoryAccounting.h"
+#include "AsyncIo.h"
+
+using namespace std;
+
+// Disk-resident leaf pages (RSMIConfig::page_file): models and the directory stay in memory and
+// every leaf page is a fixed-size page of a file, read through a BufferPool of frames replaced
+// by LRU or CLOCK. The pages of a node are written together when it is built, so the pages a
+// window query predicts are mostly consecutive in the file and prefetch reads each run of
+// missing pages with one preadv. With a batch ReadMode, queries instead hand every page they
+// predict to fetch_batch, which submits all missing pages at once through io_uring
+// (async_io::Ring) and processes pages as their reads complete.
+namespace buffer_pool
+{
+    enum Policy
+    {
+        LRU = 0,
+        CLOCK,
+        POLICY_NUM
+    };
+
+    const char *const POLICY_NAMES[POLICY_NUM] = {"lru", "clock"};
+
+    // how queries read pages: SYNC prefetches windows and probes point query pages one at a
+    // time; URING and PREAD fetch every predicted page in one batch, through io_uring (pread
+    // where it is unavailable) or through pread, for comparison
+    enum ReadMode
+    {
+        SYNC = 0,
+        URING,
+        PREAD,
+        READ_MODE_NUM
+    };
+
+    const char *const READ_MODE_NAMES[READ_MODE_NUM] = {"sync", "uring", "pread"};
+    // pages are padded to whole sectors and frames are aligned to memory pages
+    const size_t SECTOR_SIZE = 512;
+    const size_t FRAME_ALIGNMENT = 4096;
+
+    // -1 for an unknown name
+    inline int parse_policy(string name)
+    {
+        for (int policy = 0; policy < POLICY_NUM; policy++)
+        {
+            if (name == POLICY_NAMES[policy])
+            {
+                return policy;
+            }
+        }
+        return -1;
+    }
+
+    // -1 for an unknown name
+    inline int parse_read_mode(string name)
+    {
+        for (int mode = 0; mode < READ_MODE_NUM; mode++)
+        {
+            if (name == READ_MODE_NAMES[mode])
+            {
+                return mode;
+            }
+        }
+        return -1;
+    }
+
+    // page I/O of the queries recorded in an ExpRecorder
+    struct IoStats
+    {
+        // fetches served by a frame
+        long long hits = 0;
+        // pages read from the file, by fetch or by prefetch
+        long long misses = 0;
+        // read calls or io_uring reads that read them
+        long long reads = 0;
+
+        string get_self(long long operation_num) const
+        {
+            return "buffer_hits:" + to_string(hits * 1.0 / operation_num) + "\n" + "buffer_misses:" + to_string(misses * 1.0 / operation_num) + "\n" + "page_reads:" + to_string(reads * 1.0 / operation_num) + "\n";
+        }
+    };
+
+    // a leaf page in the file and in a frame: its point count and capacity, then x and y of
+    // every point; Point fields other than x and y are not kept
+    struct DiskPage
+    {
+        int32_t size;
+        int32_t capacity;
+
+        float *coordinates()
+        {
+            return (float *)(this + 1);
+        }
+
+        Point get_point(int i)
+        {
+            return Point(coordinates()[2 * i], coordinates()[2 * i + 1]);
+        }
+
+        void set_point(int i, Point point)
+        {
+            coordinates()[2 * i] = point.x;
+            coordinates()[2 * i + 1] = point.y;
+        }
+
+        static size_t get_bytes(int capacity)
+        {
+            return (sizeof(DiskPage) + capacity * 2 * sizeof(float) + SECTOR_SIZE - 1) / SECTOR_SIZE * SECTOR_SIZE;
+        }
+    };
+
+    // A file of page_bytes pages, created empty and removed when the PageFile is destroyed.
+    // Reads and writes are positioned, so they may run concurrently.
+    class PageFile
+    {
+    public:
+        PageFile(string path, size_t page_bytes) : path(path), page_bytes(page_bytes)
+        {
+            fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0)
+            {
+                throw runtime_error("page file " + path + ": " + strerror(errno));
+            }
+        }
+
+        PageFile(const PageFile &) = delete;
+        PageFile &operator=(const PageFile &) = delete;
+
+        ~PageFile()
+        {
+            close(fd);
+            unlink(path.c_str());
+        }
+
+        // id of the first of page_num new consecutive pages
+        long long allocate(long long page_num)
+        {
+            return page_num_allocated.fetch_add(page_num);
+        }
+
+        void write(long long page_id, char *data, long long page_num)
+        {
+            iovec buffer = {data, (size_t)(page_num * page_bytes)};
+            transfer(&buffer, 1, page_id, true);
+        }
+
+        // consecutive pages from page_id on, one to each buffer, with as few calls as IOV_MAX allows
+        void read(long long page_id, char **buffers, int page_num)
+        {
+            vector<iovec> iov(page_num);
+            for (int i = 0; i < page_num; i++)
+            {
+                iov[i] = {buffers[i], page_bytes};
+            }
+            transfer(iov.data(), page_num, page_id, false);
+        }
+
+        int get_fd() const
+        {
+            return fd;
+        }
+
+        size_t get_page_bytes() const
+        {
+            return page_bytes;
+        }
+
+        long long get_page_num() const
+        {
+            return page_num_allocated.load();
+        }
+
+    private:
+        string path;
+        size_t page_bytes;
+        int fd;
+        atomic<long long> page_num_allocated{0};
+
+        // repeats short transfers until every buffer is done
+        void transfer(iovec *iov, int iov_num, long long page_id, bool is_write)
+        {
+            off_t offset = page_id * page_bytes;
+            int first = 0;
+            while (first < iov_num)
+            {
+                int count = min(iov_num - first, IOV_MAX);
+                ssize_t done = is_write ? pwritev(fd, iov + first, count, offset) : preadv(fd, iov + first, count, offset);
+                if (done < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (done <= 0)
+                {
+                    throw runtime_error("page file " + path + ": " + (done < 0 ? strerror(errno) : "unexpected end of file"));
+                }
+                offset += done;
+                while (done > 0)
+                {
+                    if ((size_t)done >= iov[first].iov_len)
+                    {
+                        done -= iov[first].iov_len;
+                        first++;
+                    }
+                    else
+                    {
+                        iov[first].iov_base = (char *)iov[first].iov_base + done;
+                        iov[first].iov_len -= done;
+                        done = 0;
+                    }
+                }
+            }
+        }
+    };
+
+    // Frames of one page each over a PageFile. fetch pins a frame until its Handle is gone, so
+    // a query holding a page never sees it replaced. prefetch and fetch_batch together pin at
+    // most half of the frames at a time, and pages past that are left for fetch; a fetch that
+    // finds every frame pinned waits while batches hold some and throws otherwise.
+    // Thread-safe: misses are read outside the lock and a fetch of a page being read waits for
+    // it; batches take turns on the pool's ring. Dirty frames are written back when they are
+    // replaced and by flush(). The frames are charged to account as LEAF_POINTS.
+    class BufferPool
+    {
+    public:
+        class Handle
+        {
+        public:
+            Handle(BufferPool *pool, int frame) : pool(pool), frame(frame)
+            {
+            }
+
+            Handle(Handle &&other) noexcept : pool(other.pool), frame(other.frame)
+            {
+                other.pool = NULL;
+            }
+
+            Handle(const Handle &) = delete;
+            Handle &operator=(const Handle &) = delete;
+
+            ~Handle()
+            {
+                if (pool != NULL)
+                {
+                    pool->unpin(frame);
+                }
+            }
+
+            DiskPage *operator->() const
+            {
+                return get();
+            }
+
+            DiskPage *get() const
+            {
+                return (DiskPage *)pool->get_frame_data(frame);
+            }
+
+        private:
+            BufferPool *pool;
+            int frame;
+        };
+
+        // pages of page_size points in the file at path, frame_num frames of them in memory
+        BufferPool(string path, int page_size, long long frame_num, Policy policy, memory_accounting::Account *account, ReadMode read_mode = SYNC) : file(path, DiskPage::get_bytes(page_size)), page_size(page_size), policy(policy), read_mode(read_mode), account(account), frames(frame_num)
+        {
+            memory_bytes = frame_num * file.get_page_bytes();
+            if (posix_memalign(&memory, FRAME_ALIGNMENT, memory_bytes) != 0)
+            {
+                throw bad_alloc();
+            }
+            account->charge(memory_accounting::LEAF_POINTS, memory_bytes);
+            for (int f = 0; f < frame_num; f++)
+            {
+                lru.push_back(f);
+                frames[f].lru_position = prev(lru.end());
+            }
+        }
+
+        BufferPool(const BufferPool &) = delete;
+        BufferPool &operator=(const BufferPool &) = delete;
+
+        ~BufferPool()
+        {
+            free(memory);
+            account->credit(memory_accounting::LEAF_POINTS, memory_bytes);
+        }
+
+        // writes length points, in order, to new consecutive pages of page_size points, with one
+        // write; returns the id of the first page
+        long long write_pages(const Point *points, long long length)
+        {
+            long long page_num = (length + page_size - 1) / page_size;
+            size_t page_bytes = file.get_page_bytes();
+            memory_accounting::Buffer<char> buffer(page_num * page_bytes, 0, memory_accounting::Buffer<char>::allocator_type(account));
+            for (long long i = 0; i < page_num; i++)
+            {
+                DiskPage *page = (DiskPage *)(buffer.data() + i * page_bytes);
+                page->capacity = page_size;
+                page->size = 0;
+                for (long long j = i * page_size; j < length && j < (i + 1) * page_size; j++)
+                {
+                    page->set_point(page->size++, points[j]);
+                }
+            }
+            long long first_page = file.allocate(page_num);
+            file.write(first_page, buffer.data(), page_num);
+            return first_page;
+        }
+
+        // a new empty page
+        long long allocate_page()
+        {
+            memory_accounting::Buffer<char> buffer(file.get_page_bytes(), 0, memory_accounting::Buffer<char>::allocator_type(account));
+            DiskPage *page = (DiskPage *)buffer.data();
+            page->capacity = page_size;
+            page->size = 0;
+            long long page_id = file.allocate(1);
+            file.write(page_id, buffer.data(), 1);
+            return page_id;
+        }
+
+        Handle fetch(long long page_id, IoStats *stats = NULL, bool is_dirty = false)
+        {
+            unique_lock<mutex> lock(pool_mutex);
+            int f = -1;
+            while (f < 0)
+            {
+                unordered_map<long long, int>::iterator iter = table.find(page_id);
+                if (iter == table.end())
+                {
+                    f = evict();
+                    if (f < 0)
+                    {
+                        if (batch_pins == 0)
+                        {
+                            throw runtime_error("buffer pool: every frame is pinned");
+                        }
+                        // batches unpin their frames as they go; the page may be in one by then
+                        unpinned.wait(lock);
+                    }
+                    continue;
+                }
+                Frame &frame = frames[iter->second];
+                if (frame.is_loading)
+                {
+                    // another fetch or a prefetch is reading the page; look again once it is done
+                    loaded.wait(lock);
+                    continue;
+                }
+                frame.pin_count++;
+                frame.is_dirty = frame.is_dirty || is_dirty;
+                touch(iter->second);
+                if (stats != NULL)
+                {
+                    stats->hits++;
+                }
+                return Handle(this, iter->second);
+            }
+            start_loading(f, page_id);
+            frames[f].is_dirty = is_dirty;
+            lock.unlock();
+            char *data = get_frame_data(f);
+            try
+            {
+                file.read(page_id, &data, 1);
+            }
+            catch (...)
+            {
+                lock.lock();
+                abort_loading(f);
+                throw;
+            }
+            lock.lock();
+            frames[f].is_loading = false;
+            loaded.notify_all();
+            if (stats != NULL)
+            {
+                stats->misses++;
+                stats->reads++;
+            }
+            return Handle(this, f);
+        }
+
+        // reads the pages of page_ids that are in no frame into the frames batches may pin, one
+        // read per run of consecutive ids; fetching them afterwards is a hit
+        void prefetch(vector<long long> page_ids, IoStats *stats = NULL)
+        {
+            sort(page_ids.begin(), page_ids.end());
+            page_ids.erase(unique(page_ids.begin(), page_ids.end()), page_ids.end());
+            vector<pair<long long, int>> missing;
+            unique_lock<mutex> lock(pool_mutex);
+            for (long long page_id : page_ids)
+            {
+                if (batch_pins >= frames.size() / 2)
+                {
+                    break;
+                }
+                if (table.count(page_id) > 0)
+                {
+                    continue;
+                }
+                int f = evict();
+                if (f < 0)
+                {
+                    break;
+                }
+                start_loading(f, page_id);
+                batch_pins++;
+                missing.push_back({page_id, f});
+            }
+            if (missing.empty())
+            {
+                return;
+            }
+            lock.unlock();
+            long long read_num = 0;
+            try
+            {
+                vector<char *> buffers;
+                for (size_t begin = 0, end = 0; begin < missing.size(); begin = end)
+                {
+                    buffers.clear();
+                    for (end = begin; end < missing.size() && missing[end].first == missing[begin].first + (long long)(end - begin); end++)
+                    {
+                        buffers.push_back(get_frame_data(missing[end].second));
+                    }
+                    file.read(missing[begin].first, buffers.data(), buffers.size());
+                    read_num++;
+                }
+            }
+            catch (...)
+            {
+                lock.lock();
+                for (pair<long long, int> &page : missing)
+                {
+                    abort_loading(page.second);
+                }
+                batch_pins -= missing.size();
+                unpinned.notify_all();
+                throw;
+            }
+            lock.lock();
+            for (pair<long long, int> &page : missing)
+            {
+                frames[page.second].is_loading = false;
+                frames[page.second].pin_count--;
+            }
+            batch_pins -= missing.size();
+            loaded.notify_all();
+            unpinned.notify_all();
+            if (stats != NULL)
+            {
+                stats->misses += missing.size();
+                stats->reads += read_num;
+            }
+        }
+
+        // calls f(i, page) for every page_ids[i] while the page is pinned: first for pages in a
+        // frame, then for missing pages as their reads complete. The reads of the missing pages
+        // are submitted together. Pages past the frames batches may pin, and pages another fetch
+        // is reading, are fetched one by one at the end.
+        template <class F>
+        void fetch_batch(const vector<long long> &page_ids, IoStats *stats, F f)
+        {
+            vector<pair<int, int>> ready;
+            vector<pair<int, int>> missing;
+            vector<int> later;
+            unique_lock<mutex> lock(pool_mutex);
+            for (size_t i = 0; i < page_ids.size(); i++)
+            {
+                unordered_map<long long, int>::iterator iter = table.find(page_ids[i]);
+                if (iter != table.end())
+                {
+                    Frame &frame = frames[iter->second];
+                    if (frame.is_loading || batch_pins >= frames.size() / 2)
+                    {
+                        later.push_back(i);
+                        continue;
+                    }
+                    frame.pin_count++;
+                    batch_pins++;
+                    touch(iter->second);
+                    ready.push_back({(int)i, iter->second});
+                    continue;
+                }
+                int f = batch_pins < frames.size() / 2 ? evict() : -1;
+                if (f < 0)
+                {
+                    later.push_back(i);
+                    continue;
+                }
+                start_loading(f, page_ids[i]);
+                batch_pins++;
+                missing.push_back({(int)i, f});
+            }
+            lock.unlock();
+            if (stats != NULL)
+            {
+                stats->hits += ready.size();
+            }
+
+            unique_lock<mutex> ring_lock(ring_mutex, defer_lock);
+            vector<async_io::Completion> completions;
+            if (!missing.empty())
+            {
+                ring_lock.lock();
+                if (ring == NULL)
+                {
+                    ring.reset(new async_io::Ring(min(frames.size() / 2, (size_t)1024), read_mode != PREAD));
+                }
+                for (size_t m = 0; m < missing.size(); m++)
+                {
+                    ring->read(file.get_fd(), get_frame_data(missing[m].second), file.get_page_bytes(), page_ids[missing[m].first] * file.get_page_bytes(), m);
+                }
+                ring->submit();
+            }
+            // hits are processed while the reads are in flight
+            for (pair<int, int> &page : ready)
+            {
+                f(page.first, (DiskPage *)get_frame_data(page.second));
+                unpin(page.second, true);
+            }
+            vector<bool> is_done(missing.size(), false);
+            for (size_t done = 0; done < missing.size();)
+            {
+                completions.clear();
+                ring->wait(completions);
+                for (async_io::Completion &completion : completions)
+                {
+                    pair<int, int> &page = missing[completion.user_data];
+                    char *data = get_frame_data(page.second);
+                    if (completion.result != (int)file.get_page_bytes())
+                    {
+                        // a failed or short read is retried with pread, which throws on errors
+                        try
+                        {
+                            file.read(page_ids[page.first], &data, 1);
+                        }
+                        catch (...)
+                        {
+                            // the other reads still write to their frames: wait for them first
+                            vector<async_io::Completion> drained;
+                            while (ring->wait(drained))
+                            {
+                            }
+                            lock.lock();
+                            for (size_t m = 0; m < missing.size(); m++)
+                            {
+                                if (!is_done[m])
+                                {
+                                    abort_loading(missing[m].second);
+                                    batch_pins--;
+                                }
+                            }
+                            unpinned.notify_all();
+                            throw;
+                        }
+                    }
+                    lock.lock();
+                    frames[page.second].is_loading = false;
+                    loaded.notify_all();
+                    lock.unlock();
+                    is_done[completion.user_data] = true;
+                    if (stats != NULL)
+                    {
+                        stats->misses++;
+                        stats->reads++;
+                    }
+                    f(page.first, (DiskPage *)data);
+                    unpin(page.second, true);
+                    done++;
+                }
+            }
+            if (ring_lock.owns_lock())
+            {
+                ring_lock.unlock();
+            }
+            for (int i : later)
+            {
+                Handle page = fetch(page_ids[i], stats);
+                f(i, page.get());
+            }
+        }
+
+        ReadMode get_read_mode() const
+        {
+            return read_mode;
+        }
+
+        void flush()
+        {
+            lock_guard<mutex> lock(pool_mutex);
+            for (size_t f = 0; f < frames.size(); f++)
+            {
+                if (frames[f].is_dirty && !frames[f].is_loading)
+                {
+                    write_back(f);
+                }
+            }
+        }
+
+        int get_page_size() const
+        {
+            return page_size;
+        }
+
+        PageFile &get_file()
+        {
+            return file;
+        }
+
+        string get_self() const
+        {
+            return "buffer_pool_policy:" + string(POLICY_NAMES[policy]) + "\n" + "read_mode:" + READ_MODE_NAMES[read_mode] + (read_mode == URING && ring != NULL && !ring->is_async() ? " (pread fallback)" : "") + "\n" + "buffer_pool_frames:" + to_string(frames.size()) + "\n" + "page_bytes:" + to_string(file.get_page_bytes()) + "\n" + "page_file_pages:" + to_string(file.get_page_num()) + "\n";
+        }
+
+    private:
+        struct Frame
+        {
+            long long page_id = -1;
+            int pin_count = 0;
+            bool is_dirty = false;
+            bool is_loading = false;
+            // CLOCK reference bit
+            bool is_referenced = false;
+            list<int>::iterator lru_position;
+        };
+
+        PageFile file;
+        int page_size;
+        Policy policy;
+        ReadMode read_mode;
+        memory_accounting::Account *account;
+        void *memory = NULL;
+        size_t memory_bytes = 0;
+        vector<Frame> frames;
+        // page id to frame
+        unordered_map<long long, int> table;
+        // frames from the most to the least recently used
+        list<int> lru;
+        size_t clock_hand = 0;
+        mutex pool_mutex;
+        condition_variable loaded;
+        // frames pinned by prefetch and fetch_batch, at most half of them
+        size_t batch_pins = 0;
+        condition_variable unpinned;
+        // set up by the first batch
+        unique_ptr<async_io::Ring> ring;
+        mutex ring_mutex;
+
+        char *get_frame_data(int f) const
+        {
+            return (char *)memory + f * file.get_page_bytes();
+        }
+
+        void unpin(int f, bool is_batch = false)
+        {
+            lock_guard<mutex> lock(pool_mutex);
+            frames[f].pin_count--;
+            if (is_batch)
+            {
+                batch_pins--;
+                unpinned.notify_all();
+            }
+        }
+
+        void touch(int f)
+        {
+            if (policy == LRU)
+            {
+                lru.splice(lru.begin(), lru, frames[f].lru_position);
+            }
+            else
+            {
+                frames[f].is_referenced = true;
+            }
+        }
+
+        void write_back(int f)
+        {
+            char *data = get_frame_data(f);
+            file.write(frames[f].page_id, data, 1);
+            frames[f].is_dirty = false;
+        }
+
+        // frame of the page to replace, written back and unmapped; -1 if every frame is pinned
+        int evict()
+        {
+            int victim = -1;
+            if (policy == LRU)
+            {
+                for (list<int>::reverse_iterator iter = lru.rbegin(); iter != lru.rend() && victim < 0; iter++)
+                {
+                    if (frames[*iter].pin_count == 0 && !frames[*iter].is_loading)
+                    {
+                        victim = *iter;
+                    }
+                }
+            }
+            else
+            {
+                // two sweeps: the first may only clear reference bits
+                for (size_t step = 0; step < 2 * frames.size() && victim < 0; step++)
+                {
+                    Frame &frame = frames[clock_hand];
+                    if (frame.pin_count == 0 && !frame.is_loading)
+                    {
+                        if (frame.is_referenced)
+                        {
+                            frame.is_referenced = false;
+                        }
+                        else
+                        {
+                            victim = clock_hand;
+                        }
+                    }
+                    clock_hand = (clock_hand + 1) % frames.size();
+                }
+            }
+            if (victim < 0)
+            {
+                return -1;
+            }
+            if (frames[victim].is_dirty)
+            {
+                write_back(victim);
+            }
+            if (frames[victim].page_id >= 0)
+            {
+                table.erase(frames[victim].page_id);
+            }
+            return victim;
+        }
+
+        // maps page_id to frame f, pinned and loading
+        void start_loading(int f, long long page_id)
+        {
+            Frame &frame = frames[f];
+            frame.page_id = page_id;
+            frame.pin_count = 1;
+            frame.is_loading = true;
+            frame.is_dirty = false;
+            table[page_id] = f;
+            touch(f);
+        }
+
+        void abort_loading(int f)
+        {
+            Frame &frame = frames[f];
+            table.erase(frame.page_id);
+            frame.page_id = -1;
+            frame.pin_count = 0;
+            frame.is_loading = false;
+            loaded.notify_all();
+        }
+    };
+};
+
+#endif
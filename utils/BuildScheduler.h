@@ -0,0 +1,84 @@
+#ifndef BUILDSCHEDULER_H
+#define BUILDSCHEDULER_H
+
+#include <iostream>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include "ThreadTools.h"
+
+#ifdef use_torch
+#include <torch/torch.h>
+#endif
+
+using namespace std;
+
+// Collects independent model-training jobs (one per last-level model) while the tree is laid
+// out, then trains them concurrently, one model per worker. Each worker trains its model on a
+// single thread: libtorch intra-op parallelism is pinned to 1 while the jobs run, because for
+// leaf-sized inputs the synchronisation of the intra-op pool costs more than it saves. Upper
+// level models are trained before the jobs run and keep the default intra-op threads.
+class BuildScheduler
+{
+public:
+    int thread_num;
+    long long time = 0;
+
+    BuildScheduler()
+    {
+        thread_num = thread_utils::default_thread_num();
+    }
+
+    BuildScheduler(int thread_num)
+    {
+        this->thread_num = thread_num > 0 ? thread_num : thread_utils::default_thread_num();
+    }
+
+    void add(function<void()> job)
+    {
+        jobs.push_back(job);
+    }
+
+    long size()
+    {
+        return jobs.size();
+    }
+
+    // guards shared state (e.g. ExpRecorder) that jobs update when they finish
+    mutex &lock()
+    {
+        return job_mutex;
+    }
+
+    void run()
+    {
+        auto start = chrono::high_resolution_clock::now();
+#ifdef use_torch
+        int intra_op_thread_num = torch::get_num_threads();
+        torch::set_num_threads(1);
+#endif
+        atomic<long> next(0);
+        long job_num = jobs.size();
+        int worker_num = thread_num < job_num ? thread_num : job_num;
+        thread_utils::parallel_for(0, worker_num, worker_num, [&](int, long long, long long) {
+            for (long i = next++; i < job_num; i = next++)
+            {
+                jobs[i]();
+            }
+        });
+#ifdef use_torch
+        torch::set_num_threads(intra_op_thread_num);
+#endif
+        auto finish = chrono::high_resolution_clock::now();
+        time = chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
+    }
+
+private:
+    vector<function<void()>> jobs;
+    mutex job_mutex;
+};
+
+#endif
@@ -45,6 +45,9 @@ public:
     static const string DELETEACCWINDOW;
     static const string DELETEKNN;
     static const string DELETEACCKNN;
+    static const string WORKLOAD;
+    static const string REPLAY;
+    static const string STATS;
 
     static const string TORCH_MODELS;
     Constants();
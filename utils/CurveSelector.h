@@ -0,0 +1,134 @@
+#ifndef CURVESELECTOR_H
+#define CURVESELECTOR_H
+
+#include <vector>
+#include <algorithm>
+#include <math.h>
+
+using namespace std;
+
+// Build-time choice between the Hilbert and the Z curve for one node. Each candidate ordering
+// is trial-fitted on a sample of the node's points with a least-squares plane over (x, y),
+// a cheap stand-in for the node's model. The mean fit error, in pages (leaf nodes) or children
+// (non-leaf nodes), gives the expected number of units a lookup scans, and the cost of a curve
+// is the time to scan them. Queries never encode a point, so only the fit tells the curves
+// apart; Z wins ties because it is cheaper to encode at build.
+namespace curve_selection
+{
+    enum Curve
+    {
+        HILBERT = 0,
+        Z = 1
+    };
+
+    const int CURVE_NUM = 2;
+    const int SAMPLE_SIZE = 1024;
+    // ns to scan one point of a unit (page or child) on a misprediction
+    const double SCAN_NS = 2.0;
+
+    inline const char *name(int curve)
+    {
+        return curve == Z ? "Z" : "Hilbert";
+    }
+
+    // mean |label - fit| of a least-squares plane label ~ a * x + b * y + c, in units of
+    // unit_num, over at most SAMPLE_SIZE evenly spaced rows; locations holds (x, y) rows
+    inline double fit_error(const float *locations, const float *labels, long long length, int unit_num)
+    {
+        if (length < 3)
+        {
+            return 0;
+        }
+        long long stride = length > SAMPLE_SIZE ? length / SAMPLE_SIZE : 1;
+        // normal equations A^T A w = A^T y with rows (x, y, 1)
+        double ata[3][3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
+        double aty[3] = {0, 0, 0};
+        for (long long i = 0; i < length; i += stride)
+        {
+            double row[3] = {locations[i * 2], locations[i * 2 + 1], 1};
+            for (int r = 0; r < 3; r++)
+            {
+                for (int c = 0; c < 3; c++)
+                {
+                    ata[r][c] += row[r] * row[c];
+                }
+                aty[r] += row[r] * labels[i];
+            }
+        }
+        // Gaussian elimination with partial pivoting
+        double w[3] = {0, 0, 0};
+        for (int col = 0; col < 3; col++)
+        {
+            int pivot = col;
+            for (int r = col + 1; r < 3; r++)
+            {
+                if (fabs(ata[r][col]) > fabs(ata[pivot][col]))
+                {
+                    pivot = r;
+                }
+            }
+            if (fabs(ata[pivot][col]) < 1e-12)
+            {
+                continue;
+            }
+            for (int c = 0; c < 3; c++)
+            {
+                swap(ata[col][c], ata[pivot][c]);
+            }
+            swap(aty[col], aty[pivot]);
+            for (int r = col + 1; r < 3; r++)
+            {
+                double factor = ata[r][col] / ata[col][col];
+                for (int c = col; c < 3; c++)
+                {
+                    ata[r][c] -= factor * ata[col][c];
+                }
+                aty[r] -= factor * aty[col];
+            }
+        }
+        for (int r = 2; r >= 0; r--)
+        {
+            if (fabs(ata[r][r]) < 1e-12)
+            {
+                continue;
+            }
+            double sum = aty[r];
+            for (int c = r + 1; c < 3; c++)
+            {
+                sum -= ata[r][c] * w[c];
+            }
+            w[r] = sum / ata[r][r];
+        }
+        double error = 0;
+        long long sample_num = 0;
+        for (long long i = 0; i < length; i += stride)
+        {
+            error += fabs(w[0] * locations[i * 2] + w[1] * locations[i * 2 + 1] + w[2] - labels[i]);
+            sample_num++;
+        }
+        return error / sample_num * unit_num;
+    }
+
+    // expected ns a lookup spends scanning units of unit_size points
+    inline double cost(double fit_error, long long unit_size)
+    {
+        return (1 + 2 * fit_error) * unit_size * SCAN_NS;
+    }
+
+    // fit_errors[c] is the fit error of curve c over units of unit_size points (the runtime page
+    // size for leaf nodes); ties go to Z
+    inline int select(const double fit_errors[CURVE_NUM], long long unit_size)
+    {
+        int best = HILBERT;
+        for (int curve = 1; curve < CURVE_NUM; curve++)
+        {
+            if (cost(fit_errors[curve], unit_size) <= cost(fit_errors[best], unit_size))
+            {
+                best = curve;
+            }
+        }
+        return best;
+    }
+};
+
+#endif
@@ -15,7 +15,7 @@ string ExpRecorder::get_time()
 
 string ExpRecorder::get_time_size_errors()
 {
-    string result = "time:" + to_string(time) + "\n" + "size:" + to_string(size) + "\n" + "maxError:" + to_string(max_error) + "\n" + "min_error:" + to_string(min_error) + "\n" + "leaf_node_num:" + to_string(leaf_node_num) + "\n" + "average_max_error:" + to_string(average_max_error) + "\n" + "average_min_error:" + to_string(average_min_error) + "\n" + "depth:" + to_string(depth) + "\n";
+    string result = "time:" + to_string(time) + "\n" + "size:" + to_string(size) + "\n" + "maxError:" + to_string(max_error) + "\n" + "min_error:" + to_string(min_error) + "\n" + "leaf_node_num:" + to_string(leaf_node_num) + "\n" + "average_max_error:" + to_string(get_average_max_error()) + "\n" + "average_min_error:" + to_string(get_average_min_error()) + "\n" + "depth:" + to_string(depth) + "\n" + "models_per_second:" + to_string(get_models_per_second()) + "\n" + "hilbert_node_num:" + to_string(hilbert_node_num) + "\n" + "z_node_num:" + to_string(z_node_num) + "\n";
     time = 0;
     size = 0;
     max_error = 0;
@@ -43,7 +43,9 @@ string ExpRecorder::get_time_accuracy()
 
 string ExpRecorder::get_time_pageaccess_accuracy()
 {
-    string result = "time:" + to_string(time) + "\n" + "pageaccess:" + to_string(page_access) + "\n" + "accuracy:" + to_string(accuracy) + "\n";
+    // before get_percentiles clears the operation count
+    string io_counts = get_io_counts();
+    string result = "time:" + to_string(time) + "\n" + "pageaccess:" + to_string(page_access) + "\n" + "accuracy:" + to_string(accuracy) + "\n" + io_counts + get_percentiles() + get_phase_counts();
     time = 0;
     page_access = 0;
     accuracy = 0;
@@ -52,7 +54,8 @@ string ExpRecorder::get_time_pageaccess_accuracy()
 
 string ExpRecorder::get_time_pageaccess()
 {
-    string result = "time:" + to_string(time) + "\n" + "pageaccess:" + to_string(page_access) + "\n";
+    string io_counts = get_io_counts();
+    string result = "time:" + to_string(time) + "\n" + "pageaccess:" + to_string(page_access) + "\n" + io_counts + get_percentiles() + get_phase_counts();
     time = 0;
     page_access = 0;
     return result;
@@ -60,7 +63,7 @@ string ExpRecorder::get_time_pageaccess()
 
 string ExpRecorder::get_delete_time_pageaccess()
 {
-    string result = "time:" + to_string(delete_time) + "\n" + "pageaccess:" + to_string(page_access) + "\n";
+    string result = "time:" + to_string(delete_time) + "\n" + "pageaccess:" + to_string(page_access) + "\n" + get_percentiles();
     time = 0;
     page_access = 0;
     return result;
@@ -68,7 +71,7 @@ string ExpRecorder::get_delete_time_pageaccess()
 
 string ExpRecorder::get_insert_time_pageaccess()
 {
-    string result = "time:" + to_string(insert_time) + "\n" + "pageaccess:" + to_string(page_access) + "\n";
+    string result = "time:" + to_string(insert_time) + "\n" + "pageaccess:" + to_string(page_access) + "\n" + get_percentiles();
     time = 0;
     page_access = 0;
     return result;
@@ -76,12 +79,67 @@ string ExpRecorder::get_insert_time_pageaccess()
 
 string ExpRecorder::get_insert_time_pageaccess_rebuild()
 {
-    string result = "time:" + to_string(insert_time) + "\n" + "pageaccess:" + to_string(page_access) + "\n" + "rebuild_num:" + to_string(rebuild_num) + "\n" + "rebuild_time:" + to_string(rebuild_time) + "\n";
+    string result = "time:" + to_string(insert_time) + "\n" + "pageaccess:" + to_string(page_access) + "\n" + "rebuild_num:" + to_string(rebuild_num) + "\n" + "rebuild_time:" + to_string(rebuild_time) + "\n" + get_percentiles();
     time = 0;
     page_access = 0;
     return result;
 }
 
+void ExpRecorder::record(long long operation_time, double operation_page_access)
+{
+    time_histogram.record(operation_time);
+    page_access_histogram.record((long long)(operation_page_access + 0.5));
+}
+
+string ExpRecorder::get_percentiles()
+{
+    string result = time_histogram.get_percentiles("time") + page_access_histogram.get_percentiles("pageaccess");
+    time_histogram.clean();
+    page_access_histogram.clean();
+    return result;
+}
+
+string ExpRecorder::get_phase_counts()
+{
+    string result = phase_counters.get_counts();
+    phase_counters.clean();
+    return result;
+}
+
+string ExpRecorder::get_io_counts()
+{
+    string result = io_stats.hits + io_stats.misses == 0 || time_histogram.count == 0 ? "" : io_stats.get_self(time_histogram.count);
+    io_stats = buffer_pool::IoStats();
+    return result;
+}
+
+double ExpRecorder::get_models_per_second()
+{
+    if (leaf_training_time == 0)
+    {
+        return 0;
+    }
+    return trained_leaf_model_num * 1e9 / leaf_training_time;
+}
+
+double ExpRecorder::get_average_max_error()
+{
+    if (last_level_model_num == 0)
+    {
+        return 0;
+    }
+    return total_max_error * 1.0 / last_level_model_num;
+}
+
+double ExpRecorder::get_average_min_error()
+{
+    if (last_level_model_num == 0)
+    {
+        return 0;
+    }
+    return total_min_error * 1.0 / last_level_model_num;
+}
+
 string ExpRecorder::get_size()
 {
     string result = "size:" + to_string(size) + "\n";
@@ -124,9 +182,21 @@ void ExpRecorder::clean()
     max_error = 0;
     min_error = 0;
 
-    average_min_error = 0;
-    average_max_error = 0;
+    total_min_error = 0;
+    total_max_error = 0;
 
     last_level_model_num = 0;
+    leaf_setup_time = 0;
+    cached_model_num = 0;
+    leaf_training_time = 0;
+    trained_leaf_model_num = 0;
+    hilbert_node_num = 0;
+    z_node_num = 0;
     depth = 0;
+    memory_usage = memory_accounting::Usage();
+
+    time_histogram.clean();
+    page_access_histogram.clean();
+    phase_counters.clean();
+    io_stats = buffer_pool::IoStats();
 }
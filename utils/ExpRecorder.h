@@ -6,6 +6,11 @@
 #include <string>
 #include "Constants.h"
 #include "SortTools.h"
+#include "Histogram.h"
+#include "PerfCounters.h"
+#include "RSMIConfig.h"
+#include "MemoryAccounting.h"
+#include "BufferPool.h"
 #include <queue>
 using namespace std;
 
@@ -29,19 +34,32 @@ public:
 
     long long total_depth;
 
-    int N = Constants::THRESHOLD;
+    // index parameters of the experiment; record file names carry its threshold, which ZM and
+    // RSMIND also use as their partition size
+    RSMIConfig config;
 
-    long long average_max_error = 0;
-    long long average_min_error = 0;
+    // max and min errors summed over last-level models; the averages divide by last_level_model_num
+    long long total_max_error = 0;
+    long long total_min_error = 0;
 
     int last_level_model_num = 0;
+    // time spent staging training inputs and extracting parameters, summed over leaf models
+    long long leaf_setup_time = 0;
+    // models loaded from the model store instead of being trained
+    int cached_model_num = 0;
+    // wall time of the parallel last-level training phase and the models trained in it
+    long long leaf_training_time = 0;
+    long long trained_leaf_model_num = 0;
+    // nodes whose curve_selection chose the Hilbert or the Z curve
+    int hilbert_node_num = 0;
+    int z_node_num = 0;
 
     string structure_name;
     string distribution;
     long dataset_cardinality;
 
     long long insert_num;
-    long delete_num;
+    long delete_num = 0;
     float window_size;
     float window_ratio;
     int k_num;
@@ -49,12 +67,15 @@ public:
 
     long time;
     long insert_time;
-    long delete_time;
+    long delete_time = 0;
     long long rebuild_time;
     int rebuild_num;
     double page_access = 1.0;
     double accuracy;
     long size;
+    // bytes of the built index by component, as charged by its allocators; written with the
+    // build record when set
+    memory_accounting::Usage memory_usage;
 
     int window_query_result_size;
     int acc_window_query_qesult_size;
@@ -62,6 +83,23 @@ public:
     vector<Point> acc_knn_query_results;
 
     vector<Point> window_query_results;
+
+    // per-operation latency (ns) and page accesses of the current batch of queries, inserts or
+    // deletes; the get_* functions that report time and pageaccess also report their percentiles
+    Histogram time_histogram;
+    Histogram page_access_histogram;
+    void record(long long operation_time, double operation_page_access);
+    string get_percentiles();
+
+    // hardware counters per query phase, recorded only when built with use_perf
+    perf_counters::PhaseCounters phase_counters;
+    string get_phase_counts();
+
+    // buffer pool hits, misses and reads of disk-resident pages; reported per operation with
+    // the current batch, nothing when the pages are in memory
+    buffer_pool::IoStats io_stats;
+    string get_io_counts();
+
     ExpRecorder();
     string get_time();
     string get_time_pageaccess();
@@ -74,6 +112,9 @@ public:
 
     string get_insert_time_pageaccess();
     string get_delete_time_pageaccess();
+    double get_models_per_second();
+    double get_average_max_error();
+    double get_average_min_error();
     void cal_size();
     void clean();
 };
@@ -130,3 +130,31 @@ vector<Mbr> FileReader::get_mbrs(string filename, string delimeter)
 
     return mbrs;
 }
+
+vector<vector<float>> FileReader::get_coordinates(string filename, string delimeter, int dim)
+{
+    ifstream file(filename);
+
+    vector<vector<float>> coordinates;
+
+    string line = "";
+    while (getline(file, line))
+    {
+        vector<string> vec;
+        boost::algorithm::split(vec, line, boost::is_any_of(delimeter));
+        if (vec.size() < dim)
+        {
+            continue;
+        }
+        vector<float> coordinate(dim);
+        for (int d = 0; d < dim; d++)
+        {
+            coordinate[d] = stod(vec[d]);
+        }
+        coordinates.push_back(coordinate);
+    }
+
+    file.close();
+
+    return coordinates;
+}
@@ -22,6 +22,8 @@ public:
     vector<Mbr> get_mbrs();
     vector<Point> get_points(string filename, string delimeter);
     vector<Mbr> get_mbrs(string filename, string delimeter);
+    // first dim columns of every line, for d-dimensional datasets
+    vector<vector<float>> get_coordinates(string filename, string delimeter, int dim);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,126 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include <algorithm>
+
+using namespace std;
+
+// HDR-style histogram of non-negative integer samples (ns latencies, page counts). Values below
+// SUB_BUCKET_NUM get a bucket each; above that, every power of two is split into
+// SUB_BUCKET_NUM / 2 linear sub-buckets, so a recorded value is off by less than 1 / 64 of
+// itself while the whole int64 range fits in a few thousand counters. The sum, min and max
+// are kept exactly.
+class Histogram
+{
+public:
+    static const int SUB_BUCKET_BITS = 7;
+    static const int SUB_BUCKET_NUM = 1 << SUB_BUCKET_BITS;
+    static const int HALF_BUCKET_NUM = SUB_BUCKET_NUM / 2;
+    static const int BUCKET_NUM = (64 - SUB_BUCKET_BITS + 2) * HALF_BUCKET_NUM;
+
+    vector<long long> counts;
+    long long count;
+    long long sum;
+    long long min_value;
+    long long max_value;
+
+    Histogram() : counts(BUCKET_NUM, 0)
+    {
+        clean();
+    }
+
+    static int bucket_index(long long value)
+    {
+        if (value < SUB_BUCKET_NUM)
+        {
+            return value < 0 ? 0 : (int)value;
+        }
+        int shift = 63 - __builtin_clzll((unsigned long long)value) - (SUB_BUCKET_BITS - 1);
+        return shift * HALF_BUCKET_NUM + (int)(value >> shift);
+    }
+
+    // largest value that falls into bucket index
+    static long long bucket_value(int index)
+    {
+        if (index < SUB_BUCKET_NUM)
+        {
+            return index;
+        }
+        int shift = index / HALF_BUCKET_NUM - 1;
+        long long sub = index - shift * HALF_BUCKET_NUM;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    void record(long long value)
+    {
+        value = value < 0 ? 0 : value;
+        counts[bucket_index(value)]++;
+        count++;
+        sum += value;
+        min_value = value < min_value ? value : min_value;
+        max_value = value > max_value ? value : max_value;
+    }
+
+    void merge(const Histogram &other)
+    {
+        for (int i = 0; i < BUCKET_NUM; i++)
+        {
+            counts[i] += other.counts[i];
+        }
+        count += other.count;
+        sum += other.sum;
+        min_value = other.min_value < min_value ? other.min_value : min_value;
+        max_value = other.max_value > max_value ? other.max_value : max_value;
+    }
+
+    double mean() const
+    {
+        return count == 0 ? 0 : (double)sum / count;
+    }
+
+    // value at or below which a fraction p (0..1) of the samples fall
+    long long percentile(double p) const
+    {
+        if (count == 0)
+        {
+            return 0;
+        }
+        long long rank = (long long)(p * count + 0.5);
+        rank = rank < 1 ? 1 : (rank > count ? count : rank);
+        long long seen = 0;
+        for (int i = 0; i < BUCKET_NUM; i++)
+        {
+            seen += counts[i];
+            if (seen >= rank)
+            {
+                long long value = bucket_value(i);
+                return value > max_value ? max_value : value;
+            }
+        }
+        return max_value;
+    }
+
+    // "<name>_p50:...\n" lines for p50/p90/p99/p99.9 and max, in the ExpRecorder output format
+    string get_percentiles(string name) const
+    {
+        if (count == 0)
+        {
+            return "";
+        }
+        return name + "_p50:" + to_string(percentile(0.5)) + "\n" + name + "_p90:" + to_string(percentile(0.9)) + "\n" + name + "_p99:" + to_string(percentile(0.99)) + "\n" + name + "_p999:" + to_string(percentile(0.999)) + "\n" + name + "_max:" + to_string(max_value) + "\n";
+    }
+
+    void clean()
+    {
+        fill(counts.begin(), counts.end(), 0);
+        count = 0;
+        sum = 0;
+        min_value = INT64_MAX;
+        max_value = 0;
+    }
+};
+
+#endif
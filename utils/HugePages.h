@@ -0,0 +1,202 @@
+#ifndef HUGEPAGES_H
+#define HUGEPAGES_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <iostream>
+#include <stdint.h>
+#include <sys/mman.h>
+#include "MemoryAccounting.h"
+
+using namespace std;
+
+// 2 MB pages for what random point queries touch: leaf pages, child map nodes and model weights,
+// which all come from the nodes' arenas. A PageSource maps regions of whole 2 MB pages and hands
+// them out as arena blocks, so the blocks of many small nodes share huge pages. EXPLICIT maps
+// regions with MAP_HUGETLB from the pool reserved in /proc/sys/vm/nr_hugepages; TRANSPARENT maps
+// 2 MB-aligned memory and asks for transparent huge pages with madvise(MADV_HUGEPAGE). A mode
+// the system refuses falls back to the next one (EXPLICIT, TRANSPARENT, then regular pages) with
+// a warning; get_mapped_bytes tells how much memory each mode actually got.
+namespace huge_pages
+{
+    enum Mode
+    {
+        OFF = 0,
+        TRANSPARENT,
+        EXPLICIT,
+        MODE_NUM
+    };
+
+    const char *const MODE_NAMES[MODE_NUM] = {"off", "transparent", "explicit"};
+    const size_t HUGE_PAGE_SIZE = 2 << 20;
+
+    // -1 for an unknown name
+    inline int parse_mode(string name)
+    {
+        for (int mode = 0; mode < MODE_NUM; mode++)
+        {
+            if (name == MODE_NAMES[mode])
+            {
+                return mode;
+            }
+        }
+        return -1;
+    }
+
+    // Thread-safe; blocks freed by an arena are reused first-fit and regions are unmapped only
+    // when the source is destroyed, so it must outlive every arena using it.
+    class PageSource : public memory_accounting::BlockSource
+    {
+    public:
+        // regions start at one huge page and double up to MAX_REGION_SIZE
+        static const size_t MAX_REGION_SIZE = 32 * HUGE_PAGE_SIZE;
+
+        PageSource(Mode mode) : mode(mode)
+        {
+        }
+
+        PageSource(const PageSource &) = delete;
+        PageSource &operator=(const PageSource &) = delete;
+
+        ~PageSource()
+        {
+            for (Region &region : regions)
+            {
+                munmap(region.data, region.size);
+            }
+        }
+
+        void *allocate_block(size_t &size)
+        {
+            lock_guard<mutex> lock(source_mutex);
+            // whole cache lines, so blocks never share a line
+            size = (size + 63) / 64 * 64;
+            for (size_t i = 0; i < free_blocks.size(); i++)
+            {
+                if (free_blocks[i].size >= size)
+                {
+                    Region block = free_blocks[i];
+                    free_blocks[i] = free_blocks.back();
+                    free_blocks.pop_back();
+                    size = block.size;
+                    return block.data;
+                }
+            }
+            if (cursor == NULL || size > (size_t)(end - cursor))
+            {
+                map_region(size);
+            }
+            char *result = cursor;
+            cursor += size;
+            return result;
+        }
+
+        void free_block(void *block, size_t size)
+        {
+            lock_guard<mutex> lock(source_mutex);
+            free_blocks.push_back({(char *)block, size, OFF});
+        }
+
+        Mode get_mode() const
+        {
+            return mode;
+        }
+
+        long long get_mapped_bytes(Mode backed) const
+        {
+            return mapped_bytes[backed];
+        }
+
+        string get_self() const
+        {
+            string result = "huge_pages:" + string(MODE_NAMES[mode]) + "\n";
+            for (int backed = 0; backed < MODE_NUM; backed++)
+            {
+                result += "mapped_" + string(MODE_NAMES[backed]) + ":" + to_string(mapped_bytes[backed]) + "\n";
+            }
+            return result;
+        }
+
+    private:
+        struct Region
+        {
+            char *data;
+            size_t size;
+            Mode backed;
+        };
+
+        Mode mode;
+        mutex source_mutex;
+        vector<Region> regions;
+        vector<Region> free_blocks;
+        char *cursor = NULL;
+        char *end = NULL;
+        size_t next_region_size = HUGE_PAGE_SIZE;
+        long long mapped_bytes[MODE_NUM] = {0};
+        bool warned[MODE_NUM] = {false};
+
+        void warn(Mode failed, Mode fallback)
+        {
+            if (!warned[failed])
+            {
+                cerr << "huge_pages: " << MODE_NAMES[failed] << " huge pages are unavailable, falling back to " << MODE_NAMES[fallback] << endl;
+                warned[failed] = true;
+            }
+        }
+
+        void map_region(size_t size)
+        {
+            size_t region_size = size > next_region_size ? size : next_region_size;
+            region_size = (region_size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+            next_region_size = next_region_size * 2 > MAX_REGION_SIZE ? MAX_REGION_SIZE : next_region_size * 2;
+
+            Mode backed = mode;
+            char *data = (char *)MAP_FAILED;
+#ifdef MAP_HUGETLB
+            if (backed == EXPLICIT)
+            {
+                data = (char *)mmap(NULL, region_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            }
+#endif
+            if (data == (char *)MAP_FAILED)
+            {
+                if (backed == EXPLICIT)
+                {
+                    warn(EXPLICIT, TRANSPARENT);
+                    backed = TRANSPARENT;
+                }
+                // over-map by one huge page and trim, so the region starts on a 2 MB boundary
+                char *raw = (char *)mmap(NULL, region_size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (raw == (char *)MAP_FAILED)
+                {
+                    throw bad_alloc();
+                }
+                data = (char *)(((uintptr_t)raw + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+                if (data > raw)
+                {
+                    munmap(raw, data - raw);
+                }
+                if (raw + HUGE_PAGE_SIZE > data)
+                {
+                    munmap(data + region_size, raw + HUGE_PAGE_SIZE - data);
+                }
+#ifdef MADV_HUGEPAGE
+                if (backed == TRANSPARENT && madvise(data, region_size, MADV_HUGEPAGE) != 0)
+#else
+                if (backed == TRANSPARENT)
+#endif
+                {
+                    warn(TRANSPARENT, OFF);
+                    backed = OFF;
+                }
+            }
+            regions.push_back({data, region_size, backed});
+            mapped_bytes[backed] += region_size;
+            cursor = data;
+            end = data + region_size;
+        }
+    };
+};
+
+#endif
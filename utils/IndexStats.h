@@ -0,0 +1,194 @@
+#ifndef INDEXSTATS_H
+#define INDEXSTATS_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include "../entities/Mbr.h"
+
+using namespace std;
+
+// Per-node view of a built index for finding the partitions behind slow queries. Each node
+// record holds its place in the tree, its size and model, the span of its model's error and,
+// for last-level nodes, how full its pages are. Records are written as JSON (nodes and both
+// histograms in one document) or CSV (nodes in filename, histograms in filename.error_span.csv
+// and filename.occupancy.csv).
+namespace index_stats
+{
+    // why a node became a last-level or a non-leaf node, see RSMIConfig::adaptive
+    enum Decision
+    {
+        FIXED = 0,
+        SMALL,
+        FIT,
+        MISFIT,
+        LARGE,
+        // the non-leaf model put every point into one child, see RSMI::MAX_RETRAIN_NUM
+        UNSPLIT,
+        DECISION_NUM
+    };
+
+    const char *const DECISION_NAMES[DECISION_NUM] = {"fixed", "small", "fit", "misfit", "large", "unsplit"};
+
+    struct NodeStats
+    {
+        int id;
+        // -1 for the root
+        int parent;
+        int level;
+        bool is_last;
+        long long N;
+        // children of a non-leaf node, pages of a last-level node
+        int fanout;
+        int model_width;
+        int min_error;
+        int max_error;
+        // points / (pages * PAGESIZE), 0 for non-leaf nodes
+        double fill_factor;
+        double mbr_area;
+        // summed intersection area of the node's MBR with its siblings' MBRs
+        double sibling_overlap;
+        string curve;
+        string decision;
+        // coefficient of variation of the node's points over an 8x8 grid of their bounding box
+        double skew;
+        // mean error in pages of the trial model, -1 if none was trained
+        double trial_error;
+    };
+
+    struct Bucket
+    {
+        long long low;
+        long long high;
+        long long count;
+    };
+
+    // 0 for an empty MBR
+    inline double area(const Mbr &mbr)
+    {
+        return mbr.x2 < mbr.x1 || mbr.y2 < mbr.y1 ? 0 : (double)(mbr.x2 - mbr.x1) * (mbr.y2 - mbr.y1);
+    }
+
+    inline double intersection_area(const Mbr &a, const Mbr &b)
+    {
+        double width = min(a.x2, b.x2) - max(a.x1, b.x1);
+        double height = min(a.y2, b.y2) - max(a.y1, b.y1);
+        return width <= 0 || height <= 0 || area(a) == 0 || area(b) == 0 ? 0 : width * height;
+    }
+
+    // error span (max_error - min_error, in model output units) of last-level nodes in
+    // power-of-two buckets: 0, 1, 2-3, 4-7, ...
+    inline vector<Bucket> error_span_histogram(const vector<NodeStats> &nodes)
+    {
+        vector<Bucket> buckets;
+        for (const NodeStats &node : nodes)
+        {
+            if (!node.is_last)
+            {
+                continue;
+            }
+            long long span = node.max_error - node.min_error;
+            int bucket = 0;
+            while ((1LL << bucket) <= span)
+            {
+                bucket++;
+            }
+            while ((int)buckets.size() <= bucket)
+            {
+                int b = buckets.size();
+                buckets.push_back({b == 0 ? 0 : 1LL << (b - 1), b == 0 ? 0 : (1LL << b) - 1, 0});
+            }
+            buckets[bucket].count++;
+        }
+        return buckets;
+    }
+
+    // pages by occupancy, in tenths of page_size: [0, 10%), [10%, 20%), ..., [90%, 100%]
+    inline vector<Bucket> occupancy_histogram(const vector<int> &page_sizes, int page_size)
+    {
+        vector<Bucket> buckets;
+        for (int b = 0; b < 10; b++)
+        {
+            buckets.push_back({b * 10, b == 9 ? 100 : b * 10 + 9, 0});
+        }
+        for (int size : page_sizes)
+        {
+            int bucket = size * 10 / page_size;
+            bucket = bucket > 9 ? 9 : bucket;
+            buckets[bucket].count++;
+        }
+        return buckets;
+    }
+
+    inline string get_csv_header()
+    {
+        return "id,parent,level,is_last,N,fanout,model_width,min_error,max_error,fill_factor,mbr_area,sibling_overlap,curve,decision,skew,trial_error\n";
+    }
+
+    inline string get_csv(const NodeStats &node)
+    {
+        return to_string(node.id) + "," + to_string(node.parent) + "," + to_string(node.level) + "," + to_string(node.is_last) + "," + to_string(node.N) + "," + to_string(node.fanout) + "," + to_string(node.model_width) + "," + to_string(node.min_error) + "," + to_string(node.max_error) + "," + to_string(node.fill_factor) + "," + to_string(node.mbr_area) + "," + to_string(node.sibling_overlap) + "," + node.curve + "," + node.decision + "," + to_string(node.skew) + "," + to_string(node.trial_error) + "\n";
+    }
+
+    inline string get_json(const NodeStats &node)
+    {
+        return "{\"id\": " + to_string(node.id) + ", \"parent\": " + to_string(node.parent) + ", \"level\": " + to_string(node.level) + ", \"is_last\": " + (node.is_last ? "true" : "false") + ", \"N\": " + to_string(node.N) + ", \"fanout\": " + to_string(node.fanout) + ", \"model_width\": " + to_string(node.model_width) + ", \"min_error\": " + to_string(node.min_error) + ", \"max_error\": " + to_string(node.max_error) + ", \"fill_factor\": " + to_string(node.fill_factor) + ", \"mbr_area\": " + to_string(node.mbr_area) + ", \"sibling_overlap\": " + to_string(node.sibling_overlap) + ", \"curve\": \"" + node.curve + "\", \"decision\": \"" + node.decision + "\", \"skew\": " + to_string(node.skew) + ", \"trial_error\": " + to_string(node.trial_error) + "}";
+    }
+
+    inline string get_json(const vector<Bucket> &buckets)
+    {
+        string result = "[";
+        for (size_t i = 0; i < buckets.size(); i++)
+        {
+            result += string(i == 0 ? "" : ", ") + "{\"low\": " + to_string(buckets[i].low) + ", \"high\": " + to_string(buckets[i].high) + ", \"count\": " + to_string(buckets[i].count) + "}";
+        }
+        return result + "]";
+    }
+
+    inline void write_buckets(string filename, const vector<Bucket> &buckets)
+    {
+        ofstream write(filename, ios::out);
+        write << "low,high,count" << endl;
+        for (const Bucket &bucket : buckets)
+        {
+            write << bucket.low << "," << bucket.high << "," << bucket.count << endl;
+        }
+        write.close();
+    }
+
+    // format is "json" or "csv"; page_sizes holds the points in every page of capacity page_size
+    inline void write(string filename, string format, const vector<NodeStats> &nodes, const vector<int> &page_sizes, int page_size)
+    {
+        vector<Bucket> error_spans = error_span_histogram(nodes);
+        vector<Bucket> occupancy = occupancy_histogram(page_sizes, page_size);
+        ofstream write(filename, ios::out);
+        if (format == "csv")
+        {
+            write << get_csv_header();
+            for (const NodeStats &node : nodes)
+            {
+                write << get_csv(node);
+            }
+            write_buckets(filename + ".error_span.csv", error_spans);
+            write_buckets(filename + ".occupancy.csv", occupancy);
+        }
+        else
+        {
+            write << "{" << endl;
+            write << "  \"nodes\": [" << endl;
+            for (size_t i = 0; i < nodes.size(); i++)
+            {
+                write << "    " << get_json(nodes[i]) << (i + 1 < nodes.size() ? "," : "") << endl;
+            }
+            write << "  ]," << endl;
+            write << "  \"error_span_histogram\": " << get_json(error_spans) << "," << endl;
+            write << "  \"leaf_occupancy_histogram\": " << get_json(occupancy) << endl;
+            write << "}" << endl;
+        }
+        write.close();
+    }
+};
+
+#endif
@@ -0,0 +1,289 @@
+#ifndef MLP_H
+#define MLP_H
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <random>
+#include <math.h>
+#include <cmath>
+#include <string.h>
+
+#include <xmmintrin.h>
+
+using namespace std;
+
+// Self-contained trainer for the input_width -> width -> 1 ReLU network used by RSMI and ZM.
+// It mirrors torch::nn::Linear + torch::optim::Adam + torch::mse_loss (full batch, same default
+// initialisation) so models trained here are interchangeable with the libtorch backend.
+// Hidden units are padded to a multiple of 4 and processed with SSE; padded units have zero
+// weights and therefore zero gradients, so they never influence the result.
+class MLP
+{
+public:
+    static const int MAX_INPUT_WIDTH = 4;
+
+    int input_width = 0;
+    int width = 0;
+    int padded_width = 0;
+
+    float *w1[MAX_INPUT_WIDTH];
+    float *b1 = NULL;
+    float *w2 = NULL;
+    float b2 = 0.0;
+
+    MLP(int input_width, int width, float weight_low, float weight_high)
+    {
+        this->input_width = input_width;
+        this->width = width;
+        this->padded_width = (width + 3) / 4 * 4;
+        for (int d = 0; d < MAX_INPUT_WIDTH; d++)
+        {
+            w1[d] = d < input_width ? alloc() : NULL;
+        }
+        b1 = alloc();
+        w2 = alloc();
+
+        // torch::nn::Linear draws biases from U(-1/sqrt(fan_in), 1/sqrt(fan_in))
+        mt19937 &gen = generator();
+        uniform_real_distribution<float> weight_dist(weight_low, weight_high);
+        uniform_real_distribution<float> b1_dist(-1.0 / sqrt(input_width), 1.0 / sqrt(input_width));
+        uniform_real_distribution<float> b2_dist(-1.0 / sqrt(width), 1.0 / sqrt(width));
+        for (int i = 0; i < width; i++)
+        {
+            for (int d = 0; d < input_width; d++)
+            {
+                w1[d][i] = weight_dist(gen);
+            }
+            b1[i] = b1_dist(gen);
+        }
+        for (int i = 0; i < width; i++)
+        {
+            w2[i] = weight_dist(gen);
+        }
+        b2 = b2_dist(gen);
+    }
+
+    ~MLP()
+    {
+        for (int d = 0; d < input_width; d++)
+        {
+            _mm_free(w1[d]);
+        }
+        _mm_free(b1);
+        _mm_free(w2);
+    }
+
+    MLP(const MLP &) = delete;
+    MLP &operator=(const MLP &) = delete;
+
+    float predict(const float *x) const
+    {
+        __m128 zeros = _mm_setzero_ps();
+        __m128 sum = _mm_setzero_ps();
+        for (int i = 0; i < padded_width; i += 4)
+        {
+            __m128 h = _mm_load_ps(b1 + i);
+            for (int d = 0; d < input_width; d++)
+            {
+                h = _mm_add_ps(h, _mm_mul_ps(_mm_set1_ps(x[d]), _mm_load_ps(w1[d] + i)));
+            }
+            h = _mm_max_ps(h, zeros);
+            sum = _mm_add_ps(sum, _mm_mul_ps(h, _mm_load_ps(w2 + i)));
+        }
+        return hsum(sum) + b2;
+    }
+
+    // x holds N rows of input_width floats, y holds N labels. The N rows are split into
+    // batch_num chunks and one Adam step is taken per chunk, as Net::train_model does.
+    void train(const float *x, const float *y, long long N, int epochs, float learning_rate, int batch_num = 1)
+    {
+        const int param_num = (input_width + 2) * padded_width + 1;
+        vector<float> params(param_num), grads(param_num), m(param_num, 0), v(param_num, 0);
+        const float beta1 = 0.9, beta2 = 0.999, eps = 1e-8;
+        long long chunk = (N + batch_num - 1) / batch_num;
+        long long step = 0;
+        for (int epoch = 0; epoch < epochs; epoch++)
+        {
+            for (long long begin = 0; begin < N; begin += chunk)
+            {
+                long long end = begin + chunk > N ? N : begin + chunk;
+                gradient(x + begin * input_width, y + begin, end - begin, grads.data());
+                step++;
+                float correction1 = 1 - pow(beta1, step);
+                float correction2 = 1 - pow(beta2, step);
+                float step_size = learning_rate / correction1;
+                pack(params.data());
+                for (int i = 0; i < param_num; i++)
+                {
+                    m[i] = beta1 * m[i] + (1 - beta1) * grads[i];
+                    v[i] = beta2 * v[i] + (1 - beta2) * grads[i] * grads[i];
+                    params[i] -= step_size * m[i] / (sqrt(v[i] / correction2) + eps);
+                }
+                unpack(params.data());
+            }
+        }
+    }
+
+    void save(ofstream &out) const
+    {
+        out.write((const char *)&input_width, sizeof(int));
+        out.write((const char *)&width, sizeof(int));
+        for (int d = 0; d < input_width; d++)
+        {
+            out.write((const char *)w1[d], sizeof(float) * width);
+        }
+        out.write((const char *)b1, sizeof(float) * width);
+        out.write((const char *)w2, sizeof(float) * width);
+        out.write((const char *)&b2, sizeof(float));
+    }
+
+    bool load(ifstream &in)
+    {
+        int saved_input_width = 0;
+        int saved_width = 0;
+        in.read((char *)&saved_input_width, sizeof(int));
+        in.read((char *)&saved_width, sizeof(int));
+        if (!in || saved_input_width != input_width || saved_width != width)
+        {
+            return false;
+        }
+        for (int d = 0; d < input_width; d++)
+        {
+            in.read((char *)w1[d], sizeof(float) * width);
+        }
+        in.read((char *)b1, sizeof(float) * width);
+        in.read((char *)w2, sizeof(float) * width);
+        in.read((char *)&b2, sizeof(float));
+        return (bool)in;
+    }
+
+    // bytes of the padded parameter arrays kept after training
+    long long get_memory_size() const
+    {
+        return (input_width + 2LL) * padded_width * sizeof(float);
+    }
+
+private:
+    static const int ACCUMULATE_BLOCK = 256;
+
+    float *alloc()
+    {
+        float *result = (float *)_mm_malloc(padded_width * sizeof(float), 16);
+        memset(result, 0, padded_width * sizeof(float));
+        return result;
+    }
+
+    static mt19937 &generator()
+    {
+        static thread_local mt19937 gen(67280421);
+        return gen;
+    }
+
+    static float hsum(__m128 v)
+    {
+        float lanes[4];
+        _mm_storeu_ps(lanes, v);
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+
+    // gradients of mean squared error, laid out as w1[0..input_width), b1, w2, b2.
+    // Per-sample contributions are summed in float over short blocks and then folded into
+    // double totals so large partitions do not lose precision.
+    void gradient(const float *x, const float *y, long long n, float *grads)
+    {
+        const int blocks = padded_width / 4;
+        const int param_num = (input_width + 2) * padded_width;
+        vector<double> total(param_num + 1, 0);
+        float *partial = (float *)_mm_malloc(param_num * sizeof(float), 16);
+        float *hidden = (float *)_mm_malloc(padded_width * sizeof(float), 16);
+        float *gw1[MAX_INPUT_WIDTH];
+        for (int d = 0; d < input_width; d++)
+        {
+            gw1[d] = partial + d * padded_width;
+        }
+        float *gb1 = partial + input_width * padded_width;
+        float *gw2 = gb1 + padded_width;
+        const float scale = 2.0 / n;
+        __m128 zeros = _mm_setzero_ps();
+
+        for (long long begin = 0; begin < n; begin += ACCUMULATE_BLOCK)
+        {
+            long long end = begin + ACCUMULATE_BLOCK > n ? n : begin + ACCUMULATE_BLOCK;
+            memset(partial, 0, param_num * sizeof(float));
+            double gb2 = 0;
+            for (long long k = begin; k < end; k++)
+            {
+                const float *xk = x + k * input_width;
+                // forward
+                __m128 sum = _mm_setzero_ps();
+                for (int b = 0; b < blocks; b++)
+                {
+                    int i = b * 4;
+                    __m128 h = _mm_load_ps(b1 + i);
+                    for (int d = 0; d < input_width; d++)
+                    {
+                        h = _mm_add_ps(h, _mm_mul_ps(_mm_set1_ps(xk[d]), _mm_load_ps(w1[d] + i)));
+                    }
+                    h = _mm_max_ps(h, zeros);
+                    _mm_store_ps(hidden + i, h);
+                    sum = _mm_add_ps(sum, _mm_mul_ps(h, _mm_load_ps(w2 + i)));
+                }
+                float g = scale * (hsum(sum) + b2 - y[k]);
+                gb2 += g;
+                // backward
+                __m128 g4 = _mm_set1_ps(g);
+                for (int b = 0; b < blocks; b++)
+                {
+                    int i = b * 4;
+                    __m128 h = _mm_load_ps(hidden + i);
+                    _mm_store_ps(gw2 + i, _mm_add_ps(_mm_load_ps(gw2 + i), _mm_mul_ps(g4, h)));
+                    __m128 active = _mm_cmpgt_ps(h, zeros);
+                    __m128 gh = _mm_and_ps(_mm_mul_ps(g4, _mm_load_ps(w2 + i)), active);
+                    _mm_store_ps(gb1 + i, _mm_add_ps(_mm_load_ps(gb1 + i), gh));
+                    for (int d = 0; d < input_width; d++)
+                    {
+                        __m128 gw = _mm_mul_ps(gh, _mm_set1_ps(xk[d]));
+                        _mm_store_ps(gw1[d] + i, _mm_add_ps(_mm_load_ps(gw1[d] + i), gw));
+                    }
+                }
+            }
+            for (int i = 0; i < param_num; i++)
+            {
+                total[i] += partial[i];
+            }
+            total[param_num] += gb2;
+        }
+        for (int i = 0; i <= param_num; i++)
+        {
+            grads[i] = total[i];
+        }
+        _mm_free(partial);
+        _mm_free(hidden);
+    }
+
+    void pack(float *params) const
+    {
+        for (int d = 0; d < input_width; d++)
+        {
+            memcpy(params + d * padded_width, w1[d], padded_width * sizeof(float));
+        }
+        memcpy(params + input_width * padded_width, b1, padded_width * sizeof(float));
+        memcpy(params + (input_width + 1) * padded_width, w2, padded_width * sizeof(float));
+        params[(input_width + 2) * padded_width] = b2;
+    }
+
+    void unpack(const float *params)
+    {
+        for (int d = 0; d < input_width; d++)
+        {
+            memcpy(w1[d], params + d * padded_width, padded_width * sizeof(float));
+        }
+        memcpy(b1, params + input_width * padded_width, padded_width * sizeof(float));
+        memcpy(w2, params + (input_width + 1) * padded_width, padded_width * sizeof(float));
+        b2 = params[(input_width + 2) * padded_width];
+    }
+};
+
+#endif
@@ -0,0 +1,302 @@
+#ifndef MEMORYACCOUNTING_H
+#define MEMORYACCOUNTING_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+// Byte counts of the memory an index really holds, by component. Containers of an index take
+// an Allocator bound to the index's Account, so every node of its directory map, every page
+// and every growth of a vector is charged when it is allocated and credited when it is freed;
+// model parameters are charged by the Net that owns them. Counts include the containers'
+// spare capacity and the map's per-node overhead, but not the malloc headers around them.
+// Containers whose Allocator draws from an Arena are charged by the Arena's blocks instead.
+namespace memory_accounting
+{
+    enum Component
+    {
+        // model parameters, including the trainer's copy and the shared_ptr control blocks
+        MODELS = 0,
+        // the map of child nodes, the nodes themselves and the arrays of page headers
+        DIRECTORY,
+        // points stored in leaf pages, with the pages' spare capacity
+        LEAF_POINTS,
+        // staging arrays used while building
+        BUFFERS,
+        COMPONENT_NUM
+    };
+
+    const char *const COMPONENT_NAMES[COMPONENT_NUM] = {"models", "directory", "leaf_points", "buffers"};
+
+    struct Usage
+    {
+        long long bytes[COMPONENT_NUM] = {0};
+        // high-water mark of every component since the account was created
+        long long peak_bytes[COMPONENT_NUM] = {0};
+        long long allocations[COMPONENT_NUM] = {0};
+
+        long long total() const
+        {
+            long long result = 0;
+            for (int c = 0; c < COMPONENT_NUM; c++)
+            {
+                result += bytes[c];
+            }
+            return result;
+        }
+
+        string get_self() const
+        {
+            string result;
+            for (int c = 0; c < COMPONENT_NUM; c++)
+            {
+                string name = COMPONENT_NAMES[c];
+                result += "memory_" + name + ":" + to_string(bytes[c]) + "\n" + "memory_" + name + "_peak:" + to_string(peak_bytes[c]) + "\n" + "memory_" + name + "_allocations:" + to_string(allocations[c]) + "\n";
+            }
+            return result + "memory_total:" + to_string(total()) + "\n";
+        }
+    };
+
+    // counters are atomic: leaf models are trained and charged concurrently
+    class Account
+    {
+    public:
+        void charge(Component component, long long size)
+        {
+            long long current = bytes[component].fetch_add(size, memory_order_relaxed) + size;
+            long long peak = peak_bytes[component].load(memory_order_relaxed);
+            while (current > peak && !peak_bytes[component].compare_exchange_weak(peak, current, memory_order_relaxed))
+            {
+            }
+            allocations[component].fetch_add(1, memory_order_relaxed);
+        }
+
+        void credit(Component component, long long size)
+        {
+            bytes[component].fetch_sub(size, memory_order_relaxed);
+        }
+
+        Usage get_usage() const
+        {
+            Usage usage;
+            for (int c = 0; c < COMPONENT_NUM; c++)
+            {
+                usage.bytes[c] = bytes[c].load(memory_order_relaxed);
+                usage.peak_bytes[c] = peak_bytes[c].load(memory_order_relaxed);
+                usage.allocations[c] = allocations[c].load(memory_order_relaxed);
+            }
+            return usage;
+        }
+
+        // memory outside of any index, e.g., the per-thread training stage
+        static Account &global()
+        {
+            static Account account;
+            return account;
+        }
+
+    private:
+        atomic<long long> bytes[COMPONENT_NUM] = {};
+        atomic<long long> peak_bytes[COMPONENT_NUM] = {};
+        atomic<long long> allocations[COMPONENT_NUM] = {};
+    };
+
+    // where an Arena gets its blocks from instead of malloc, e.g., huge pages; size may be
+    // raised to the size of the block actually handed out
+    class BlockSource
+    {
+    public:
+        virtual void *allocate_block(size_t &size) = 0;
+        virtual void free_block(void *block, size_t size) = 0;
+        virtual ~BlockSource()
+        {
+        }
+    };
+
+    // Bump allocator for objects that live and die together, such as the pages and child map
+    // of one RSMI node. Memory comes from blocks that double from MIN_BLOCK_SIZE up to
+    // MAX_BLOCK_SIZE (or fit a larger request exactly), from malloc or a BlockSource; nothing
+    // is freed until release() or the destructor frees every block at once. Each block is charged to account under the
+    // component of the request that opened it. Not thread-safe.
+    class Arena
+    {
+    public:
+        static const size_t MIN_BLOCK_SIZE = 4096;
+        static const size_t MAX_BLOCK_SIZE = 1 << 20;
+
+        Arena(Account *account = &Account::global()) : account(account)
+        {
+        }
+
+        // blocks opened from now on come from source, or from malloc if it is NULL
+        void set_source(BlockSource *source)
+        {
+            this->source = source;
+        }
+
+        Arena(const Arena &) = delete;
+        Arena &operator=(const Arena &) = delete;
+
+        ~Arena()
+        {
+            release();
+        }
+
+        void *allocate(size_t size, size_t alignment, Component component)
+        {
+            size_t offset = (alignment - (size_t)cursor % alignment) % alignment;
+            if (cursor == NULL || offset + size > (size_t)(end - cursor))
+            {
+                add_block(size + alignment, component);
+                offset = (alignment - (size_t)cursor % alignment) % alignment;
+            }
+            char *result = cursor + offset;
+            cursor = result + size;
+            return result;
+        }
+
+        // makes the next size bytes come from one block, e.g., all pages of a node
+        void reserve(size_t size, Component component)
+        {
+            if (cursor == NULL || size > (size_t)(end - cursor))
+            {
+                add_block(size, component);
+            }
+        }
+
+        void release()
+        {
+            for (Block &block : blocks)
+            {
+                account->credit(block.component, block.size);
+                if (block.source != NULL)
+                {
+                    block.source->free_block(block.data, block.size);
+                }
+                else
+                {
+                    free(block.data);
+                }
+            }
+            blocks.clear();
+            cursor = NULL;
+            end = NULL;
+            next_block_size = MIN_BLOCK_SIZE;
+        }
+
+        Account *get_account() const
+        {
+            return account;
+        }
+
+        long long get_block_num() const
+        {
+            return blocks.size();
+        }
+
+    private:
+        struct Block
+        {
+            char *data;
+            size_t size;
+            Component component;
+            BlockSource *source;
+        };
+
+        Account *account;
+        BlockSource *source = NULL;
+        vector<Block> blocks;
+        char *cursor = NULL;
+        char *end = NULL;
+        size_t next_block_size = MIN_BLOCK_SIZE;
+
+        void add_block(size_t size, Component component)
+        {
+            size_t block_size = size > next_block_size ? size : next_block_size;
+            next_block_size = next_block_size * 2 > MAX_BLOCK_SIZE ? MAX_BLOCK_SIZE : next_block_size * 2;
+            char *data = source != NULL ? (char *)source->allocate_block(block_size) : (char *)malloc(block_size);
+            if (data == NULL)
+            {
+                throw bad_alloc();
+            }
+            account->charge(component, block_size);
+            blocks.push_back({data, block_size, component, source});
+            cursor = data;
+            end = data + block_size;
+        }
+    };
+
+    // std::allocator that charges component of account, or draws from arena when it has one;
+    // copies, including rebound copies made by maps and shared_ptrs, use the same source
+    template <class T, Component C>
+    struct Allocator
+    {
+        typedef T value_type;
+
+        Account *account;
+        Arena *arena = NULL;
+
+        Allocator(Account *account = &Account::global()) : account(account)
+        {
+        }
+
+        Allocator(Arena *arena) : account(arena->get_account()), arena(arena)
+        {
+        }
+
+        template <class U>
+        Allocator(const Allocator<U, C> &other) : account(other.account), arena(other.arena)
+        {
+        }
+
+        template <class U>
+        struct rebind
+        {
+            typedef Allocator<U, C> other;
+        };
+
+        T *allocate(size_t n)
+        {
+            if (arena != NULL)
+            {
+                return (T *)arena->allocate(n * sizeof(T), alignof(T), C);
+            }
+            account->charge(C, n * sizeof(T));
+            return std::allocator<T>().allocate(n);
+        }
+
+        // arena memory is freed with the arena
+        void deallocate(T *p, size_t n)
+        {
+            if (arena != NULL)
+            {
+                return;
+            }
+            account->credit(C, n * sizeof(T));
+            std::allocator<T>().deallocate(p, n);
+        }
+
+        template <class U>
+        bool operator==(const Allocator<U, C> &other) const
+        {
+            return account == other.account && arena == other.arena;
+        }
+
+        template <class U>
+        bool operator!=(const Allocator<U, C> &other) const
+        {
+            return !(*this == other);
+        }
+    };
+
+    template <class T>
+    using Buffer = vector<T, Allocator<T, BUFFERS>>;
+};
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef MODELSTORE_H
+#define MODELSTORE_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <stdint.h>
+#include <string.h>
+#include "Constants.h"
+#include "ModelTools.h"
+#include "util.h"
+
+using namespace std;
+
+// Persistent store of trained models. A model is saved under a hash of everything that
+// determines its training: the training inputs (point locations and labels), the level of the
+// node, the model shape, the training hyperparameters and the backend. A rebuild over the same
+// partition therefore finds its model again, while any change to the data invalidates it.
+class ModelStore
+{
+public:
+    string root;
+
+    ModelStore()
+    {
+    }
+
+    ModelStore(string root)
+    {
+        this->root = root;
+        if (enabled())
+        {
+            file_utils::check_dir(root);
+        }
+    }
+
+    bool enabled() const
+    {
+        return !root.empty();
+    }
+
+    // attempt distinguishes the retrained models of a non-leaf node that failed to partition;
+    // the shape and hyperparameters are those of net
+    static uint64_t key(const float *locations, const float *labels, long long N, const Net &net, int level, int attempt)
+    {
+        uint64_t h = 1469598103934665603ULL;
+        h = mix(h, N);
+        h = mix(h, net.input_width);
+        h = mix(h, level);
+        h = mix(h, net.width);
+        h = mix(h, attempt);
+        h = mix(h, net.epoch);
+        h = mix(h, net.max_width);
+        uint64_t learning_rate;
+        double lr = net.learning_rate;
+        memcpy(&learning_rate, &lr, sizeof(lr));
+        h = mix(h, learning_rate);
+        h = mix(h, BACKEND_TAG);
+        h = mix(h, locations, N * net.input_width);
+        h = mix(h, labels, N);
+        return h;
+    }
+
+    string path(uint64_t key) const
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.model", (unsigned long long)key);
+        return root + name;
+    }
+
+    bool load(Net &net, uint64_t key) const
+    {
+        if (!enabled())
+        {
+            return false;
+        }
+        string model_path = path(key);
+        std::ifstream fin(model_path);
+        if (!fin)
+        {
+            return false;
+        }
+        fin.close();
+        return net.load_model(model_path);
+    }
+
+    void save(Net &net, uint64_t key) const
+    {
+        if (enabled())
+        {
+            net.save_model(path(key));
+        }
+    }
+
+private:
+#ifdef use_torch
+    static const uint64_t BACKEND_TAG = 1;
+#else
+    static const uint64_t BACKEND_TAG = 2;
+#endif
+
+    static uint64_t mix(uint64_t h, uint64_t value)
+    {
+        h ^= value;
+        h *= 1099511628211ULL;
+        h ^= h >> 29;
+        return h;
+    }
+
+    static uint64_t mix(uint64_t h, const float *values, long long length)
+    {
+        const uint32_t *words = (const uint32_t *)values;
+        long long i = 0;
+        for (; i + 1 < length; i += 2)
+        {
+            h = mix(h, ((uint64_t)words[i] << 32) | words[i + 1]);
+        }
+        if (i < length)
+        {
+            h = mix(h, words[i]);
+        }
+        return h;
+    }
+};
+
+#endif
@@ -10,7 +10,15 @@
 #include <random>
 #include <math.h>
 #include <cmath>
+#include <chrono>
+#include <memory>
+#include <string.h>
 
+#include "Constants.h"
+#include "../entities/Point.h"
+#include "MemoryAccounting.h"
+
+#ifdef use_torch
 #include <torch/script.h>
 #include <ATen/ATen.h>
 #include <torch/torch.h>
@@ -20,16 +28,47 @@
 #include <torch/optim.h>
 #include <torch/types.h>
 #include <torch/utils.h>
+#else
+#include "MLP.h"
+#endif
 
 #include <xmmintrin.h> //SSE指令集需包含词头文件
 // #include <immintrin.h>
 
+#ifdef use_torch
 using namespace at;
 using namespace torch::nn;
 using namespace torch::optim;
+#endif
 using namespace std;
 
+// Per-thread staging buffer for training inputs. It is reused by every model trained on the
+// thread, so building thousands of leaf models does not allocate fresh input vectors each time.
+struct TrainingStage
+{
+    memory_accounting::Buffer<float> locations;
+    memory_accounting::Buffer<float> labels;
+
+    void resize(long long N, int input_width)
+    {
+        locations.resize(N * input_width);
+        labels.resize(N);
+    }
+};
+
+inline TrainingStage &training_stage()
+{
+    static thread_local TrainingStage stage;
+    return stage;
+}
+
+// Backend is chosen at compile time: define use_torch to train with libtorch,
+// otherwise the built-in MLP trainer (utils/MLP.h) is used.
+#ifdef use_torch
 struct Net : torch::nn::Module
+#else
+struct Net
+#endif
 {
 
 public:
@@ -38,109 +77,271 @@ public:
     int min_error = 0;
     int width = 0;
 
-    float learning_rate = Constants::LEARNING_RATE;
+    double learning_rate = Constants::LEARNING_RATE;
+    int epoch = Constants::EPOCH;
+    // upper bound of width, part of the model's identity in the model store
+    int max_width = Constants::HIDDEN_LAYER_WIDTH;
 
-    float w1[Constants::HIDDEN_LAYER_WIDTH * 2];
-    float w1_[Constants::HIDDEN_LAYER_WIDTH];
-    float w2[Constants::HIDDEN_LAYER_WIDTH];
-    float b1[Constants::HIDDEN_LAYER_WIDTH];
+    // parameter arrays of width floats (w1 of 2 * width), allocated once width is known
+    float *w1 = NULL;
+    float *w1_ = NULL;
+    float *w2 = NULL;
+    float *b1 = NULL;
 
-    float *w1_0 = (float *)_mm_malloc(Constants::HIDDEN_LAYER_WIDTH * sizeof(float), 32);
-    float *w1_1 = (float *)_mm_malloc(Constants::HIDDEN_LAYER_WIDTH * sizeof(float), 32);
-    float *w2_ = (float *)_mm_malloc(Constants::HIDDEN_LAYER_WIDTH * sizeof(float), 32);
-    float *b1_ = (float *)_mm_malloc(Constants::HIDDEN_LAYER_WIDTH * sizeof(float), 32);
+    float *w1_0 = NULL;
+    float *w1_1 = NULL;
+    float *w2_ = NULL;
+    float *b1_ = NULL;
 
-    float *w1__ = (float *)_mm_malloc(Constants::HIDDEN_LAYER_WIDTH * sizeof(float), 32);
+    float *w1__ = NULL;
+
+    // one weight column per input for d-input models (RSMIND); the first two share w1_0 and w1_1
+    static const int MAX_INPUT_WIDTH = 4;
+    float *w1_d[MAX_INPUT_WIDTH] = {NULL, NULL, NULL, NULL};
 
     float b2 = 0.0;
 
-    Net(int input_width)
+    // nanoseconds spent wrapping training inputs, excluding the optimisation itself
+    long long setup_time = 0;
+
+    // account charged with the parameters, see set_account
+    memory_accounting::Account *account = NULL;
+    long long memory_size = 0;
+    // holds the parameter arrays when given to the constructor, e.g., the arena of the node
+    // owning the model, so they sit next to its pages and are freed with them
+    memory_accounting::Arena *arena = NULL;
+
+    // the SSE kernels load whole blocks of 4, so every array is 32-byte aligned and padded
+    float *allocate(int length)
     {
-        this->width = Constants::HIDDEN_LAYER_WIDTH;
-        this->input_width = input_width;
-        fc1 = register_module("fc1", torch::nn::Linear(input_width, width));
-        fc2 = register_module("fc2", torch::nn::Linear(width, 1));
-        torch::nn::init::uniform_(fc1->weight, 0, 1);
-        torch::nn::init::uniform_(fc2->weight, 0, 1);
-        // torch::nn::init::normal_(fc1->weight, 0, 1);
-        // torch::nn::init::normal_(fc2->weight, 0, 1);
+        int padded = (length + 7) / 8 * 8;
+        float *array = arena != NULL ? (float *)arena->allocate(padded * sizeof(float), 32, memory_accounting::MODELS) : (float *)_mm_malloc(padded * sizeof(float), 32);
+        memset(array, 0, padded * sizeof(float));
+        return array;
+    }
+
+    void allocate_parameters()
+    {
+        w1 = allocate(width * 2);
+        w1_ = allocate(width);
+        w2 = allocate(width);
+        b1 = allocate(width);
+        w1_0 = allocate(width);
+        w1_1 = allocate(width);
+        w2_ = allocate(width);
+        b1_ = allocate(width);
+        w1__ = allocate(width);
+        w1_d[0] = w1_0;
+        w1_d[1] = w1_1;
+        w1_d[2] = allocate(width);
+        w1_d[3] = allocate(width);
+    }
+
+    ~Net()
+    {
+        float *arrays[] = {w1, w1_, w2, b1, w1_0, w1_1, w2_, b1_, w1__, w1_d[2], w1_d[3]};
+        for (float *array : arrays)
+        {
+            if (arena == NULL)
+            {
+                _mm_free(array);
+            }
+        }
+        if (account != NULL)
+        {
+            account->credit(memory_accounting::MODELS, memory_size);
+        }
     }
 
-    // RSMI
-    Net(int input_width, int width)
+    // bytes of the padded parameter arrays, unless an arena holds them, and of the backend's
+    // copy of the parameters; the Net itself is charged by the allocator that created it
+    long long get_memory_size()
     {
-        this->width = width;
-        this->width = this->width >= Constants::HIDDEN_LAYER_WIDTH ? Constants::HIDDEN_LAYER_WIDTH : this->width;
-        // this->width = Constants::HIDDEN_LAYER_WIDTH;
-        // this->width = Constants::HIDDEN_LAYER_WIDTH;
+        long long size = 0;
+        for (int length : {width * 2, width, width, width, width, width, width, width, width, width, width})
+        {
+            size += arena != NULL ? 0 : (length + 7) / 8 * 8 * sizeof(float);
+        }
+#ifdef use_torch
+        for (const torch::Tensor &parameter : this->parameters())
+        {
+            size += parameter.numel() * parameter.element_size();
+        }
+#else
+        size += mlp->get_memory_size();
+#endif
+        return size;
+    }
+
+    // charges the parameters to account until the Net is destroyed
+    void set_account(memory_accounting::Account *account)
+    {
+        memory_size = get_memory_size();
+        this->account = account;
+        account->charge(memory_accounting::MODELS, memory_size);
+    }
+
+#ifdef use_torch
+    Net(int input_width) : Net(input_width, Constants::HIDDEN_LAYER_WIDTH, Constants::HIDDEN_LAYER_WIDTH, 1)
+    {
+    }
+
+    // RSMI: width is capped at max_width, initial weights are uniform in [0, init_range)
+    Net(int input_width, int width, int max_width = Constants::HIDDEN_LAYER_WIDTH, float init_range = 0.1, memory_accounting::Arena *arena = NULL)
+    {
+        this->max_width = max_width;
+        this->width = width >= max_width ? max_width : width;
         this->input_width = input_width;
+        this->arena = arena;
+        allocate_parameters();
         fc1 = register_module("fc1", torch::nn::Linear(input_width, this->width));
         fc2 = register_module("fc2", torch::nn::Linear(this->width, 1));
-        torch::nn::init::uniform_(fc1->weight, 0, 0.1);
-        torch::nn::init::uniform_(fc2->weight, 0, 0.1);
+        torch::nn::init::uniform_(fc1->weight, 0, init_range);
+        torch::nn::init::uniform_(fc2->weight, 0, init_range);
         // torch::nn::init::normal_(fc1->weight, 0, 1);
         // torch::nn::init::normal_(fc2->weight, 0, 1);
     }
 
+    // copies a parameter tensor into host memory with a single contiguous read
+    static void copy_parameter(torch::Tensor parameter, float *target)
+    {
+        torch::Tensor host = parameter.detach().to(torch::kCPU).contiguous();
+        memcpy(target, host.data_ptr<float>(), host.numel() * sizeof(float));
+    }
+
     void get_parameters_ZM()
     {
-        torch::Tensor p1 = this->parameters()[0];
-        torch::Tensor p2 = this->parameters()[1];
-        torch::Tensor p3 = this->parameters()[2];
-        torch::Tensor p4 = this->parameters()[3];
-        p1 = p1.reshape({width, 1});
+        auto parameters = this->parameters();
+        copy_parameter(parameters[0], w1_);
+        copy_parameter(parameters[1], b1);
+        copy_parameter(parameters[2], w2);
+        copy_parameter(parameters[3], &b2);
+        memcpy(w1__, w1_, width * sizeof(float));
+        memcpy(b1_, b1, width * sizeof(float));
+        memcpy(w2_, w2, width * sizeof(float));
+    }
+
+    void get_parameters()
+    {
+        auto parameters = this->parameters();
+        copy_parameter(parameters[0], w1);
+        copy_parameter(parameters[1], b1);
+        copy_parameter(parameters[2], w2);
+        copy_parameter(parameters[3], &b2);
         for (size_t i = 0; i < width; i++)
         {
-            w1_[i] = p1.select(0, i).item().toFloat();
+            w1_0[i] = w1[i * 2];
+            w1_1[i] = w1[i * 2 + 1];
         }
+        memcpy(b1_, b1, width * sizeof(float));
+        memcpy(w2_, w2, width * sizeof(float));
+    }
 
-        p2 = p2.reshape({width, 1});
+    void get_parameters_ND()
+    {
+        auto parameters = this->parameters();
+        vector<float> weights(width * input_width);
+        copy_parameter(parameters[0], weights.data());
+        copy_parameter(parameters[1], b1_);
+        copy_parameter(parameters[2], w2_);
+        copy_parameter(parameters[3], &b2);
         for (size_t i = 0; i < width; i++)
         {
-            b1[i] = p2.select(0, i).item().toFloat();
+            for (int d = 0; d < input_width; d++)
+            {
+                w1_d[d][i] = weights[i * input_width + d];
+            }
         }
+    }
 
-        p3 = p3.reshape({width, 1});
+    void save_model(string path)
+    {
+        torch::serialize::OutputArchive archive;
+        this->save(archive);
+        archive.save_to(path);
+    }
+
+    bool load_model(string path)
+    {
+        torch::serialize::InputArchive archive;
+        archive.load_from(path);
+        this->load(archive);
+        return true;
+    }
+#else
+    std::unique_ptr<MLP> mlp;
+
+    Net(int input_width) : Net(input_width, Constants::HIDDEN_LAYER_WIDTH, Constants::HIDDEN_LAYER_WIDTH, 1)
+    {
+    }
+
+    // RSMI: width is capped at max_width, initial weights are uniform in [0, init_range)
+    Net(int input_width, int width, int max_width = Constants::HIDDEN_LAYER_WIDTH, float init_range = 0.1, memory_accounting::Arena *arena = NULL)
+    {
+        this->max_width = max_width;
+        this->width = width >= max_width ? max_width : width;
+        this->input_width = input_width;
+        this->arena = arena;
+        allocate_parameters();
+        mlp.reset(new MLP(input_width, this->width, 0, init_range));
+    }
+
+    void get_parameters_ZM()
+    {
         for (size_t i = 0; i < width; i++)
         {
-            w2[i] = p3.select(0, i).item().toFloat();
+            w1_[i] = mlp->w1[0][i];
+            w1__[i] = mlp->w1[0][i];
+            b1[i] = mlp->b1[i];
+            b1_[i] = mlp->b1[i];
+            w2[i] = mlp->w2[i];
+            w2_[i] = mlp->w2[i];
         }
-        b2 = p4.item().toFloat();
+        b2 = mlp->b2;
     }
 
     void get_parameters()
     {
-        torch::Tensor p1 = this->parameters()[0];
-        torch::Tensor p2 = this->parameters()[1];
-        torch::Tensor p3 = this->parameters()[2];
-        torch::Tensor p4 = this->parameters()[3];
-        p1 = p1.reshape({2 * width, 1});
         for (size_t i = 0; i < width; i++)
         {
-            w1[i * 2] = p1.select(0, 2 * i).item().toFloat();
-            w1[i * 2 + 1] = p1.select(0, 2 * i + 1).item().toFloat();
-
-            w1_0[i] = p1.select(0, 2 * i).item().toFloat();
-            w1_1[i] = p1.select(0, 2 * i + 1).item().toFloat();
+            w1[i * 2] = mlp->w1[0][i];
+            w1[i * 2 + 1] = mlp->w1[1][i];
+            w1_0[i] = mlp->w1[0][i];
+            w1_1[i] = mlp->w1[1][i];
+            b1[i] = mlp->b1[i];
+            b1_[i] = mlp->b1[i];
+            w2[i] = mlp->w2[i];
+            w2_[i] = mlp->w2[i];
         }
+        b2 = mlp->b2;
+    }
 
-        p2 = p2.reshape({width, 1});
+    void get_parameters_ND()
+    {
         for (size_t i = 0; i < width; i++)
         {
-            b1[i] = p2.select(0, i).item().toFloat();
-
-            b1_[i] = p2.select(0, i).item().toFloat();
+            for (int d = 0; d < input_width; d++)
+            {
+                w1_d[d][i] = mlp->w1[d][i];
+            }
+            b1_[i] = mlp->b1[i];
+            w2_[i] = mlp->w2[i];
         }
+        b2 = mlp->b2;
+    }
 
-        p3 = p3.reshape({width, 1});
-        for (size_t i = 0; i < width; i++)
-        {
-            w2[i] = p3.select(0, i).item().toFloat();
+    void save_model(string path)
+    {
+        ofstream out(path, ios::binary);
+        mlp->save(out);
+    }
 
-            w2_[i] = p3.select(0, i).item().toFloat();
-        }
-        b2 = p4.item().toFloat();
+    bool load_model(string path)
+    {
+        ifstream in(path, ios::binary);
+        return in && mlp->load(in);
     }
+#endif
 
     void print_parameters()
     {
@@ -156,6 +357,7 @@ public:
         cout << endl;
     }
 
+#ifdef use_torch
     torch::Tensor forward(torch::Tensor x)
     {
         // Use one of many tensor manipulation functions.
@@ -176,6 +378,7 @@ public:
         x = fc2->forward(x);
         return x;
     }
+#endif
 
     // float predictZM(float key)
     // {
@@ -188,6 +391,7 @@ public:
     //     return result;
     // }
 
+    // predict_ZM and predict only read the model, so one Net can serve several threads
     float predict_ZM(float key)
     {
         int blocks = width / 4;
@@ -204,9 +408,9 @@ public:
         for (int i = 0; i < blocks; i++)
         {
             // TODO change w1
-            fLoad_w1 = _mm_load_ps(w1__);
-            fLoad_b1 = _mm_load_ps(b1_);
-            fLoad_w2 = _mm_load_ps(w2_);
+            fLoad_w1 = _mm_load_ps(w1__ + i * 4);
+            fLoad_b1 = _mm_load_ps(b1_ + i * 4);
+            fLoad_w2 = _mm_load_ps(w2_ + i * 4);
             temp1 = _mm_mul_ps(fLoad0_x, fLoad_w1);
             temp2 = _mm_add_ps(temp1, fLoad_b1);
 
@@ -214,10 +418,6 @@ public:
 
             temp2 = _mm_mul_ps(temp1, fLoad_w2);
             fSum0 = _mm_add_ps(fSum0, temp2);
-
-            w1__ += 4;
-            b1_ += 4;
-            w2_ += 4;
         }
         result = 0;
         if (blocks > 0)
@@ -226,12 +426,9 @@ public:
         }
         for (size_t i = 0; i < rem; i++)
         {
-            result += activation(key * w1__[i] + b1_[i]) * w2_[i];
+            result += activation(key * w1__[move_back + i] + b1_[move_back + i]) * w2_[move_back + i];
         }
         result += b2;
-        w1__ -= move_back;
-        b1_ -= move_back;
-        w2_ -= move_back;
         return result;
     }
 
@@ -254,10 +451,10 @@ public:
         for (int i = 0; i < blocks; i++)
         {
             // TODO change w1
-            fLoad_w1_1 = _mm_load_ps(w1_0);
-            fLoad_w1_2 = _mm_load_ps(w1_1);
-            fLoad_b1 = _mm_load_ps(b1_);
-            fLoad_w2 = _mm_load_ps(w2_);
+            fLoad_w1_1 = _mm_load_ps(w1_0 + i * 4);
+            fLoad_w1_2 = _mm_load_ps(w1_1 + i * 4);
+            fLoad_b1 = _mm_load_ps(b1_ + i * 4);
+            fLoad_w2 = _mm_load_ps(w2_ + i * 4);
             temp1 = _mm_mul_ps(fLoad0_x1, fLoad_w1_1);
             temp2 = _mm_mul_ps(fLoad0_x2, fLoad_w1_2);
             temp2 = _mm_add_ps(temp1, temp2);
@@ -267,11 +464,6 @@ public:
 
             temp2 = _mm_mul_ps(temp1, fLoad_w2);
             fSum0 = _mm_add_ps(fSum0, temp2);
-
-            w1_0 += 4;
-            w1_1 += 4;
-            b1_ += 4;
-            w2_ += 4;
         }
         result = 0;
         if (blocks > 0)
@@ -280,13 +472,52 @@ public:
         }
         for (size_t i = 0; i < rem; i++)
         {
-            result += activation(x1 * w1_0[i] + x2 * w1_1[i] + b1_[i]) * w2_[i];
+            result += activation(x1 * w1_0[move_back + i] + x2 * w1_1[move_back + i] + b1_[move_back + i]) * w2_[move_back + i];
+        }
+        result += b2;
+        return result;
+    }
+
+    // D-input version of predict, after get_parameters_ND. D is a template parameter so the
+    // loop over inputs is unrolled for every dimension RSMIND is compiled for.
+    template <int D>
+    float predict_ND(const float *x)
+    {
+        int blocks = width / 4;
+        int rem = width % 4;
+        int move_back = blocks * 4;
+        __m128 fLoad0_zeros = _mm_setzero_ps();
+        __m128 fSum0 = _mm_setzero_ps();
+        __m128 fLoad0_x[D];
+        for (int d = 0; d < D; d++)
+        {
+            fLoad0_x[d] = _mm_set1_ps(x[d]);
+        }
+        for (int i = 0; i < blocks; i++)
+        {
+            __m128 temp = _mm_load_ps(b1_ + i * 4);
+            for (int d = 0; d < D; d++)
+            {
+                temp = _mm_add_ps(temp, _mm_mul_ps(fLoad0_x[d], _mm_load_ps(w1_d[d] + i * 4)));
+            }
+            temp = _mm_max_ps(temp, fLoad0_zeros);
+            fSum0 = _mm_add_ps(fSum0, _mm_mul_ps(temp, _mm_load_ps(w2_ + i * 4)));
+        }
+        float result = 0;
+        if (blocks > 0)
+        {
+            result += fSum0[0] + fSum0[1] + fSum0[2] + fSum0[3];
+        }
+        for (int i = 0; i < rem; i++)
+        {
+            float hidden = b1_[move_back + i];
+            for (int d = 0; d < D; d++)
+            {
+                hidden += x[d] * w1_d[d][move_back + i];
+            }
+            result += activation(hidden) * w2_[move_back + i];
         }
         result += b2;
-        w1_0 -= move_back;
-        w1_1 -= move_back;
-        b1_ -= move_back;
-        w2_ -= move_back;
         return result;
     }
 
@@ -312,19 +543,24 @@ public:
         return 0.0;
     }
 
-    void train_model(vector<float> locations, vector<float> labels)
+    void train_model(const vector<float> &locations, const vector<float> &labels)
     {
-        long long N = labels.size();
+        train_model(locations.data(), labels.data(), labels.size());
+    }
 
+#ifdef use_torch
+    // locations holds N rows of input_width floats; both buffers must outlive the call.
+    void train_model(const float *locations, const float *labels, long long N)
+    {
+        auto setup_start = chrono::high_resolution_clock::now();
+        // wrap the caller's buffers instead of copying them into new tensors
+        torch::Tensor x = torch::from_blob(const_cast<float *>(locations), {N, this->input_width}, torch::kFloat);
+        torch::Tensor y = torch::from_blob(const_cast<float *>(labels), {N, 1}, torch::kFloat);
 #ifdef use_gpu
-        torch::Tensor x = torch::tensor(locations, at::kCUDA).reshape({N, this->input_width});
-        torch::Tensor y = torch::tensor(labels, at::kCUDA).reshape({N, 1});
-#else
-        torch::Tensor x = torch::tensor(locations).reshape({N, this->input_width});
-        torch::Tensor y = torch::tensor(labels).reshape({N, 1});
+        x = x.to(at::kCUDA);
+        y = y.to(at::kCUDA);
 #endif
-        // torch::Tensor x = torch::tensor(locations).reshape({N, this->input_width});
-        // torch::Tensor y = torch::tensor(labels).reshape({N, 1});
+        setup_time += chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - setup_start).count();
         // auto net = isRetrain ? this->net : std::make_shared<Net>(2, width);
         // auto net = std::make_shared<Net>(this->input_width, this->width);
         cout << "trained size: " << N << endl;
@@ -336,7 +572,7 @@ public:
 
             auto x_chunks = x.chunk(batch_num, 0);
             auto y_chunks = y.chunk(batch_num, 0);
-            for (size_t epoch = 0; epoch < Constants::EPOCH; epoch++)
+            for (size_t epoch = 0; epoch < this->epoch; epoch++)
             {
                 for (size_t i = 0; i < batch_num; i++)
                 {
@@ -352,7 +588,7 @@ public:
         }
         else
         {
-            for (size_t epoch = 0; epoch < Constants::EPOCH; epoch++)
+            for (size_t epoch = 0; epoch < this->epoch; epoch++)
             {
                 optimizer.zero_grad();
                 torch::Tensor loss = torch::mse_loss(this->forward(x), y);
@@ -367,6 +603,15 @@ public:
     }
 
     torch::nn::Linear fc1{nullptr}, fc2{nullptr};
+#else
+    void train_model(const float *locations, const float *labels, long long N)
+    {
+        cout << "trained size: " << N << endl;
+        int batch_num = N > 64000000 ? 4 : 1;
+        mlp->train(locations, labels, N, this->epoch, this->learning_rate, batch_num);
+        cout << "finish training " << endl;
+    }
+#endif
 };
 
 #endif
\ No newline at end of file
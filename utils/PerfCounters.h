@@ -0,0 +1,226 @@
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <string>
+#include <string.h>
+#include <stdint.h>
+#include <iostream>
+#ifdef use_perf
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+using namespace std;
+
+// Hardware counters per query phase, compiled in with use_perf (make PERF=on). Each thread
+// opens one perf_event_open group counting its own user-space cycles, instructions, L1D and LLC
+// misses, branch misses, task clock and dTLB load misses; a query switches phases with enter() and the counts
+// since the previous switch go to the phase being left, so a switch costs one read() of the
+// group and recursion needs no bookkeeping. Events the kernel or the VM refuses are reported
+// as 0; if none opens, a warning is printed once and every call is a no-op. Without use_perf
+// the calls are empty inline functions.
+namespace perf_counters
+{
+    enum Event
+    {
+        CYCLES = 0,
+        INSTRUCTIONS,
+        L1D_MISSES,
+        LLC_MISSES,
+        BRANCH_MISSES,
+        TASK_CLOCK,
+        DTLB_MISSES,
+        EVENT_NUM
+    };
+
+    enum Phase
+    {
+        NO_PHASE = -1,
+        PREDICT = 0,
+        ROUTE,
+        LEAF_SEARCH,
+        MATERIALIZE,
+        PHASE_NUM
+    };
+
+    const char *const EVENT_NAMES[EVENT_NUM] = {"cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses", "task_clock_ns", "dtlb_misses"};
+    const char *const PHASE_NAMES[PHASE_NUM] = {"predict", "route", "leaf_search", "materialize"};
+
+#ifdef use_perf
+    class Group
+    {
+    public:
+        int leader;
+        int fds[EVENT_NUM];
+        // position of each event in a group read, -1 if it could not be opened
+        int positions[EVENT_NUM];
+        int opened_num;
+
+        Group()
+        {
+            const uint32_t types[EVENT_NUM] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE, PERF_TYPE_HW_CACHE};
+            const uint64_t configs[EVENT_NUM] = {
+                PERF_COUNT_HW_CPU_CYCLES,
+                PERF_COUNT_HW_INSTRUCTIONS,
+                PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+                PERF_COUNT_HW_CACHE_MISSES,
+                PERF_COUNT_HW_BRANCH_MISSES,
+                PERF_COUNT_SW_TASK_CLOCK,
+                PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)};
+            leader = -1;
+            opened_num = 0;
+            for (int event = 0; event < EVENT_NUM; event++)
+            {
+                struct perf_event_attr attr;
+                memset(&attr, 0, sizeof(attr));
+                attr.size = sizeof(attr);
+                attr.type = types[event];
+                attr.config = configs[event];
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                attr.read_format = PERF_FORMAT_GROUP;
+                attr.disabled = leader == -1;
+                fds[event] = syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+                positions[event] = -1;
+                if (fds[event] < 0)
+                {
+                    continue;
+                }
+                if (leader == -1)
+                {
+                    leader = fds[event];
+                }
+                positions[event] = opened_num++;
+            }
+            if (leader == -1)
+            {
+                cerr << "perf_counters: perf_event_open is unavailable, counters are disabled" << endl;
+                return;
+            }
+            ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+
+        ~Group()
+        {
+            for (int event = 0; event < EVENT_NUM; event++)
+            {
+                if (fds[event] >= 0)
+                {
+                    close(fds[event]);
+                }
+            }
+        }
+
+        bool available()
+        {
+            return leader != -1;
+        }
+
+        bool read_counts(uint64_t values[EVENT_NUM])
+        {
+            uint64_t buffer[1 + EVENT_NUM];
+            if (read(leader, buffer, sizeof(buffer)) < (ssize_t)((1 + opened_num) * sizeof(uint64_t)))
+            {
+                return false;
+            }
+            for (int event = 0; event < EVENT_NUM; event++)
+            {
+                values[event] = positions[event] == -1 ? 0 : buffer[1 + positions[event]];
+            }
+            return true;
+        }
+
+        static Group &instance()
+        {
+            static thread_local Group group;
+            return group;
+        }
+    };
+#endif
+
+    // counts per phase, summed over the operations recorded since the last clean()
+    class PhaseCounters
+    {
+    public:
+        long long counts[PHASE_NUM][EVENT_NUM];
+        long long operation_num;
+        int phase;
+        uint64_t last[EVENT_NUM];
+
+        PhaseCounters()
+        {
+            clean();
+        }
+
+        void clean()
+        {
+            memset(counts, 0, sizeof(counts));
+            operation_num = 0;
+            phase = NO_PHASE;
+        }
+
+#ifdef use_perf
+        // charges the counts since the previous call to the current phase and starts phase
+        void enter(int next_phase)
+        {
+            Group &group = Group::instance();
+            uint64_t values[EVENT_NUM];
+            if (!group.available() || !group.read_counts(values))
+            {
+                return;
+            }
+            if (phase != NO_PHASE)
+            {
+                for (int event = 0; event < EVENT_NUM; event++)
+                {
+                    counts[phase][event] += values[event] - last[event];
+                }
+            }
+            memcpy(last, values, sizeof(last));
+            phase = next_phase;
+        }
+
+        // ends one operation
+        void leave()
+        {
+            if (phase == NO_PHASE)
+            {
+                return;
+            }
+            enter(NO_PHASE);
+            operation_num++;
+        }
+#else
+        void enter(int next_phase)
+        {
+        }
+
+        void leave()
+        {
+        }
+#endif
+
+        // "<phase>_<event>:...\n" lines with the mean count per operation
+        string get_counts() const
+        {
+            if (operation_num == 0)
+            {
+                return "";
+            }
+            string result;
+            for (int phase = 0; phase < PHASE_NUM; phase++)
+            {
+                for (int event = 0; event < EVENT_NUM; event++)
+                {
+                    result += string(PHASE_NAMES[phase]) + "_" + EVENT_NAMES[event] + ":" + to_string((double)counts[phase][event] / operation_num) + "\n";
+                }
+            }
+            return result;
+        }
+    };
+};
+
+#endif
@@ -0,0 +1,153 @@
+#ifndef QUERYLOG_H
+#define QUERYLOG_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include <mutex>
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+#include "../entities/Point.h"
+#include "../entities/Mbr.h"
+
+using namespace std;
+
+// Compact binary log of a query stream: a 16-byte header ("RSMIQLOG", version, record size)
+// followed by fixed 32-byte records holding the arrival time in ns since the log was opened,
+// the query type, k, and the query point (x, y) or window (x1, y1, x2, y2). Records are
+// appended under a mutex, so one log can be shared by every thread of a service, and read
+// back sorted by time for replay.
+namespace query_log
+{
+    enum QueryType
+    {
+        POINT = 0,
+        WINDOW,
+        KNN,
+        QUERY_TYPE_NUM
+    };
+
+    const char *const QUERY_TYPE_NAMES[QUERY_TYPE_NUM] = {"point", "window", "knn"};
+    const char MAGIC[8] = {'R', 'S', 'M', 'I', 'Q', 'L', 'O', 'G'};
+    const uint32_t VERSION = 1;
+
+    struct QueryRecord
+    {
+        uint64_t timestamp;
+        uint32_t type;
+        uint32_t k;
+        float values[4];
+
+        Point get_point() const
+        {
+            return Point(values[0], values[1]);
+        }
+
+        Mbr get_window() const
+        {
+            return Mbr(values[0], values[1], values[2], values[3]);
+        }
+    };
+
+    struct QueryLogHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t record_size;
+    };
+
+    class QueryLogWriter
+    {
+        ofstream out;
+        mutex write_mutex;
+        chrono::steady_clock::time_point start;
+
+        void write(uint32_t type, uint32_t k, float v0, float v1, float v2, float v3)
+        {
+            QueryRecord record;
+            record.timestamp = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+            record.type = type;
+            record.k = k;
+            record.values[0] = v0;
+            record.values[1] = v1;
+            record.values[2] = v2;
+            record.values[3] = v3;
+            lock_guard<mutex> lock(write_mutex);
+            out.write((const char *)&record, sizeof(record));
+        }
+
+    public:
+        QueryLogWriter(string filename)
+        {
+            out.open(filename, ios::out | ios::binary);
+            QueryLogHeader header;
+            memcpy(header.magic, MAGIC, sizeof(MAGIC));
+            header.version = VERSION;
+            header.record_size = sizeof(QueryRecord);
+            out.write((const char *)&header, sizeof(header));
+            start = chrono::steady_clock::now();
+        }
+
+        ~QueryLogWriter()
+        {
+            close();
+        }
+
+        bool is_open()
+        {
+            return out.is_open();
+        }
+
+        void record_point(Point point)
+        {
+            write(POINT, 0, point.x, point.y, 0, 0);
+        }
+
+        void record_window(Mbr window)
+        {
+            write(WINDOW, 0, window.x1, window.y1, window.x2, window.y2);
+        }
+
+        void record_kNN(Point point, int k)
+        {
+            write(KNN, k, point.x, point.y, 0, 0);
+        }
+
+        void close()
+        {
+            lock_guard<mutex> lock(write_mutex);
+            if (out.is_open())
+            {
+                out.close();
+            }
+        }
+    };
+
+    // records of filename sorted by timestamp; empty, with a message, if it is not a query log
+    inline vector<QueryRecord> read(string filename)
+    {
+        vector<QueryRecord> records;
+        ifstream in(filename, ios::in | ios::binary);
+        QueryLogHeader header;
+        if (!in.read((char *)&header, sizeof(header)) || memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || header.record_size != sizeof(QueryRecord))
+        {
+            cerr << "query_log: " << filename << " is not a version " << VERSION << " query log" << endl;
+            return records;
+        }
+        QueryRecord record;
+        while (in.read((char *)&record, sizeof(record)))
+        {
+            if (record.type < QUERY_TYPE_NUM)
+            {
+                records.push_back(record);
+            }
+        }
+        stable_sort(records.begin(), records.end(), [](const QueryRecord &a, const QueryRecord &b) { return a.timestamp < b.timestamp; });
+        return records;
+    }
+};
+
+#endif
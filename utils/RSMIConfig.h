@@ -0,0 +1,87 @@
+#ifndef RSMICONFIG_H
+#define RSMICONFIG_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include "Constants.h"
+
+using namespace std;
+
+// Build parameters of an RSMI, given to its constructor and handed down to every node. The
+// defaults are the Constants the index was tuned with in the paper.
+struct RSMIConfig
+{
+    // points per leaf page
+    int page_size = Constants::PAGESIZE;
+    // partitions of at most threshold points get a last-level model
+    int threshold = Constants::THRESHOLD;
+    // a non-leaf node has up to max_width^2 children
+    int max_width = Constants::MAX_WIDTH;
+    int hidden_layer_width = Constants::HIDDEN_LAYER_WIDTH;
+    int epoch = Constants::EPOCH;
+    double learning_rate = Constants::LEARNING_RATE;
+
+    // adaptive: a node of at most threshold / leaf_band points is a last-level node and one of
+    // more than threshold * leaf_band points is split; in between, a model trained for
+    // trial_epoch epochs on a sample decides, and the node is a last-level node if the trial
+    // model's mean error is at most max_trial_error pages. A non-leaf node gets about one
+    // child per threshold points (per threshold / leaf_band points when the skew of its points
+    // exceeds hot_skew), at most max_width^2. Otherwise every non-leaf node has max_width^2
+    // cells and threshold is a hard cutoff.
+    bool adaptive = true;
+    double leaf_band = 2;
+    double max_trial_error = 8;
+    int trial_epoch = Constants::EPOCH;
+    double hot_skew = 2;
+
+    // huge_pages::Mode of the arenas holding pages, model weights and child map nodes
+    int huge_pages = 0;
+
+    // leaf pages keep x and y only, scanned through 16-bit quantized offsets (CompressedPage)
+    bool compressed_pages = false;
+
+    // leaf pages live in this file, which the index creates and removes, and are read through a
+    // buffer pool of buffer_pool_pages frames replaced by buffer_pool::Policy
+    // buffer_pool_policy; empty keeps them in memory
+    string page_file = "";
+    long long buffer_pool_pages = 1024;
+    int buffer_pool_policy = 1;
+    // how queries read pages from page_file, a buffer_pool::ReadMode
+    int read_mode = 0;
+
+    // prints the first bad parameter and returns false
+    bool validate() const
+    {
+        if (page_size < 1 || threshold < page_size || max_width < 2 || hidden_layer_width < 1 || epoch < 1 || learning_rate <= 0 || leaf_band < 1 || trial_epoch < 1 || huge_pages < 0 || huge_pages > 2 || buffer_pool_pages < 2 || buffer_pool_policy < 0 || buffer_pool_policy > 1 || read_mode < 0 || read_mode > 2 || (!page_file.empty() && compressed_pages))
+        {
+            cerr << "RSMIConfig: invalid " << get_self() << "need page_size >= 1, threshold >= page_size, max_width >= 2, leaf_band >= 1, positive model parameters, at least 2 buffer pool pages and no compressed pages on disk" << endl;
+            return false;
+        }
+        return true;
+    }
+
+    string get_self() const
+    {
+        return "page_size:" + to_string(page_size) + "\n" + "threshold:" + to_string(threshold) + "\n" + "max_width:" + to_string(max_width) + "\n" + "hidden_layer_width:" + to_string(hidden_layer_width) + "\n" + "epoch:" + to_string(epoch) + "\n" + "learning_rate:" + to_string(learning_rate) + "\n" + "adaptive:" + to_string(adaptive) + "\n" + "leaf_band:" + to_string(leaf_band) + "\n" + "max_trial_error:" + to_string(max_trial_error) + "\n" + "trial_epoch:" + to_string(trial_epoch) + "\n" + "hot_skew:" + to_string(hot_skew) + "\n" + "huge_pages:" + to_string(huge_pages) + "\n" + "compressed_pages:" + to_string(compressed_pages) + "\n" + "page_file:" + page_file + "\n" + "buffer_pool_pages:" + to_string(buffer_pool_pages) + "\n" + "buffer_pool_policy:" + to_string(buffer_pool_policy) + "\n" + "read_mode:" + to_string(read_mode) + "\n";
+    }
+};
+
+// Search space and objective of RSMI::tune. Every combination of page size, threshold and
+// max width is built on a sample of sample_size points, with the threshold scaled to the
+// sample, and timed on query_num point and window queries; the config with the lowest
+// latency_weight * latency / best latency + memory_weight * size / best size wins.
+struct RSMITuneOptions
+{
+    long long sample_size = 100000;
+    int query_num = 1000;
+    double latency_weight = 1;
+    double memory_weight = 1;
+    vector<int> page_sizes = {50, 100, 200};
+    // thresholds for the full dataset
+    vector<int> thresholds = {Constants::THRESHOLD / 4, Constants::THRESHOLD / 2, Constants::THRESHOLD, Constants::THRESHOLD * 2};
+    vector<int> max_widths = {8, 16, 32};
+    unsigned seed = 42;
+};
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef RADIXSORT_H
+#define RADIXSORT_H
+
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include "ThreadTools.h"
+
+using namespace std;
+
+// LSD radix sort over compact (key, index) pairs. Sorting these instead of Point objects moves
+// 8-16 bytes per element rather than 48, and the caller applies the resulting permutation once.
+// The sort is stable, skips digits that are equal for all keys (e.g. the high bytes of small
+// Hilbert values), and splits histogram and scatter across threads for large inputs.
+namespace radix_sort
+{
+    template <typename K>
+    struct KeyIndex
+    {
+        K key;
+        uint32_t index;
+    };
+
+    const int DIGIT_BITS = 8;
+    const int BUCKET_NUM = 1 << DIGIT_BITS;
+    const long long PARALLEL_THRESHOLD = 1 << 16;
+
+    // maps a float to an unsigned key with the same ordering (negative values included)
+    inline uint32_t float_key(float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+    }
+
+    template <typename K>
+    void sort(vector<KeyIndex<K>> &items, int thread_num = 1)
+    {
+        long long n = items.size();
+        if (n < 2)
+        {
+            return;
+        }
+        if (n < PARALLEL_THRESHOLD)
+        {
+            thread_num = 1;
+        }
+        vector<KeyIndex<K>> buffer(n);
+        KeyIndex<K> *source = items.data();
+        KeyIndex<K> *target = buffer.data();
+        vector<vector<long long>> histograms(thread_num, vector<long long>(BUCKET_NUM));
+        for (int shift = 0; shift < (int)sizeof(K) * 8; shift += DIGIT_BITS)
+        {
+            int chunk_num = thread_utils::parallel_for(0, n, thread_num, [&](int chunk, long long bn, long long en) {
+                vector<long long> &histogram = histograms[chunk];
+                fill(histogram.begin(), histogram.end(), 0);
+                for (long long i = bn; i < en; i++)
+                {
+                    histogram[(source[i].key >> shift) & (BUCKET_NUM - 1)]++;
+                }
+            });
+            // skip the pass if every key has the same digit
+            bool is_trivial = false;
+            for (int bucket = 0; bucket < BUCKET_NUM && !is_trivial; bucket++)
+            {
+                long long count = 0;
+                for (int chunk = 0; chunk < chunk_num; chunk++)
+                {
+                    count += histograms[chunk][bucket];
+                }
+                is_trivial = count == n;
+            }
+            if (is_trivial)
+            {
+                continue;
+            }
+            // turn counts into per-chunk write offsets; chunk order keeps the sort stable
+            long long offset = 0;
+            for (int bucket = 0; bucket < BUCKET_NUM; bucket++)
+            {
+                for (int chunk = 0; chunk < chunk_num; chunk++)
+                {
+                    long long count = histograms[chunk][bucket];
+                    histograms[chunk][bucket] = offset;
+                    offset += count;
+                }
+            }
+            thread_utils::parallel_for(0, n, thread_num, [&](int chunk, long long bn, long long en) {
+                vector<long long> &offsets = histograms[chunk];
+                for (long long i = bn; i < en; i++)
+                {
+                    target[offsets[(source[i].key >> shift) & (BUCKET_NUM - 1)]++] = source[i];
+                }
+            });
+            swap(source, target);
+        }
+        if (source != items.data())
+        {
+            memcpy(items.data(), source, n * sizeof(KeyIndex<K>));
+        }
+    }
+
+    // Stable counting sort of items by a precomputed bucket id in [0, bucket_num): one histogram
+    // pass and one scatter pass into a temporary buffer that is copied back and released.
+    // bucket_begin receives the first position of every bucket, plus n at the end.
+    template <typename T>
+    void partition(T *items, long long n, const int *buckets, int bucket_num, vector<long long> &bucket_begin, int thread_num = 1)
+    {
+        vector<vector<long long>> histograms(thread_num, vector<long long>(bucket_num));
+        int chunk_num = thread_utils::parallel_for(0, n, thread_num, [&](int chunk, long long bn, long long en) {
+            vector<long long> &histogram = histograms[chunk];
+            for (long long i = bn; i < en; i++)
+            {
+                histogram[buckets[i]]++;
+            }
+        });
+        bucket_begin.assign(bucket_num + 1, 0);
+        long long offset = 0;
+        for (int bucket = 0; bucket < bucket_num; bucket++)
+        {
+            bucket_begin[bucket] = offset;
+            for (int chunk = 0; chunk < chunk_num; chunk++)
+            {
+                long long count = histograms[chunk][bucket];
+                histograms[chunk][bucket] = offset;
+                offset += count;
+            }
+        }
+        bucket_begin[bucket_num] = n;
+        vector<T> buffer(n);
+        thread_utils::parallel_for(0, n, thread_num, [&](int chunk, long long bn, long long en) {
+            vector<long long> &offsets = histograms[chunk];
+            for (long long i = bn; i < en; i++)
+            {
+                buffer[offsets[buckets[i]]++] = items[i];
+            }
+        });
+        thread_utils::parallel_for(0, n, thread_num, [&](int, long long bn, long long en) {
+            copy(buffer.begin() + bn, buffer.begin() + en, items + bn);
+        });
+    }
+};
+
+#endif
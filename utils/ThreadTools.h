@@ -0,0 +1,53 @@
+#ifndef THREADTOOLS_H
+#define THREADTOOLS_H
+
+#include <thread>
+#include <vector>
+#include <functional>
+
+using namespace std;
+
+namespace thread_utils
+{
+    inline int default_thread_num()
+    {
+        int thread_num = thread::hardware_concurrency();
+        return thread_num > 0 ? thread_num : 1;
+    }
+
+    // Splits [begin, end) into at most thread_num contiguous chunks and runs
+    // func(chunk_id, chunk_begin, chunk_end) for each chunk on its own thread.
+    // Chunk ids are dense, so callers can keep per-chunk state in a vector.
+    inline int parallel_for(long long begin, long long end, int thread_num, const function<void(int, long long, long long)> &func)
+    {
+        long long length = end - begin;
+        if (length <= 0)
+        {
+            return 0;
+        }
+        if (thread_num > length)
+        {
+            thread_num = length;
+        }
+        if (thread_num <= 1)
+        {
+            func(0, begin, end);
+            return 1;
+        }
+        long long chunk = (length + thread_num - 1) / thread_num;
+        vector<thread> threads;
+        int chunk_id = 0;
+        for (long long bn = begin; bn < end; bn += chunk)
+        {
+            long long en = bn + chunk > end ? end : bn + chunk;
+            threads.push_back(thread(func, chunk_id++, bn, en));
+        }
+        for (thread &t : threads)
+        {
+            t.join();
+        }
+        return chunk_id;
+    }
+};
+
+#endif
@@ -0,0 +1,296 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <math.h>
+#include <stdlib.h>
+#include "Constants.h"
+#include "RSMIConfig.h"
+#include "HugePages.h"
+#include "BufferPool.h"
+
+using namespace std;
+
+// Workload specification for the Workload driver, read from a "key = value" file ('#' starts a
+// comment). The operation mix is given as percentages; threads run closed-loop unless rate
+// (operations per second over all threads) is set, in which case arrivals are open-loop
+// Poisson and latency is measured from each operation's scheduled arrival. The RSMIConfig keys
+// (page_size, threshold, ...) build the index; RTree takes page_size only.
+namespace workload
+{
+    enum Operation
+    {
+        POINT = 0,
+        WINDOW,
+        KNN,
+        INSERT,
+        DELETE,
+        OPERATION_NUM
+    };
+
+    const char *const OPERATION_NAMES[OPERATION_NUM] = {"point", "window", "knn", "insert", "delete"};
+
+    struct WorkloadConfig
+    {
+        string index = "RSMI";
+        // csv dataset; empty means the Exp naming: DATASETS/<distribution>_<cardinality>_<skewness>_2_.csv
+        string dataset;
+        string distribution = Constants::DEFAULT_DISTRIBUTION;
+        long long cardinality = 10000;
+        int skewness = 1;
+
+        double mix[OPERATION_NUM] = {100, 0, 0, 0, 0};
+        int threads = 1;
+        double rate = 0;
+        double duration = 10;
+        double report_interval = 1;
+
+        // keys of point queries, deletes and query centers: uniform, zipf or hotspot
+        string key_distribution = "uniform";
+        double zipf_theta = 0.99;
+        // hotspot: hotspot_ops of the operations go to the first hotspot_keys of the dataset
+        double hotspot_keys = 0.01;
+        double hotspot_ops = 0.9;
+        double window_area = 0.0001;
+        double window_ratio = 1;
+        int k = 25;
+        unsigned seed = 42;
+
+        RSMIConfig index_config;
+
+        string get_dataset()
+        {
+            if (!dataset.empty())
+            {
+                return dataset;
+            }
+            return Constants::DATASETS + distribution + "_" + to_string(cardinality) + "_" + to_string(skewness) + "_2_.csv";
+        }
+
+        bool set(string key, string value)
+        {
+            for (int operation = 0; operation < OPERATION_NUM; operation++)
+            {
+                if (key == OPERATION_NAMES[operation])
+                {
+                    mix[operation] = atof(value.c_str());
+                    return true;
+                }
+            }
+            if (key == "index")
+                index = value;
+            else if (key == "dataset")
+                dataset = value;
+            else if (key == "distribution")
+                distribution = value;
+            else if (key == "cardinality")
+                cardinality = atoll(value.c_str());
+            else if (key == "skewness")
+                skewness = atoi(value.c_str());
+            else if (key == "threads")
+                threads = atoi(value.c_str());
+            else if (key == "rate")
+                rate = atof(value.c_str());
+            else if (key == "duration")
+                duration = atof(value.c_str());
+            else if (key == "report_interval")
+                report_interval = atof(value.c_str());
+            else if (key == "key_distribution")
+                key_distribution = value;
+            else if (key == "zipf_theta")
+                zipf_theta = atof(value.c_str());
+            else if (key == "hotspot_keys")
+                hotspot_keys = atof(value.c_str());
+            else if (key == "hotspot_ops")
+                hotspot_ops = atof(value.c_str());
+            else if (key == "window_area")
+                window_area = atof(value.c_str());
+            else if (key == "window_ratio")
+                window_ratio = atof(value.c_str());
+            else if (key == "k")
+                k = atoi(value.c_str());
+            else if (key == "seed")
+                seed = atoi(value.c_str());
+            else if (key == "page_size")
+                index_config.page_size = atoi(value.c_str());
+            else if (key == "threshold")
+                index_config.threshold = atoi(value.c_str());
+            else if (key == "max_width")
+                index_config.max_width = atoi(value.c_str());
+            else if (key == "hidden_layer_width")
+                index_config.hidden_layer_width = atoi(value.c_str());
+            else if (key == "epoch")
+                index_config.epoch = atoi(value.c_str());
+            else if (key == "learning_rate")
+                index_config.learning_rate = atof(value.c_str());
+            else if (key == "adaptive")
+                index_config.adaptive = atoi(value.c_str()) != 0;
+            else if (key == "huge_pages")
+                index_config.huge_pages = huge_pages::parse_mode(value);
+            else if (key == "compressed_pages")
+                index_config.compressed_pages = atoi(value.c_str()) != 0;
+            else if (key == "page_file")
+                index_config.page_file = value;
+            else if (key == "buffer_pool_pages")
+                index_config.buffer_pool_pages = atoll(value.c_str());
+            else if (key == "buffer_pool_policy")
+                index_config.buffer_pool_policy = buffer_pool::parse_policy(value);
+            else if (key == "read_mode")
+                index_config.read_mode = buffer_pool::parse_read_mode(value);
+            else
+                return false;
+            return true;
+        }
+
+        // reads filename; prints the first problem found and returns false on error
+        bool load(string filename)
+        {
+            ifstream in(filename);
+            if (!in)
+            {
+                cerr << "workload: cannot open " << filename << endl;
+                return false;
+            }
+            string line;
+            int line_num = 0;
+            while (getline(in, line))
+            {
+                line_num++;
+                line = line.substr(0, line.find('#'));
+                size_t equal = line.find('=');
+                string key = trim(line.substr(0, equal));
+                if (key.empty())
+                {
+                    continue;
+                }
+                if (equal == string::npos || !set(key, trim(line.substr(equal + 1))))
+                {
+                    cerr << "workload: " << filename << ":" << line_num << ": cannot parse \"" << line << "\"" << endl;
+                    return false;
+                }
+            }
+            return validate();
+        }
+
+        bool validate()
+        {
+            double total = 0;
+            for (int operation = 0; operation < OPERATION_NUM; operation++)
+            {
+                if (mix[operation] < 0)
+                {
+                    cerr << "workload: negative " << OPERATION_NAMES[operation] << " percentage" << endl;
+                    return false;
+                }
+                total += mix[operation];
+            }
+            if (fabs(total - 100) > 1e-6)
+            {
+                cerr << "workload: operation percentages add up to " << total << ", not 100" << endl;
+                return false;
+            }
+            if (index != "RSMI" && index != "RTree")
+            {
+                cerr << "workload: unknown index " << index << " (RSMI or RTree)" << endl;
+                return false;
+            }
+            if (index == "RTree" && mix[DELETE] > 0)
+            {
+                cerr << "workload: RTree does not support delete" << endl;
+                return false;
+            }
+            if (key_distribution != "uniform" && key_distribution != "zipf" && key_distribution != "hotspot")
+            {
+                cerr << "workload: unknown key_distribution " << key_distribution << " (uniform, zipf or hotspot)" << endl;
+                return false;
+            }
+            if (key_distribution == "zipf" && (zipf_theta <= 0 || zipf_theta >= 1))
+            {
+                cerr << "workload: zipf_theta must be in (0, 1)" << endl;
+                return false;
+            }
+            if (threads < 1 || duration <= 0 || report_interval <= 0 || rate < 0 || k < 1)
+            {
+                cerr << "workload: threads, duration, report_interval and k must be positive, rate non-negative" << endl;
+                return false;
+            }
+            return index_config.validate();
+        }
+
+        static string trim(string value)
+        {
+            size_t begin = value.find_first_not_of(" \t\r");
+            size_t end = value.find_last_not_of(" \t\r");
+            return begin == string::npos ? "" : value.substr(begin, end - begin + 1);
+        }
+    };
+
+    // index into the dataset of the next key; zipf follows the YCSB generator, with rank 0 the
+    // hottest key, so hot keys are spread over space as the dataset's order is
+    class KeyGenerator
+    {
+        long long n;
+        int type;
+        double theta;
+        double zetan;
+        double alpha;
+        double eta;
+        long long hot_n;
+        double hot_ops;
+
+    public:
+        KeyGenerator(WorkloadConfig &config, long long n)
+        {
+            this->n = n;
+            type = config.key_distribution == "zipf" ? 1 : (config.key_distribution == "hotspot" ? 2 : 0);
+            theta = config.zipf_theta;
+            hot_n = (long long)(config.hotspot_keys * n);
+            hot_n = hot_n < 1 ? 1 : hot_n;
+            hot_ops = config.hotspot_ops;
+            if (type == 1)
+            {
+                zetan = 0;
+                for (long long i = 1; i <= n; i++)
+                {
+                    zetan += 1 / pow(i, theta);
+                }
+                double zeta2 = 1 + 1 / pow(2, theta);
+                alpha = 1 / (1 - theta);
+                eta = (1 - pow(2.0 / n, 1 - theta)) / (1 - zeta2 / zetan);
+            }
+        }
+
+        long long next(mt19937_64 &gen)
+        {
+            double u = uniform_real_distribution<double>(0, 1)(gen);
+            if (type == 1)
+            {
+                double uz = u * zetan;
+                if (uz < 1)
+                {
+                    return 0;
+                }
+                if (uz < 1 + pow(0.5, theta))
+                {
+                    return 1;
+                }
+                long long key = (long long)(n * pow(eta * u - eta + 1, alpha));
+                return key >= n ? n - 1 : key;
+            }
+            if (type == 2)
+            {
+                if (u < hot_ops)
+                {
+                    return gen() % hot_n;
+                }
+                return gen() % n;
+            }
+            return gen() % n;
+        }
+    };
+};
+
+#endif